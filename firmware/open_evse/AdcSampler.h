@@ -0,0 +1,276 @@
+// -*- C++ -*-
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+// accumulators for a background ADC sampler which converts one sample per
+// timer tick (see AMMETER_BACKGROUND in targets/samd/target.cpp and
+// targets/m328p/J1772Pilot.cpp)
+// n.b. keep this file free of Arduino/target dependencies so it can be
+// compiled on a host as-is
+#include <stdint.h>
+
+// conversion slots of each SMP_FRAME_TICKS frame: the mux is on the pilot for
+// the first half of the frame and on the current sensor for the second half.
+// the first conversion after each mux switch is thrown away, because the S/H
+// still holds the old channel
+#define SMP_FRAME_TICKS 6
+#define SMP_DISCARD 0
+#define SMP_PILOT   1
+#define SMP_CURRENT 2
+
+static inline uint8_t smpSlotMux(uint8_t slot)
+{
+  return (slot < SMP_FRAME_TICKS/2) ? SMP_PILOT : SMP_CURRENT;
+}
+
+static inline uint8_t smpSlotKind(uint8_t slot)
+{
+  return (slot % (SMP_FRAME_TICKS/2)) ? smpSlotMux(slot) : SMP_DISCARD;
+}
+
+//
+// sum of squares of the current samples, using the same zero-crossing
+// windowing as the blocking readAmmeter() loop: the window opens at a
+// crossing and closes two crossings later (one full cycle), at which point
+// the mean square is published and the closing crossing opens the next
+// window.
+//
+// Once the mains frequency is known, SetWindow() switches to cycle-locked
+// windows instead: a fixed number of ticks spanning a whole number of cycles,
+// no zero-crossing detection.
+//
+// Time is counted in ticks, not samples: Tick() is called for every tick,
+// including the ones spent converting something else, so the debounce, the
+// timeout and a locked window span the same time however many samples land
+// in them.  Ticks spent paused are passed to Skip() instead.  A window which
+// has skipped more than maxskipticks is thrown away, since the samples it
+// lost are too big a slice of the cycle, and the sign before a skip isn't
+// compared with the one after, so a crossing can't be placed in the wrong
+// spot.  A crossing missed that way just stretches the window by half a
+// cycle, which doesn't change its mean square.
+//
+// Sample()/Tick() belong to the ISR. The foreground calls Read(), and
+// SetWindow()/Skip() with the ISR masked
+//
+class AmmeterAccum {
+  uint32_t m_Sum;
+  uint16_t m_Cnt;
+  uint16_t m_SinceZc; // ticks since last zero crossing
+  uint8_t m_Zc;       // zero crossings seen in current window
+  uint8_t m_LastPos;
+  uint8_t m_Prime;      // next sample only sets m_LastPos
+  uint16_t m_LockTicks; // cycle-locked window length; 0 = zero-crossing
+  uint16_t m_Ticks;     // ticks elapsed in cycle-locked window
+  uint16_t m_Half;
+  uint16_t m_DebounceTicks;
+  uint16_t m_TimeoutTicks;
+  uint16_t m_Skipped;   // ticks skipped in current window
+  uint16_t m_MaxSkipTicks;
+  uint8_t m_ReadSeq;
+
+  // published results
+  volatile uint32_t m_MeanSq;
+  volatile uint8_t m_Seq;
+
+  void publish(uint32_t meansq) {
+    m_MeanSq = meansq;
+    m_Seq++;
+  }
+  void resetWindow() {
+    m_SinceZc = 0;
+    m_Zc = 0;
+    m_Sum = 0;
+    m_Cnt = 0;
+    m_Ticks = 0;
+    m_Skipped = 0;
+  }
+  void sumSample(uint16_t sample) {
+    long d = (long)sample - m_Half;
+    m_Sum += (uint32_t)(d * d);
+    m_Cnt++;
+  }
+public:
+  AmmeterAccum() {}
+  // half = ADC count of 0A
+  // debounceticks = ignore crossings for this long after one
+  // timeoutticks = publish 0 if no crossing for this long
+  // maxskipticks = throw a window away if it skipped more than this
+  void Init(uint16_t half,uint16_t debounceticks,uint16_t timeoutticks,
+            uint16_t maxskipticks) {
+    m_Half = half;
+    m_DebounceTicks = debounceticks;
+    m_TimeoutTicks = timeoutticks;
+    m_MaxSkipTicks = maxskipticks;
+    m_LockTicks = 0;
+    m_LastPos = 0;
+    m_Prime = 1;
+    m_MeanSq = 0;
+    m_Seq = 0;
+    m_ReadSeq = 0;
+    resetWindow();
+  }
+
+  // ticks > 0: integrate over fixed windows of ticks (a whole number of
+  //   mains cycles) instead of between zero crossings
+  // ticks = 0: back to zero-crossing windows
+  void SetWindow(uint16_t ticks) {
+    m_LockTicks = ticks;
+    resetWindow();
+  }
+  uint16_t GetWindow() { return m_LockTicks; }
+
+  void Sample(uint16_t sample) {
+    if (m_LockTicks) {
+      sumSample(sample);
+      return;
+    }
+
+    uint8_t pos = (sample > m_Half);
+    if (m_Prime) {
+      m_Prime = 0;
+    }
+    else if ((pos != m_LastPos) && (m_SinceZc > m_DebounceTicks)) {
+      m_SinceZc = 0;
+      if (++m_Zc == 3) {
+        publish(m_Cnt ? (m_Sum / m_Cnt) : 0);
+        m_Zc = 1;
+        m_Sum = 0;
+        m_Cnt = 0;
+        m_Skipped = 0;
+      }
+    }
+    m_LastPos = pos;
+
+    if (m_Zc) sumSample(sample);
+  }
+
+  void Tick(uint16_t ticks) {
+    if (m_LockTicks) {
+      m_Ticks += ticks;
+      if (m_Ticks >= m_LockTicks) {
+        publish(m_Cnt ? (m_Sum / m_Cnt) : 0);
+        resetWindow();
+      }
+    }
+    else {
+      m_SinceZc = ((uint32_t)m_SinceZc + ticks > 0xffff) ? 0xffff : m_SinceZc + ticks;
+      if (m_SinceZc >= m_TimeoutTicks) {
+        // no crossing for a whole timeout. Assume that it's simply not
+        // oscillating any.
+        publish(0);
+        resetWindow();
+      }
+    }
+  }
+
+  // ticks went by w/o any samples, e.g. while the ADC was lent to the
+  // foreground
+  void Skip(uint16_t ticks) {
+    m_Skipped = ((uint32_t)m_Skipped + ticks > 0xffff) ? 0xffff : m_Skipped + ticks;
+    m_Prime = 1;
+    if (m_Skipped > m_MaxSkipTicks) {
+      if (m_LockTicks) {
+        // start a new window now. any whole number of cycles will do
+        resetWindow();
+        return;
+      }
+      // wait for the next crossing, but keep counting toward the timeout
+      m_Zc = 0;
+      m_Sum = 0;
+      m_Cnt = 0;
+      m_Skipped = 0;
+    }
+    Tick(ticks);
+  }
+
+  // *meansq = mean of squares (ADC counts, centered on half) of the most
+  // recent window, or 0 if not oscillating.
+  // returns 1 if a new window completed since the last call, else 0
+  uint8_t Read(uint32_t *meansq) {
+    uint8_t seq;
+    uint32_t ms;
+    // retry if the ISR published in between
+    do {
+      seq = m_Seq;
+      ms = m_MeanSq;
+    } while (seq != m_Seq);
+
+    *meansq = ms;
+    if (seq != m_ReadSeq) {
+      m_ReadSeq = seq;
+      return 1;
+    }
+    return 0;
+  }
+};
+
+//
+// min and max of the pilot samples over windows of a fixed number of
+// samples. the samples aren't synchronized to the PWM, so a window has to be
+// long enough for them to have walked across the whole PWM period, and then
+// its min and max are the low and high plateaus, like the ones ReadPilot()
+// gets from its own loop of reads.
+//
+// Sample() belongs to the ISR. the foreground calls Restart() and Read() with
+// the ISR masked
+//
+class PilotAccum {
+  uint16_t m_Min,m_Max;
+  uint8_t m_Cnt;
+  uint8_t m_WindowSamples;
+  uint8_t m_Valid; // a window completed since Restart()
+  uint16_t m_Low,m_High;
+public:
+  PilotAccum() {}
+  void Init(uint8_t windowsamples) {
+    m_WindowSamples = windowsamples;
+    Restart();
+  }
+
+  // forget everything sampled so far, e.g. when the pilot changes
+  void Restart() {
+    m_Min = 0xffff;
+    m_Max = 0;
+    m_Cnt = 0;
+    m_Valid = 0;
+  }
+
+  void Sample(uint16_t sample) {
+    if (sample < m_Min) m_Min = sample;
+    if (sample > m_Max) m_Max = sample;
+    if (++m_Cnt >= m_WindowSamples) {
+      m_Low = m_Min;
+      m_High = m_Max;
+      m_Valid = 1;
+      m_Min = 0xffff;
+      m_Max = 0;
+      m_Cnt = 0;
+    }
+  }
+
+  // latest complete window
+  // returns 0 if none has completed since Restart()
+  uint8_t Read(uint16_t *plow,uint16_t *phigh) {
+    if (!m_Valid) return 0;
+    *plow = m_Low;
+    *phigh = m_High;
+    return 1;
+  }
+};
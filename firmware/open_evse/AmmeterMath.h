@@ -0,0 +1,56 @@
+// -*- C++ -*-
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+// pure integer math used by the ammeter
+// n.b. keep this file free of Arduino/target dependencies so it can be
+// compiled on a host as-is
+#include <stdint.h>
+
+static inline unsigned long ulong_sqrt(unsigned long in)
+{
+  unsigned long out = 0;
+  unsigned long bit = 0x40000000ul;
+
+  // "bit" starts at the highest power of four <= the argument.
+  while (bit > in)
+    bit >>= 2;
+
+  while (bit) {
+    unsigned long sum = out + bit;
+    if (in >= sum) {
+      in -= sum;
+      out = (out >> 1) + bit;
+    }
+    else
+      out >>= 1;
+    bit >>= 2;
+  }
+
+  return out;
+}
+
+// one step of an exponential moving average
+// acc holds the average << shift; returns the new average
+static inline uint32_t ema_update(uint32_t &acc,uint32_t samp,uint8_t shift)
+{
+  acc += samp - (acc >> shift);
+  return acc >> shift;
+}
@@ -60,6 +60,11 @@ void EnergyMeter::calcUsage()
   unsigned long curms = millis();
   unsigned long dms = curms - m_lastUpdateMs;
   if (dms > KWH_CALC_INTERVAL_MS) {
+#ifdef POWERMETER
+      // real power is measured directly, so use it rather than V*I
+      // mws = mw * dms / 1000
+      uint32_t mws = ((uint32_t)g_EvseController.GetRealPower() / 8) * dms / 125;
+#else // !POWERMETER
       uint32_t mv = g_EvseController.GetVoltage();
       uint32_t ma = g_EvseController.GetChargingCurrent();
       /*
@@ -90,6 +95,7 @@ void EnergyMeter::calcUsage()
        * complex, only requires one divide operation.
        */
       uint32_t mws = (mv/16) * (ma/4) / 15625 * dms;
+#endif // POWERMETER
 #ifdef THREEPHASE
       // Multiply calculation by 3 to get 3-phase energy.
       // Typically you'd multiply by sqrt(3), but because voltage is measured to
@@ -0,0 +1,57 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+#ifdef ISR_EVENT_QUEUE
+
+EventQueue g_EventQueue;
+
+// returns 0 if the ring is full and the event was dropped. repeats of an
+// event that is already queued carry no new state, so a full ring only
+// loses their timestamps
+uint8_t EventQueue::Put(uint8_t id)
+{
+  uint8_t head = m_Head;
+  uint8_t next = (head + 1) & (EVQ_SIZE-1);
+  if (next == m_Tail) return 0;
+
+  m_Ev[head].us = micros();
+  m_Ev[head].id = id;
+  m_Head = next; // publish after the slot is written
+  return 1;
+}
+
+// returns 0 if empty
+uint8_t EventQueue::Get(ISR_EVENT *ev)
+{
+  uint8_t tail = m_Tail;
+  if (tail == m_Head) return 0;
+
+  ev->us = m_Ev[tail].us;
+  ev->id = m_Ev[tail].id;
+  m_Tail = (tail + 1) & (EVQ_SIZE-1); // free the slot after it's copied
+  return 1;
+}
+
+#endif // ISR_EVENT_QUEUE
@@ -0,0 +1,65 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+#ifdef ISR_EVENT_QUEUE
+
+// event IDs
+enum {
+  EVT_GFI, // gfi_isr() tripped - relay already opened from the ISR
+  EVT_CNT
+};
+
+// must be a power of 2
+#define EVQ_SIZE 4
+
+typedef struct isr_event {
+  uint32_t us; // micros() when posted
+  uint8_t id;  // EVT_xxx
+} ISR_EVENT;
+
+//
+// single producer/single consumer ring from interrupt handlers to
+// J1772EVSEController::Update(), which drains it before anything else.
+// ISRs open the relay themselves and post an event; every other state
+// change is made by the consumer, so m_wVFlags and the pilot are never
+// written from interrupt context.
+// m_Head is written only by Put(), m_Tail only by Get(), and both are a
+// single byte, so no lock is needed as long as producers don't preempt
+// each other - AVR ISRs don't nest, and all SAMD producers run at the same
+// NVIC priority. one slot is kept empty to tell full from empty
+//
+class EventQueue {
+  volatile ISR_EVENT m_Ev[EVQ_SIZE];
+  volatile uint8_t m_Head;
+  volatile uint8_t m_Tail;
+public:
+  EventQueue() {}
+  uint8_t Put(uint8_t id); // call from ISR
+  uint8_t Get(ISR_EVENT *ev);
+};
+
+extern EventQueue g_EventQueue;
+
+#endif // ISR_EVENT_QUEUE
@@ -29,32 +29,43 @@ uint8_t g_CycleState;
 J1772EVSEController g_EvseController;
 
 #ifdef AMMETER
-static inline unsigned long ulong_sqrt(unsigned long in)
-{
-  unsigned long out = 0;
-  unsigned long bit = 0x40000000ul;
+#include "AmmeterMath.h"
 
-  // "bit" starts at the highest power of four <= the argument.
-  while (bit > in)
-    bit >>= 2;
+uint8_t J1772EVSEController::readAmmeter()
+{
+  LATENCY_PROBE(LAT_AMMETER);
+#ifdef AMMETER_BACKGROUND
+#ifdef AMMETER_CYCLE_LOCK
+  ammeterSamplerSetWindow(ammeterLockSamples());
+#endif
+  // the sampler has already done the sum of squares over the last full cycle
+  uint32_t meansq;
+  uint8_t isnew = ammeterSamplerRead(&meansq);
+  m_AmmeterReading = ulong_sqrt(meansq);
+  return isnew;
+#else // !AMMETER_BACKGROUND
+  WDT_RESET();
 
-  while (bit) {
-    unsigned long sum = out + bit;
-    if (in >= sum) {
-      in -= sum;
-      out = (out >> 1) + bit;
-    }
-    else
-      out >>= 1;
-    bit >>= 2;
+#ifdef AMMETER_CYCLE_LOCK
+  uint16_t locksamps = ammeterLockSamples();
+  if (locksamps) {
+    // fixed sample rate over a whole number of cycles - no zero crossings
+    // to find, so no false 0 readings when one is missed
+    unsigned long sum = 0;
+    unsigned long next_us = micros();
+    for (uint16_t i=0;i < locksamps;i++) {
+      long waitus = (long)(next_us - micros());
+      if (waitus > 0) delayMicroseconds(waitus);
+      next_us += 1000000UL / AMMETER_LOCK_SAMPLE_HZ;
+      long d = (long)adcCurrent.read() - ADC_HALF;
+      sum += (unsigned long)(d * d);
+    }
+    m_AmmeterReading = ulong_sqrt(sum / locksamps);
+    WDT_RESET();
+    return 1;
   }
+#endif // AMMETER_CYCLE_LOCK
 
-  return out;
-}
-
-void J1772EVSEController::readAmmeter()
-{
-  WDT_RESET();
 
 #ifdef AMMETER_TEST
   uint32_t max = 0;
@@ -105,13 +116,15 @@ void J1772EVSEController::readAmmeter()
         RAPI_SERIAL_PORT.println(s);
       }
 #endif
-      return;
+      return 1;
     }
   }
   // ran out of time. Assume that it's simply not oscillating any.
   m_AmmeterReading = 0;
 
   WDT_RESET();
+  return 1;
+#endif // AMMETER_BACKGROUND
 }
 
 #ifdef RELAY_ZC_SWITCH
@@ -133,6 +146,35 @@ void J1772EVSEController::waitCurrentZero()
   } while ((millis() - start) < CURRENT_ZERO_TIMEOUT_MS);
 }
 
+#ifdef ZC_TRACKER
+// Delay until advanceMs before the next voltage ZC predicted by g_ZcTracker.
+// Falls through immediately if the tracker isn't locked.
+void J1772EVSEController::zcWaitRelay(uint8_t advanceMs)
+{
+  uint32_t us = g_ZcTracker.UsUntilSwitch((uint32_t)advanceMs * 1000UL);
+  if (us == ZC_UNLOCKED) return;
+
+  delay(us / 1000UL);
+  delayMicroseconds(us % 1000UL);
+}
+
+#ifdef RELAY_TIMER
+void J1772EVSEController::relayCloseIsr() { g_EvseController.relayPinsOn(); }
+void J1772EVSEController::relayOpenIsr()  { g_EvseController.relayPinsOff(); }
+
+// Like zcWaitRelay(), but doesn't wait: the relay timer switches the relay
+// pins from its ISR.  Returns 0 if the tracker isn't locked, in which case
+// the caller switches them now.
+uint8_t J1772EVSEController::zcScheduleRelay(uint8_t on,uint8_t advanceMs)
+{
+  uint32_t us = g_ZcTracker.UsUntilSwitch((uint32_t)advanceMs * 1000UL);
+  if (us == ZC_UNLOCKED) return 0;
+
+  relayTimerStart(us,on ? relayCloseIsr : relayOpenIsr);
+  return 1;
+}
+#endif // RELAY_TIMER
+#else // !ZC_TRACKER
 // Measure AC frequency.  Stores the result (×100) in m_AcFreqX100 and sets
 // *zcTimeMsOut to the millis() timestamp of the second detected crossing.
 // Returns the half-period in µs, or 0 (with *zcTimeMsOut = 0) on failure.
@@ -250,48 +292,25 @@ void J1772EVSEController::zcWaitRelay(uint8_t advanceMs)
   unsigned long now = millis();
   if (switchAt > now) delay(switchAt - now);
 }
+#endif // ZC_TRACKER
 
 void J1772EVSEController::zcWaitRelayClose() { zcWaitRelay(RELAY_CLOSE_ADVANCE_MS); }
 void J1772EVSEController::zcWaitRelayOpen()  { zcWaitRelay(RELAY_OPEN_ADVANCE_MS); }
 #endif // RELAY_ZC_SWITCH
 
-#define MA_PTS 32 // # points in moving average MUST BE power of 2
-#define MA_BITS 5 // log2(MA_PTS)
-/*
-uint32_t MovingAverage(uint32_t samp)
-{
-  static uint32_t samps[MA_PTS] = {0};
-  uint32_t tot = samp;
-  samps[0] = samp;
-
-  for (int8_t c=MA_PTS-1;c > 0;c--) {
-  samps[c] = samps[c-1];
-  tot += samps[c];
-  }
-  
-  return tot >> MA_BITS;
-}
-*/
-
-// to save memory
-// instead of doing a real moving average we just do a non-overlapping
-// sliding window and output a value every MA_PTS
-uint32_t MovingAverage(uint32_t samp)
+// exponential moving average - O(1) and a single accumulator of RAM,
+// and unlike a block average, every new reading yields a new output
+// time constant is ~2^AMMETER_EMA_SHIFT readings. the first reading after
+// chargingOn()/chargingOff() seeds it, so a new session doesn't ramp up
+// from 0 or down from the last one
+uint32_t J1772EVSEController::MovingAverage(uint32_t samp)
 {
-  static uint32_t tot = 0;
-  static int8_t curidx = 0;
-  
-  if (curidx == 0) {
-    tot = 0;
+  if (m_AmmeterAvgSeed) {
+    m_AmmeterAvgSeed = 0;
+    m_AmmeterAvgAcc = samp << AMMETER_EMA_SHIFT;
+    return samp;
   }
-
-  tot += samp;
-
-  if (++curidx == MA_PTS) {
-    curidx = 0;
-    return tot >> MA_BITS; // tot / MA_PTS
-  }
-  return 0xffffffff;
+  return ema_update(m_AmmeterAvgAcc,samp,AMMETER_EMA_SHIFT);
 }
 
 #endif // AMMETER
@@ -311,6 +330,13 @@ J1772EVSEController::J1772EVSEController() :
 #ifdef RELAY_ZC_SWITCH
   m_AcFreqX100 = 0;
 #endif
+#ifdef DEBOUNCE_SAMPLES
+  m_DebounceCnt[0] = DEBOUNCE_CNT_A;
+  m_DebounceCnt[1] = DEBOUNCE_CNT_B;
+  m_DebounceCnt[2] = DEBOUNCE_CNT_C;
+  m_DebounceCnt[3] = DEBOUNCE_CNT_D;
+  m_DebounceCnt[DEBOUNCE_IDX_OTHER] = DEBOUNCE_CNT_OTHER;
+#endif // DEBOUNCE_SAMPLES
 }
 
 void J1772EVSEController::SaveSettings()
@@ -424,12 +450,8 @@ void J1772EVSEController::ShowDisabledTests()
 }
 #endif //SHOW_DISABLED_TESTS
 
-void J1772EVSEController::chargingOn()
+void J1772EVSEController::relayPinsOn()
 {
-#ifdef RELAY_ZC_SWITCH
-  if (hasCGMI() && RelayZCSwitchEnabled()) zcWaitRelayClose();
-#endif
-  // turn on charging current
 #ifdef OEV6
   if (isV6()) {
 #ifdef RELAY_PWM
@@ -461,6 +483,43 @@ void J1772EVSEController::chargingOn()
 #ifdef CHARGINGAC_REG
   if (RelayACEnabled()) pinChargingAC.write(1);
 #endif
+}
+
+void J1772EVSEController::chargingOn()
+{
+#ifdef GFI
+  // gfi_isr tripped during this Update() pass, after its GFI check. w/
+  // ISR_EVENT_QUEUE, drainEvents() only gets to it on the next pass
+  if (m_Gfi.Fault()) return;
+#endif // GFI
+  // turn on charging current
+#ifdef RELAY_ZC_SWITCH
+  uint8_t scheduled = 0;
+#ifdef RELAY_TIMER
+  relayTimerCancel(); // pending open - relay is still closed
+#endif
+  if (hasCGMI() && RelayZCSwitchEnabled()) {
+#ifdef RELAY_TIMER
+    scheduled = zcScheduleRelay(1,RELAY_CLOSE_ADVANCE_MS);
+#else
+    zcWaitRelayClose();
+#endif
+  }
+  if (!scheduled) relayPinsOn();
+#else // !RELAY_ZC_SWITCH
+  relayPinsOn();
+#endif // RELAY_ZC_SWITCH
+#ifdef GFI
+  // it tripped while we were switching, and opened the relay before we
+  // closed it (or armed the timer to)
+  if (m_Gfi.Fault()) {
+#ifdef RELAY_TIMER
+    relayTimerCancel();
+#endif
+    relayPinsOff();
+    return;
+  }
+#endif // GFI
 
   setVFlags(ECVF_CHARGING_ON);
   
@@ -474,19 +533,13 @@ void J1772EVSEController::chargingOn()
   }
 
   m_ChargeOnTimeMS = millis();
+#ifdef AMMETER
+  m_AmmeterAvgSeed = 1;
+#endif
 }
 
-void J1772EVSEController::chargingOff(uint8_t emergency)
+void J1772EVSEController::relayPinsOff()
 {
-#ifdef RELAY_ZC_SWITCH
-  if (!emergency && chargingIsOn() && RelayZCSwitchEnabled()) {
-#ifdef AMMETER
-    waitCurrentZero();
-#endif
-    zcWaitRelayOpen();
-  }
-#endif
- // turn off charging current
 #ifdef OEV6
   if (isV6()) {
 #ifdef RELAY_AUTO_PWM_PIN
@@ -511,6 +564,37 @@ void J1772EVSEController::chargingOff(uint8_t emergency)
 #ifdef CHARGINGAC_REG
   pinChargingAC.write(0);
 #endif
+}
+
+void J1772EVSEController::chargingOff(uint8_t emergency)
+{
+ // turn off charging current
+#ifdef GFI_TEST_TIMER
+  // nothing to close the relay for any more
+  if (m_Gfi.SelfTestActive()) m_Gfi.SelfTestAbort();
+#endif // GFI_TEST_TIMER
+#ifdef RELAY_ZC_SWITCH
+  uint8_t scheduled = 0;
+#ifdef RELAY_TIMER
+  // a close that hasn't happened yet means the relay is still open
+  uint8_t closed = (relayTimerCancel() != relayCloseIsr);
+#else
+  uint8_t closed = 1;
+#endif // RELAY_TIMER
+  if (!emergency && closed && chargingIsOn() && RelayZCSwitchEnabled()) {
+#ifdef AMMETER
+    waitCurrentZero();
+#endif
+#ifdef RELAY_TIMER
+    scheduled = zcScheduleRelay(0,RELAY_OPEN_ADVANCE_MS);
+#else
+    zcWaitRelayOpen();
+#endif
+  }
+  if (!scheduled) relayPinsOff();
+#else // !RELAY_ZC_SWITCH
+  relayPinsOff();
+#endif // RELAY_ZC_SWITCH
 
   clrVFlags(ECVF_CHARGING_ON);
 
@@ -518,6 +602,11 @@ void J1772EVSEController::chargingOff(uint8_t emergency)
 
 #ifdef AMMETER
   m_ChargingCurrent = 0;
+  m_AmmeterAvgSeed = 1;
+#endif
+#ifdef POWERMETER
+  m_RealPower = 0;
+  m_PowerFactor = 0;
 #endif
 }
 
@@ -546,27 +635,16 @@ void J1772EVSEController::DoPPError(bool shorted)
 }
 #endif // PP_AUTO_AMPACITY
 
+// doesn't block. Update() stays in the hard fault until the EV is
+// unplugged (recoverable only) or user resets via menu/RAPI
 void J1772EVSEController::HardFault(int8_t recoverable)
 {
   SetHardFault();
+  m_HardFaultRecoverable = recoverable;
   g_OBD.Update(OBD_UPD_HARDFAULT);
 #ifdef RAPI
   RapiSendEvseState();
 #endif
-  while (1) {
-    ProcessInputs(); // spin forever or until user resets via menu
-    // if pilot not in N12 state, we can recover from the hard fault when EV
-    // is unplugged
-    if (m_Pilot.GetState() != PILOT_STATE_N12) {
-      ReadPilot(); // update EV connect state
-      if (!EvConnected() && recoverable) {
-	// EV disconnected - cancel fault
-	m_EvseState = EVSE_STATE_UNKNOWN;
-	break;
-      }
-    }
-  }
-  ClrHardFault();
 }
 
 #ifdef GFI
@@ -578,19 +656,52 @@ void J1772EVSEController::SetGfiTripped()
     return;
   }
 #endif
+#ifdef ISR_EVENT_QUEUE
+  // open the relay now, for safety. the rest of chargingOff() and the
+  // pilot are done by drainEvents(), so we don't race the foreground
+#ifdef RELAY_TIMER
+  relayTimerCancel(); // a pending close must not fire after this
+#endif
+  relayPinsOff();
+  m_Gfi.SetFault(); // polled by the blocking POST waits
+  g_EventQueue.Put(EVT_GFI);
+#else // !ISR_EVENT_QUEUE
   setVFlags(ECVF_GFI_TRIPPED);
 
   // this is repeated in Update(), but we want to keep latency as low as possible
   // for safety so we do it here first anyway
   chargingOff(1); // GFI: emergency open — no zero-crossing wait
-  // turn off the PWM
-  m_Pilot.SetState(PILOT_STATE_P12);
+  // turn off the PWM. DISABLED keeps N12
+  if (m_EvseState != EVSE_STATE_DISABLED) m_Pilot.SetState(PILOT_STATE_P12);
 
   m_Gfi.SetFault();
+#endif // ISR_EVENT_QUEUE
   // the rest of the logic will be handled in Update()
 }
 #endif // GFI
 
+#ifdef ISR_EVENT_QUEUE
+// apply the state changes for events posted by ISRs since the last call
+void J1772EVSEController::drainEvents()
+{
+  ISR_EVENT ev;
+  while (g_EventQueue.Get(&ev)) {
+#ifdef LATENCY_STATS
+    g_LatencyStats.Record(LAT_EVENT,micros()-ev.us);
+#endif
+    switch(ev.id) {
+#ifdef GFI
+    case EVT_GFI:
+      setVFlags(ECVF_GFI_TRIPPED);
+      chargingOff(1); // relay is already open
+      if (m_EvseState != EVSE_STATE_DISABLED) m_Pilot.SetState(PILOT_STATE_P12);
+      break;
+#endif // GFI
+    }
+  }
+}
+#endif // ISR_EVENT_QUEUE
+
 void J1772EVSEController::EnableDiodeCheck(uint8_t tf)
 {
   if (tf) {
@@ -722,6 +833,7 @@ void J1772EVSEController::Enable()
     
     m_PrevEvseState = EVSE_STATE_DISABLED;
     m_EvseState = EVSE_STATE_UNKNOWN;
+    m_FaultShutdownDelayMs = 0;
     m_Pilot.SetState(PILOT_STATE_P12);
   }
 }
@@ -733,6 +845,7 @@ void J1772EVSEController::Disable()
     m_EvseState = EVSE_STATE_DISABLED;
     // panic stop so we won't wait for EV to open its contacts first
     chargingOff();
+    m_FaultShutdownDelayMs = 0; // relay's open, nothing left to time
 #ifdef MENNEKES_LOCK
     if (!MennekesIsManual()) m_MennekesLock.Unlock(1);
 #endif // MENNEKES_LOCK
@@ -799,7 +912,7 @@ void J1772EVSEController::SetSvcLevel(uint8_t svclvl,uint8_t updatelcd)
 uint8_t J1772EVSEController::GetMaxCurrentCapacity()
 {
   uint8_t svclvl = GetCurSvcLevel();
-  uint8_t ampacity =  eeprom_read_byte((uint8_t*)((svclvl == 1) ? EOFS_CURRENT_CAPACITY_L1 : EOFS_CURRENT_CAPACITY_L2));
+  uint8_t ampacity =  eeprom_read_byte((uint8_t*)(uintptr_t)((svclvl == 1) ? EOFS_CURRENT_CAPACITY_L1 : EOFS_CURRENT_CAPACITY_L2));
 
   if ((ampacity == 0xff) || (ampacity == 0)) {
     ampacity = (svclvl == 1) ? DEFAULT_CURRENT_CAPACITY_L1 : DEFAULT_CURRENT_CAPACITY_L2;
@@ -868,262 +981,396 @@ uint8_t J1772EVSEController::ReadACPins()
 }
 
 
-uint8_t J1772EVSEController::doPost()
+#if !defined(OPENEVSE_2) && defined(AUTOSVCLEVEL)
+void J1772EVSEController::postRelay1(uint8_t on)
 {
-  WDT_RESET();
+#ifdef OEV6
+  if (isV6()) {
+    digitalWrite(V6_CHARGING_PIN,on ? HIGH : LOW);
+  }
+  else { // !V6
+#endif // OEV6
+#ifdef CHARGING_REG
+    pinCharging.write(on);
+#endif
+#ifdef OEV6
+  }
+#endif // OEV6
+#ifdef CHARGINGAC_REG
+  pinChargingAC.write(on);
+#endif
+}
 
-  uint8_t RelayOff;
-#if !defined(OPENEVSE_2) && defined(AUTOSVCLEVEL)
-  uint8_t Relay1, Relay2; //Relay Power status
+void J1772EVSEController::postRelay2(uint8_t on)
+{
+#ifdef OEV6
+  if (isV6()) {
+    digitalWrite(V6_CHARGING_PIN2,on ? HIGH : LOW);
+  }
+  else { // !V6
+#endif // OEV6
+#ifdef CHARGING2_REG
+    pinCharging2.write(on);
+#endif
+#ifdef OEV6
+  }
+#endif // OEV6
+}
+#endif // !OPENEVSE_2 && AUTOSVCLEVEL
+
+void J1772EVSEController::postStart()
+{
+  m_PostStage = POST_START;
+  m_PostWaitMs = 0;
+#ifdef STAGED_POST
+  m_PostStartMs = millis();
 #endif
-  uint8_t svcState = UD;	// service state = undefined
+}
+
+// runs the power on self test one stage at a time. each stage that has to
+// let the pilot/relays settle sets a wait and returns POST_BUSY; the next
+// call picks up from there. returns the service state when done
+uint8_t J1772EVSEController::postStep()
+{
+  WDT_RESET();
+
+  for (;;) {
+    if (m_PostWaitMs) {
+      if ((millis() - m_PostWaitStartMs) < m_PostWaitMs) return POST_BUSY;
+      m_PostWaitMs = 0;
+    }
+
+    switch (m_PostStage) {
+    case POST_START:
+      m_PostSvcState = UD; // service state = undefined
 
 #ifdef SERDBG
-  if (SerDbgEnabled()) {
-    Serial.print("POST start...");
-  }
+      if (SerDbgEnabled()) {
+	Serial.print("POST start...");
+      }
 #endif //#ifdef SERDBG
 
 #ifdef CALIBRATE
-  while (1) {
-    CALIB_DATA cd;
-    Calibrate(&cd);
-}
-
+      while (1) {
+	CALIB_DATA cd;
+	Calibrate(&cd);
+      }
 #endif // CALIBRATE
 
+#ifdef AUTH_LOCK
+      // no current offer while locked. P12 reads the same for the check
+      m_Pilot.SetState(AuthLockIsOn() ? PILOT_STATE_P12 : PILOT_STATE_PWM); //check to see if EV is plugged in
+#else
+      m_Pilot.SetState(PILOT_STATE_PWM); //check to see if EV is plugged in
+#endif // AUTH_LOCK
 
-  m_Pilot.SetState(PILOT_STATE_PWM); //check to see if EV is plugged in
-
-  g_OBD.SetRedLed(1);
-#ifdef LCD16X2 //Adafruit RGB LCD
-  g_OBD.LcdMsg_P(g_psPwrOn,g_psSelfTest);
+      g_OBD.SetRedLed(1);
+#if defined(LCD16X2) && !defined(STAGED_POST) //Adafruit RGB LCD
+      g_OBD.LcdMsg_P(g_psPwrOn,g_psSelfTest);
 #endif //Adafruit RGB LCD
 
+      m_PostStage = POST_STUCK_RELAY;
 #ifdef AUTOSVCLEVEL
-  if (AutoSvcLevelEnabled()) {
+      if (AutoSvcLevelEnabled()) {
 #ifdef OPENEVSE_2
-    // For OpenEVSE II, there is a voltmeter for auto L1/L2.
-    uint32_t long ac_volts = ReadVoltmeter();
-    if (ac_volts > L2_VOLTAGE_THRESHOLD) {
-      svcState = L2;
-    } else {
-      svcState = L1;
-    }
+	// For OpenEVSE II, there is a voltmeter for auto L1/L2.
+	uint32_t long ac_volts = ReadVoltmeter();
+	if (ac_volts > L2_VOLTAGE_THRESHOLD) {
+	  m_PostSvcState = L2;
+	} else {
+	  m_PostSvcState = L1;
+	}
 #ifdef SERDBG
-    if (SerDbgEnabled()) {
-      Serial.print("AC millivolts: ");Serial.println(ac_volts);
-      Serial.print("SvcState: ");Serial.println((int)svcState);
-    }
+	if (SerDbgEnabled()) {
+	  Serial.print("AC millivolts: ");Serial.println(ac_volts);
+	  Serial.print("SvcState: ");Serial.println((int)m_PostSvcState);
+	}
 #endif //#ifdef SERDBG
 #ifdef LCD16X2
-    g_OBD.LcdMsg_P(g_psAutoDetect,(svcState == L2) ? g_psLevel2 : g_psLevel1);
+	g_OBD.LcdMsg_P(g_psAutoDetect,(m_PostSvcState == L2) ? g_psLevel2 : g_psLevel1);
 #endif //LCD16x2
-    
+	m_PostStage = POST_GFI;
 #else //!OPENEVSE_2
-    
-    delay(150); // delay reading for stable pilot before reading
-    uint16_t reading = adcPilot.read(); //read pilot
+	m_PostStage = POST_PILOT;
+	postWait(150); // delay reading for stable pilot before reading
+#endif // OPENEVSE_2
+      }
+#endif // AUTOSVCLEVEL
+      break;
+
+#if !defined(OPENEVSE_2) && defined(AUTOSVCLEVEL)
+    case POST_PILOT:
+      {
+	uint16_t reading = adcPilot.read(); //read pilot
 #ifdef SERDBG
-    if (SerDbgEnabled()) {
-      Serial.print("Pilot: ");Serial.println((int)reading);
-    }
+	if (SerDbgEnabled()) {
+	  Serial.print("Pilot: ");Serial.println((int)reading);
+	}
 #endif //#ifdef SERDBG
-    
-    m_Pilot.SetState(PILOT_STATE_N12);
-    if (reading >= m_ThreshData.m_ThreshAB) {  // IF EV is not connected its Okay to open the relay the do the L1/L2 and ground Check
 
-      // save state with both relays off - for stuck relay state
-      RelayOff = ReadACPins();
+	m_Pilot.SetState(PILOT_STATE_N12);
+	if (reading >= m_ThreshData.m_ThreshAB) {  // IF EV is not connected its Okay to open the relay the do the L1/L2 and ground Check
+	  // save state with both relays off - for stuck relay state
+	  m_PostRelayOff = ReadACPins();
 
-      // save state with Relay 1 on 
-#ifdef OEV6
-      if (isV6()) {
-	digitalWrite(V6_CHARGING_PIN,HIGH);
-      }
-      else { // !V6
-#endif // OEV6
-#ifdef CHARGING_REG
-	pinCharging.write(1);
-#endif
-#ifdef OEV6
+	  // save state with Relay 1 on 
+	  postRelay1(1);
+	  m_PostStage = POST_RELAY1;
+	  postWait(RelaySettlingTime);
+	}
+	else {
+	  // since we can't auto detect, for safety's sake, we must set to L1
+	  m_PostSvcState = L1;
+	  SetAutoSvcLvlSkipped(1);
+	  // EV connected.. do stuck relay check
+	  m_PostStage = POST_STUCK_RELAY;
+	}
       }
-#endif // OEV6
-#ifdef CHARGINGAC_REG
-      pinChargingAC.write(1);
-#endif
+      break;
 
-      wdt_delay(RelaySettlingTime);
-      Relay1 = ReadACPins();
+    case POST_RELAY1:
+      m_PostRelay1 = ReadACPins();
+      postRelay1(0);
+      m_PostStage = POST_RELAY2;
+      postWait(RelaySettlingTime); //allow relay to fully open before running other tests
+      break;
 
-#ifdef OEV6
-      if (isV6()) {
-	digitalWrite(V6_CHARGING_PIN,LOW);
-      }
-      else { // !V6
-#endif // OEV6
-#ifdef CHARGING_REG
-	pinCharging.write(0);
-#endif
-#ifdef OEV6
-      }
-#endif // OEV6
-#ifdef CHARGINGAC_REG
-      pinChargingAC.write(0);
-#endif
-
-      delay(RelaySettlingTime); //allow relay to fully open before running other tests
-          
+    case POST_RELAY2:
       // save state for Relay 2 on
-#ifdef OEV6
-      if (isV6()) {
-	digitalWrite(V6_CHARGING_PIN2,HIGH);
-      }
-      else { // !V6
-#endif // OEV6
-#ifdef CHARGING2_REG
-	pinCharging2.write(1); 
-#endif
-#ifdef OEV6
-      }
-#endif // OEV6
-
-      delay(RelaySettlingTime);
-      Relay2 = ReadACPins();
-
-#ifdef OEV6
-      if (isV6()) {
-	digitalWrite(V6_CHARGING_PIN2,LOW);
-      }
-      else { // !V6
-#endif // OEV6
-#ifdef CHARGING2_REG
-	pinCharging2.write(0); 
-#endif
-#ifdef OEV6
-      }
-#endif // OEV6
-      delay(RelaySettlingTime); //allow relay to fully open before running other tests
-        
+      postRelay2(1);
+      m_PostStage = POST_RELAY2_READ;
+      postWait(RelaySettlingTime);
+      break;
+
+    case POST_RELAY2_READ:
+      m_PostRelay2 = ReadACPins();
+      postRelay2(0);
+      m_PostStage = POST_SVC_LEVEL;
+      postWait(RelaySettlingTime); //allow relay to fully open before running other tests
+      break;
+
+    case POST_SVC_LEVEL:
       // decide input power state based on the status read  on L1 and L2
       // either 2 SPST or 1 DPST relays can be configured
       // valid svcState is L1 - one hot, L2 both hot, OG - open ground both off, SR - stuck relay when shld be off
       //
-      if (RelayOff == none) { // relay not stuck on when off
-	switch ( Relay1 ) {
+      if (m_PostRelayOff == none) { // relay not stuck on when off
+	switch ( m_PostRelay1 ) {
 	case ( both ): //
-	  if ( Relay2 == none ) svcState = L2;
+	  if ( m_PostRelay2 == none ) m_PostSvcState = L2;
 	  if (StuckRelayChkEnabled()) {
-	    if ( Relay2 != none ) svcState = SR;
+	    if ( m_PostRelay2 != none ) m_PostSvcState = SR;
 	  }
 	  break;
 	case ( none ): //
 	  if (GndChkEnabled()) {
-	    if ( Relay2 == none ) svcState = OG;
+	    if ( m_PostRelay2 == none ) m_PostSvcState = OG;
 	  }
-	  if ( Relay2 == both ) svcState = L2;
-	  if ( Relay2 == L1 || Relay2 == L2 ) svcState = L1;
+	  if ( m_PostRelay2 == both ) m_PostSvcState = L2;
+	  if ( m_PostRelay2 == L1 || m_PostRelay2 == L2 ) m_PostSvcState = L1;
 	  break;
 	case ( L1on ): // L1 or L2
 	case ( L2on ):
 	  if (StuckRelayChkEnabled()) {
-	    if ( Relay2 != none ) svcState = SR;
+	    if ( m_PostRelay2 != none ) m_PostSvcState = SR;
 	  }
-	if ( Relay2 == none ) svcState = L1;
-	if ( (Relay1 == L1on) && (Relay2 == L2on)) svcState = L2;
-	if ( (Relay1 == L2on) && (Relay2 == L1on)) svcState = L2;
-	break;
+	  if ( m_PostRelay2 == none ) m_PostSvcState = L1;
+	  if ( (m_PostRelay1 == L1on) && (m_PostRelay2 == L2on)) m_PostSvcState = L2;
+	  if ( (m_PostRelay1 == L2on) && (m_PostRelay2 == L1on)) m_PostSvcState = L2;
+	  break;
 	} // end switch
       }
       else { // Relay stuck on
 	if (StuckRelayChkEnabled()) {
-	  svcState = SR;
+	  m_PostSvcState = SR;
 	}
       }
 #ifdef SERDBG
       if (SerDbgEnabled()) {
-	Serial.print("RelayOff: ");Serial.println((int)RelayOff);
-	Serial.print("Relay1: ");Serial.println((int)Relay1);
-	Serial.print("Relay2: ");Serial.println((int)Relay2);
-	Serial.print("SvcState: ");Serial.println((int)svcState);
+	Serial.print("RelayOff: ");Serial.println((int)m_PostRelayOff);
+	Serial.print("Relay1: ");Serial.println((int)m_PostRelay1);
+	Serial.print("Relay2: ");Serial.println((int)m_PostRelay2);
+	Serial.print("SvcState: ");Serial.println((int)m_PostSvcState);
       }
 #endif //#ifdef SERDBG
 
       // update LCD
 #ifdef LCD16X2
-      if (svcState == L1) g_OBD.LcdMsg_P(g_psAutoDetect,g_psLevel1);
-      if (svcState == L2) g_OBD.LcdMsg_P(g_psAutoDetect,g_psLevel2);
-      if ((svcState == OG) || (svcState == SR))  {
+      if (m_PostSvcState == L1) g_OBD.LcdMsg_P(g_psAutoDetect,g_psLevel1);
+      if (m_PostSvcState == L2) g_OBD.LcdMsg_P(g_psAutoDetect,g_psLevel2);
+      if ((m_PostSvcState == OG) || (m_PostSvcState == SR))  {
 	g_OBD.LcdSetBacklightColor(RED);
       }
-      if (svcState == OG) g_OBD.LcdMsg_P(g_psTestFailed,g_psNoGround);
-      if (svcState == SR) g_OBD.LcdMsg_P(g_psTestFailed,g_psStuckRelay);
+      if (m_PostSvcState == OG) g_OBD.LcdMsg_P(g_psTestFailed,g_psNoGround);
+      if (m_PostSvcState == SR) g_OBD.LcdMsg_P(g_psTestFailed,g_psStuckRelay);
 #endif // LCD16X2
-    } // endif test, no EV is plugged in
-    else {
-      // since we can't auto detect, for safety's sake, we must set to L1
-      svcState = L1;
-      SetAutoSvcLvlSkipped(1);
-      // EV connected.. do stuck relay check
-      goto stuckrelaychk;
-    }
-#endif //#else OPENEVSE_2
-  }
-  else { // ! AutoSvcLevelEnabled
-#endif // AUTOSVCLEVEL
-#ifndef OPENEVSE_2
-  stuckrelaychk:
-#endif
-    if (StuckRelayChkEnabled()) {
-      RelayOff = ReadACPins();
-      if ((hasCGMI() && !(RelayOff & RLY_TEST_PIN_OPEN)) ||
-          (!hasCGMI() && (RelayOff != ACPINS_OPEN))) {
-	svcState = SR;
+      m_PostStage = POST_GFI;
+      break;
+#endif // !OPENEVSE_2 && AUTOSVCLEVEL
+
+    case POST_STUCK_RELAY:
+      if (StuckRelayChkEnabled()) {
+	uint8_t RelayOff = ReadACPins();
+	if ((hasCGMI() && !(RelayOff & RLY_TEST_PIN_OPEN)) ||
+	    (!hasCGMI() && (RelayOff != ACPINS_OPEN))) {
+	  m_PostSvcState = SR;
 #ifdef LCD16X2
-	g_OBD.LcdMsg_P(g_psTestFailed,g_psStuckRelay);
+	  g_OBD.LcdMsg_P(g_psTestFailed,g_psStuckRelay);
 #endif // LCD16X2
+	}
       }
-    }
-#ifdef AUTOSVCLEVEL
-  } // endif AutoSvcLevelEnabled
-#endif // AUTOSVCLEVEL
-  
+      m_PostStage = POST_GFI;
+      break;
+
+    case POST_GFI:
+      m_PostStage = POST_FINISH;
 #ifdef GFI_SELFTEST
-  // only run GFI test if no fault detected above
-  if (((svcState == UD)||(svcState == L1)||(svcState == L2)) &&
-      GfiSelfTestEnabled()) {
-    if (m_Gfi.SelfTest()) {
+      // only run GFI test if no fault detected above
+      if (((m_PostSvcState == UD)||(m_PostSvcState == L1)||(m_PostSvcState == L2)) &&
+	  GfiSelfTestEnabled()) {
+#ifdef GFI_TEST_TIMER
+	m_Gfi.SelfTestStart();
+	m_PostStage = POST_GFI_WAIT;
+#else // !GFI_TEST_TIMER
+	if (m_Gfi.SelfTest()) {
 #ifdef LCD16X2
-      g_OBD.LcdMsg_P(g_psTestFailed,g_psGfci);
+	  g_OBD.LcdMsg_P(g_psTestFailed,g_psGfci);
 #endif // LCD16X2
-      svcState = FG;
-    }
-  }
-#endif
+	  m_PostSvcState = FG;
+	}
+#endif // GFI_TEST_TIMER
+      }
+#endif // GFI_SELFTEST
+      break;
 
-  if ((svcState == OG)||(svcState == SR)||(svcState == FG)) {
+#ifdef GFI_TEST_TIMER
+    case POST_GFI_WAIT:
+      {
+	uint8_t rc = m_Gfi.SelfTestPoll();
+	if (rc == GFI_TEST_BUSY) return POST_BUSY;
+	if (rc) {
 #ifdef LCD16X2
-    g_OBD.LcdSetBacklightColor(RED);
+	  g_OBD.LcdMsg_P(g_psTestFailed,g_psGfci);
 #endif // LCD16X2
-    g_OBD.SetGreenLed(0);
-    g_OBD.SetRedLed(1);
+	  m_PostSvcState = FG;
+	}
+      }
+      m_PostStage = POST_FINISH;
+      break;
+#endif // GFI_TEST_TIMER
+
+    default: // POST_FINISH
+#if defined(STAGED_POST) && defined(LCD16X2)
+      // OnboardDisplay::Init() doesn't hold the version splash, so leave it
+      // up until it's been shown for LCD_SPLASH_MS
+      if ((millis() - m_PostStartMs) < LCD_SPLASH_MS) return POST_BUSY;
+#endif // STAGED_POST && LCD16X2
+      if ((m_PostSvcState == OG)||(m_PostSvcState == SR)||(m_PostSvcState == FG)) {
+#ifdef LCD16X2
+	g_OBD.LcdSetBacklightColor(RED);
+#endif // LCD16X2
+	g_OBD.SetGreenLed(0);
+	g_OBD.SetRedLed(1);
+      }
+      else {
+	g_OBD.SetRedLed(0);
+      }
+      m_Pilot.SetState(PILOT_STATE_P12);
+
+#ifdef SERDBG
+      if (SerDbgEnabled()) {
+	Serial.print("POST result: ");
+	Serial.println((int)m_PostSvcState);
+      }
+#endif //#ifdef SERDBG
+
+      WDT_RESET();
+
+      m_PostStage = POST_IDLE;
+      return m_PostSvcState;
+    }
   }
-  else {
-    g_OBD.SetRedLed(0);
+}
+
+#ifndef STAGED_POST
+uint8_t J1772EVSEController::doPost()
+{
+  uint8_t svcstate;
+  postStart();
+  while ((svcstate = postStep()) == POST_BUSY);
+  return svcstate;
+}
+#endif // !STAGED_POST
+
+// applies a POST result: auto detected service level overrides any saved
+// value, and a failed test sets the fault state. returns 1 if POST failed
+uint8_t J1772EVSEController::postResult(uint8_t psvclvl,uint8_t *svclvl)
+{
+  uint8_t fault = 0;
+#ifdef AUTOSVCLEVEL
+  if ((AutoSvcLevelEnabled()) && ((psvclvl == L1) || (psvclvl == L2)))  *svclvl = psvclvl; //set service level
+#else
+  (void)svclvl;
+#endif // AUTOSVCLEVEL
+  if ((GndChkEnabled()) && (psvclvl == OG))  { m_EvseState = EVSE_STATE_NO_GROUND; fault = 1;} // set No Ground error
+  if ((StuckRelayChkEnabled()) && (psvclvl == SR)) { m_EvseState = EVSE_STATE_STUCK_RELAY; fault = 1; } // set Stuck Relay error
+#ifdef GFI_SELFTEST
+  if ((GfiSelfTestEnabled()) && (psvclvl == FG)) { m_EvseState = EVSE_STATE_GFI_TEST_FAILED; fault = 1; } // set GFI test fail error
+#endif
+  return fault;
+}
+
+#ifdef STAGED_POST
+// drives POST from setup()'s boot lock wait and the top of Update().
+// returns 1 while POST is still running or has failed
+uint8_t J1772EVSEController::PostRun()
+{
+  if (m_PostStage == POST_IDLE) return 0;
+
+  if (m_PostStage == POST_FAILED) {
+#ifndef UL_COMPLIANT
+    // keep retrying POST every 2 minutes
+    if ((millis() - m_PostWaitStartMs) >= 2*60000ul) {
+      postStart();
+    }
+#endif // !UL_COMPLIANT
+    // UL wants EVSE to hard fault until power cycle if POST fails
+    return 1;
   }
-  m_Pilot.SetState(PILOT_STATE_P12);
 
-#ifdef SERDBG
-  if (SerDbgEnabled()) {
-    Serial.print("POST result: ");
-    Serial.println((int)svcState);
+  if ((m_EvseState == EVSE_STATE_DISABLED) ||
+      (m_EvseState == EVSE_STATE_SLEEPING)) {
+    // disabled/put to sleep via RAPI/menu in the middle of POST.
+    // stop the test in progress, and start over once we're enabled
+    // again - POST never finishes without passing
+    if (m_PostStage != POST_START) {
+      chargingOff(1); // a relay under test may still be closed
+      g_OBD.SetRedLed(0);
+      postStart();
+    }
+    return 1;
   }
-#endif //#ifdef SERDBG
 
-  WDT_RESET();
+  uint8_t psvclvl = postStep();
+  if (psvclvl == POST_BUSY) return 1;
+
+  m_PostMs = millis() - m_PostStartMs;
+  if (postResult(psvclvl,&m_PostSvcLvl)) {
+#ifdef UL_COMPLIANT
+#ifdef RAPI
+    RapiSendBootNotification();
+    RapiSendEvseState(1);
+#endif
+#endif // UL_COMPLIANT
+    m_PostStage = POST_FAILED;
+    m_PostWaitStartMs = millis();
+    return 1;
+  }
 
-  return svcState;
+  initFinish(m_PostSvcLvl);
+  return 0;
 }
+#endif // STAGED_POST
 #endif // ADVPWR
 
 void J1772EVSEController::Init()
@@ -1134,6 +1381,7 @@ void J1772EVSEController::Init()
 
   m_EvseState = EVSE_STATE_UNKNOWN;
   m_PrevEvseState = EVSE_STATE_UNKNOWN;
+  m_FaultShutdownDelayMs = 0;
 
   // read settings from EEPROM
   uint16_t rflgs = eeprom_read_word((uint16_t*)EOFS_FLAGS);
@@ -1186,6 +1434,10 @@ void J1772EVSEController::Init()
 #ifdef ACLINE2_REG
   pinAC2.init(ACLINE2_REG,ACLINE2_IDX,DigitalPin::INP_PU);
 #endif
+#ifdef ZC_TRACKER
+  // after pinAC1/2 init, which would undo the SAMD EIC pin mux
+  zcTrackerBegin();
+#endif
 #ifdef SLEEP_STATUS_REG
   pinSleepStatus.init(SLEEP_STATUS_REG,SLEEP_STATUS_IDX,DigitalPin::OUT);
 #endif
@@ -1266,7 +1518,12 @@ void J1772EVSEController::Init()
   }
   
   m_AmmeterReading = 0;
+  m_AmmeterAvgSeed = 1;
   m_ChargingCurrent = 0;
+#ifdef POWERMETER
+  m_RealPower = 0;
+  m_PowerFactor = 0;
+#endif // POWERMETER
 
 #ifdef AMMETER_TESTtt
   // for debugging only
@@ -1345,19 +1602,18 @@ void J1772EVSEController::Init()
   ShowDisabledTests();
 #endif
  
+#ifdef STAGED_POST
+  // POST runs from PostRun(), so RAPI, buttons and the LCD keep going
+  // during the relay settling delays. PostRun() calls initFinish() when
+  // it passes
+  m_PostSvcLvl = svclvl;
+  m_PostMs = 0;
+  m_ReadyMs = 0;
+  postStart();
+#else // !STAGED_POST
   uint8_t fault;
   do {
-    fault = 0; // reset post fault
-    uint8_t psvclvl = doPost(); // auto detect service level overrides any saved values
-    
-#ifdef AUTOSVCLEVEL
-    if ((AutoSvcLevelEnabled()) && ((psvclvl == L1) || (psvclvl == L2)))  svclvl = psvclvl; //set service level
-#endif // AUTOSVCLEVEL
-    if ((GndChkEnabled()) && (psvclvl == OG))  { m_EvseState = EVSE_STATE_NO_GROUND; fault = 1;} // set No Ground error
-    if ((StuckRelayChkEnabled()) && (psvclvl == SR)) { m_EvseState = EVSE_STATE_STUCK_RELAY; fault = 1; } // set Stuck Relay error
-#ifdef GFI_SELFTEST
-    if ((GfiSelfTestEnabled()) && (psvclvl == FG)) { m_EvseState = EVSE_STATE_GFI_TEST_FAILED; fault = 1; } // set GFI test fail error
-#endif
+    fault = postResult(doPost(),&svclvl); // auto detect service level overrides any saved values
     if (fault) {
 #ifdef UL_COMPLIANT
       // UL wants EVSE to hard fault until power cycle if POST fails
@@ -1377,8 +1633,17 @@ void J1772EVSEController::Init()
 #endif
     }
   } while ( fault && ( m_EvseState == EVSE_STATE_GFI_TEST_FAILED || m_EvseState == EVSE_STATE_NO_GROUND ||  m_EvseState == EVSE_STATE_STUCK_RELAY ));
+#endif // STAGED_POST
 #endif // ADVPWR
 
+#ifndef STAGED_POST
+  initFinish(svclvl);
+#endif
+}
+
+// the rest of Init() once POST has passed
+void J1772EVSEController::initFinish(uint8_t svclvl)
+{
   SetSvcLevel(svclvl);
 
 #ifdef DELAYTIMER
@@ -1407,11 +1672,38 @@ void J1772EVSEController::Init()
 
 }
 
+#ifdef PILOT_HYSTERESIS
+#if ((PILOT_THRESH_AB - PILOT_HYST) <= (PILOT_THRESH_BC + PILOT_HYST)) || ((PILOT_THRESH_BC - PILOT_HYST) <= (PILOT_THRESH_CD + PILOT_HYST)) || ((PILOT_THRESH_CD - PILOT_HYST) <= PILOT_THRESH_D)
+#error PILOT_HYST too wide for the pilot thresholds
+#endif
+
+#define PILOT_BAND_READ(p) pgm_read_word(p)
+#include "PilotBand.h"
+
+static const uint16_t s_PilotBandThresh[3][3] PROGMEM =
+  PILOT_BAND_TABLE(PILOT_THRESH_AB,PILOT_THRESH_BC,PILOT_THRESH_CD,PILOT_HYST);
+
+// classify phigh as EVSE_STATE_A/B/C, or EVSE_STATE_D for anything below
+// C/D (caller still checks m_ThreshD). prevstate is the last reading's
+// pilot state; anything but A-D means no hysteresis
+uint8_t J1772EVSEController::pilotBand(uint16_t phigh,uint8_t prevstate)
+{
+  return EVSE_STATE_A + pilotBandOf(s_PilotBandThresh,phigh,(uint8_t)(prevstate - EVSE_STATE_A));
+}
+#endif // PILOT_HYSTERESIS
+
 void J1772EVSEController::ReadPilot(uint16_t *plow,uint16_t *phigh)
 {
+  LATENCY_PROBE(LAT_PILOT);
+
   uint16_t pl = ADC_MAX;
   uint16_t ph = 0;
 
+#ifdef PILOT_ADC_TRIGGER
+  // the plateaus are sampled in the background
+  if (!m_Pilot.ReadPlateaus(&pl,&ph)) {
+    // not captured yet.. hunt for them ourselves
+#endif // PILOT_ADC_TRIGGER
   //  uint32_t sms = millis();
   for (int i=0;i < PILOT_LOOP_CNT;i++) {
     uint16_t reading = adcPilot.read();  // measures pilot voltage
@@ -1423,6 +1715,9 @@ void J1772EVSEController::ReadPilot(uint16_t *plow,uint16_t *phigh)
       pl = reading;
     }
   }
+#ifdef PILOT_ADC_TRIGGER
+  }
+#endif // PILOT_ADC_TRIGGER
   //  RAPI_SERIAL_PORT.print("pilotread ");RAPI_SERIAL_PORT.println(millis()-sms);
 
   if (m_Pilot.GetState() != PILOT_STATE_N12) {
@@ -1461,12 +1756,76 @@ void J1772EVSEController::ReadPilot(uint16_t *plow,uint16_t *phigh)
 //Negative Voltage - States B, C, D, and F -11.40 -12.00 -12.60
 void J1772EVSEController::Update(uint8_t forcetransition)
 {
+  LATENCY_PROBE(LAT_UPDATE);
+
   uint16_t plow;
   uint16_t phigh = ADC_MAX;
 
   unsigned long curms = millis();
   WDT_RESET();
 
+#ifdef ISR_EVENT_QUEUE
+  drainEvents();
+#endif // ISR_EVENT_QUEUE
+
+#ifdef STAGED_POST
+  if (PostRun()) {
+    m_PrevEvseState = m_EvseState; // cancel state transition
+    return;
+  }
+#endif // STAGED_POST
+
+#ifdef ZC_TRACKER
+  {
+    // keep the last good value while the tracker is unlocked
+    uint16_t f = g_ZcTracker.GetFreqX100();
+    if (f) m_AcFreqX100 = f;
+  }
+#endif // ZC_TRACKER
+
+  if (m_FaultShutdownDelayMs) {
+    // pilot is P12, waiting for EV to stop drawing current
+    unsigned long elapsed = millis() - m_FaultShutdownStartMs;
+    if (elapsed < m_FaultShutdownDelayMs) {
+#ifdef RELAY_TIMER
+      // the pass after the deadline may come late. the relay timer opens
+      // the relay on time, re-armed w/ the time left on every pass
+      uint16_t leftms = m_FaultShutdownDelayMs - elapsed;
+      if (leftms <= FAULT_SHUTDOWN_TIMER_MS) {
+	relayTimerStart(leftms * 1000UL,relayOpenIsr);
+      }
+#endif // RELAY_TIMER
+      m_PrevEvseState = m_EvseState; // cancel state transition
+      return;
+    }
+    m_FaultShutdownDelayMs = 0;
+    chargingOff(); // open the EVSE relays hopefully the EV has already disconnected by now by the J1772 specification
+    // unless RAPI/menu disabled or put us to sleep in the meantime
+    if (InFaultState()) {
+      // spin until EV is disconnected
+      HardFault(1);
+    }
+    return;
+  }
+
+  if (InHardFault()) {
+    // if pilot not in N12 state, we can recover from the hard fault when EV
+    // is unplugged
+    if (m_Pilot.GetState() != PILOT_STATE_N12) {
+      ReadPilot(); // update EV connect state
+      if (!EvConnected() && m_HardFaultRecoverable) {
+	// EV disconnected - cancel fault. stuck relay left the pilot as it
+	// was, so don't keep offering current until we're back in state A
+	m_Pilot.SetState(PILOT_STATE_P12);
+	m_EvseState = EVSE_STATE_UNKNOWN;
+	ClrHardFault();
+	return;
+      }
+    }
+    m_PrevEvseState = m_EvseState; // cancel state transition
+    return;
+  }
+
   if (m_EvseState == EVSE_STATE_DISABLED) {
     m_PrevEvseState = m_EvseState; // cancel state transition
     return;
@@ -1709,6 +2068,9 @@ if (TempChkEnabled()) {
 
  uint8_t prevpilotstate = m_PilotState;
  uint8_t tmppilotstate = EVSE_STATE_UNKNOWN;
+#ifdef PILOT_HYSTERESIS
+ uint8_t pband = pilotBand(phigh,m_TmpPilotState);
+#endif
 
   if (nofault) {
     if ((prevevsestate >= EVSE_FAULT_STATE_BEGIN) &&
@@ -1724,17 +2086,29 @@ if (TempChkEnabled()) {
       tmpevsestate = EVSE_STATE_DIODE_CHK_FAILED;
       tmppilotstate = EVSE_STATE_DIODE_CHK_FAILED;
     }
+#ifdef PILOT_HYSTERESIS
+    else if (pband == EVSE_STATE_A) {
+#else
     else if (phigh >= m_ThreshData.m_ThreshAB) {
+#endif
       // 12V EV not connected
       tmpevsestate = EVSE_STATE_A;
       tmppilotstate = EVSE_STATE_A;
     }
+#ifdef PILOT_HYSTERESIS
+    else if (pband == EVSE_STATE_B) {
+#else
     else if (phigh >= m_ThreshData.m_ThreshBC) {
+#endif
       // 9V EV connected, waiting for ready to charge
       tmpevsestate = EVSE_STATE_B;
       tmppilotstate = EVSE_STATE_B;
     }
+#ifdef PILOT_HYSTERESIS
+    else if (pband == EVSE_STATE_C) {
+#else
     else if (phigh  >= m_ThreshData.m_ThreshCD) {
+#endif
       // 6V ready to charge
       tmppilotstate = EVSE_STATE_C;
       if (m_Pilot.GetState() == PILOT_STATE_PWM) {
@@ -1791,12 +2165,26 @@ if (TempChkEnabled()) {
 
     // debounce state transitions
     if (tmpevsestate != prevevsestate) {
+#ifdef DEBOUNCE_SAMPLES
+      if (tmpevsestate != m_TmpEvseState) {
+        m_TmpEvseStateStart = curms;
+	m_TmpEvseStateCnt = 0;
+      }
+      // this reading counts too, so a count of 1 goes on the first one
+      if (m_TmpEvseStateCnt != 255) m_TmpEvseStateCnt++;
+      uint8_t cnt = m_DebounceCnt[debounceIdx(tmpevsestate)];
+      if ((m_TmpEvseStateCnt >= cnt) &&
+	  ((cnt == 1) || ((curms - m_TmpEvseStateStart) >= DEBOUNCE_MIN_MS))) {
+	m_EvseState = tmpevsestate;
+      }
+#else // !DEBOUNCE_SAMPLES
       if (tmpevsestate != m_TmpEvseState) {
         m_TmpEvseStateStart = curms;
       }
       else if ((curms - m_TmpEvseStateStart) >= ((tmpevsestate == EVSE_STATE_A) ? DELAY_STATE_TRANSITION_A : DELAY_STATE_TRANSITION)) {
         m_EvseState = tmpevsestate;
       }
+#endif // DEBOUNCE_SAMPLES
     }
   } // nofault
 
@@ -1876,6 +2264,9 @@ if (TempChkEnabled()) {
   
   // state transition
   if (forcetransition || (m_EvseState != prevevsestate)) {
+#ifdef STAGED_POST
+    if (!m_ReadyMs) m_ReadyMs = millis(); // first state after POST
+#endif
     if (m_EvseState == EVSE_STATE_A) { // EV not connected
       chargingOff(); // turn off charging current
       m_Pilot.SetState(PILOT_STATE_P12);
@@ -1913,6 +2304,16 @@ if (TempChkEnabled()) {
     else if (m_EvseState == EVSE_STATE_C) {
       m_Pilot.SetPWM(m_CurrentCapacity);
 #if defined(UL_GFI_SELFTEST) && !defined(NOCHECKS)
+#ifdef GFI_TEST_TIMER
+      // test GFI before closing relay. the pulse train runs from a timer,
+      // and the relay is closed below in a later Update() once it passes.
+      // a forced transition while charging doesn't test again
+      if (GfiSelfTestEnabled() && !chargingIsOn()) {
+        m_Gfi.SelfTestStart();
+        // keep GetElapsedChargeTime() sane until chargingOn()
+        m_ChargeOnTimeMS = curms;
+      }
+#else // !GFI_TEST_TIMER
       // test GFI before closing relay
       if (GfiSelfTestEnabled() && m_Gfi.SelfTest()) {
        // GFI test failed - hard fault
@@ -1921,6 +2322,7 @@ if (TempChkEnabled()) {
 	HardFault(1);
 	return;
       }
+#endif // GFI_TEST_TIMER
 #endif // UL_GFI_SELFTEST
 
 #ifdef FT_GFI_LOCKOUT
@@ -1935,6 +2337,9 @@ if (TempChkEnabled()) {
       delay(150);
 #endif // FT_GFI_LOCKOUT
 
+#if defined(UL_GFI_SELFTEST) && !defined(NOCHECKS) && defined(GFI_TEST_TIMER)
+      if (!m_Gfi.SelfTestActive())
+#endif
       chargingOn(); // turn on charging current
     }
     else if (m_EvseState == EVSE_STATE_D) {
@@ -1952,12 +2357,8 @@ if (TempChkEnabled()) {
     else if (m_EvseState == EVSE_STATE_OVER_TEMPERATURE) {
       // vehicle state Over Teperature within the EVSE
       m_Pilot.SetState(PILOT_STATE_P12); // Signal the EV to pause, high current should cease within five seconds
-      
-      while ((millis()-curms) < 5000) {
-	wdt_reset();
-      }
-      chargingOff(); // open the EVSE relays hopefully the EV has already disconnected by now by the J1772 specification
-      HardFault(1);
+      // Update() opens the relay and hard faults when the 5 sec are up
+      startFaultShutdown(curms,5000);
     }
 #endif //TEMPERATURE_MONITORING
     else if (m_EvseState == EVSE_STATE_DIODE_CHK_FAILED) {
@@ -2014,6 +2415,27 @@ if (TempChkEnabled()) {
 #endif //#ifdef SERDBG
   } // state transition
 
+#if defined(UL_GFI_SELFTEST) && !defined(NOCHECKS) && defined(GFI_TEST_TIMER)
+  if (m_Gfi.SelfTestActive()) {
+    if (m_EvseState != EVSE_STATE_C) {
+      m_Gfi.SelfTestAbort();
+    }
+    else {
+      uint8_t rc = m_Gfi.SelfTestPoll();
+      if (rc == 0) {
+	chargingOn(); // turn on charging current
+      }
+      else if (rc != GFI_TEST_BUSY) {
+	// GFI test failed - hard fault
+        m_EvseState = EVSE_STATE_GFI_TEST_FAILED;
+	m_Pilot.SetState(PILOT_STATE_P12);
+	HardFault(1);
+	return;
+      }
+    }
+  }
+#endif // GFI_TEST_TIMER
+
 #ifdef AUTH_LOCK
   if ((m_EvseState != prevevsestate) ||
       (m_PilotState != prevpilotstate)) {
@@ -2033,25 +2455,39 @@ if (TempChkEnabled()) {
 
   m_PrevEvseState = prevevsestate;
 
-#ifdef VOLTMETER
-  ReadVoltmeter();
-#endif // VOLTMETER
 #ifdef AMMETER
-  if (((m_EvseState == EVSE_STATE_C) && (m_CurrentScaleFactor > 0))
+  uint8_t ammeteron = ((m_EvseState == EVSE_STATE_C) && (m_CurrentScaleFactor > 0))
 #ifdef ECVF_AMMETER_CAL  
       || AmmeterCalEnabled()
 #endif
-      ) {
+    ;
+#endif // AMMETER
+#ifdef VOLTMETER
+#if defined(POWERMETER) && !defined(FAKE_CHARGING_CURRENT)
+  // readPowerMeter() below samples the voltmeter along with the ammeter
+  if (!ammeteron)
+#endif
+  ReadVoltmeter();
+#endif // VOLTMETER
+#ifdef AMMETER
+  if (ammeteron) {
     
 #ifndef FAKE_CHARGING_CURRENT
-    readAmmeter();
-    uint32_t ma = MovingAverage(m_AmmeterReading);
-    if (ma != 0xffffffff) {
-      m_ChargingCurrent = ma * m_CurrentScaleFactor - m_AmmeterCurrentOffset;  // subtract it
-      if (m_ChargingCurrent < 0) {
-	m_ChargingCurrent = 0;
+    // only feed completed cycles into the moving average
+#ifdef POWERMETER
+    if (readPowerMeter()) {
+#else
+    if (readAmmeter()) {
+#endif // POWERMETER
+      int32_t ma = MovingAverage(m_AmmeterReading) * m_CurrentScaleFactor - m_AmmeterCurrentOffset;  // subtract it
+      if (ma < 0) {
+	ma = 0;
       }
-      g_OBD.SetAmmeterDirty(1);
+      // only redraw when the displayed 0.1A digit changes
+      if ((ma / 100) != (m_ChargingCurrent / 100)) {
+	g_OBD.SetAmmeterDirty(1);
+      }
+      m_ChargingCurrent = ma;
     }
 #endif // !FAKE_CHARGING_CURRENT
   }
@@ -2071,17 +2507,12 @@ if (TempChkEnabled()) {
             m_EvseState = EVSE_STATE_OVER_CURRENT;
 
             m_Pilot.SetState(PILOT_STATE_P12); // Signal the EV to pause
-            curms = millis();
-            while ((millis() - curms) < 1000) { // give EV 1s to stop charging
-              wdt_reset();
-            }
-            chargingOff(); // open the EVSE relays hopefully the EV
-                           // has already discon
-
-            // spin until EV is disconnected
-            HardFault(1);
+            // give EV 1s to stop charging. Update() then opens the relay
+            // and hard faults
+            startFaultShutdown(millis(),1000);
 
             m_OverCurrentStartMs = 0; // clear overcurrent
+            return;
           }
         }
         else {
@@ -2127,10 +2558,9 @@ if (TempChkEnabled()) {
         else {
 	  g_TempMonitor.SetOverTemperatureShutdown(setit-3);
 	}
+	// updates the PWM if it's on. turning it on here would offer current
+	// in state A, in a fault or while auth locked
 	SetCurrentCapacity(currcap,0,1);
-    	if (m_Pilot.GetState() != PILOT_STATE_PWM) {
-    	  m_Pilot.SetPWM(m_CurrentCapacity);
-        }
       }
     }
 #endif // TEMPERATURE_MONITORING
@@ -2165,10 +2595,9 @@ if (TempChkEnabled()) {
         else {
 	  g_TempMonitor.SetOverTemperatureShutdown(setit-3);
 	}
+	// updates the PWM if it's on. turning it on here would offer current
+	// in state A, in a fault or while auth locked
 	SetCurrentCapacity(currcap,0,1);
-    	if (m_Pilot.GetState() != PILOT_STATE_PWM) {
-    	  m_Pilot.SetPWM(m_CurrentCapacity);
-        }
       }
     }
   }
@@ -2300,7 +2729,7 @@ int J1772EVSEController::SetCurrentCapacity(uint8_t amps,uint8_t updatelcd,uint8
 	#ifdef DEBUG_HS
 	  Serial.println(F("SetCurrentCapacity: Writing to EEPROM!"));
 	#endif
-    eeprom_write_byte((uint8_t*)((GetCurSvcLevel() == 1) ? EOFS_CURRENT_CAPACITY_L1 : EOFS_CURRENT_CAPACITY_L2),(byte)m_CurrentCapacity);
+    eeprom_write_byte((uint8_t*)(uintptr_t)((GetCurSvcLevel() == 1) ? EOFS_CURRENT_CAPACITY_L1 : EOFS_CURRENT_CAPACITY_L2),(byte)m_CurrentCapacity);
   }
 
   if (m_Pilot.GetState() == PILOT_STATE_PWM) {
@@ -2497,6 +2926,8 @@ void J1772EVSEController::SetVoltmeter(uint16_t scale,uint32_t offset)
 
 uint32_t J1772EVSEController::ReadVoltmeter()
 {
+  LATENCY_PROBE(LAT_VOLTMETER);
+
   unsigned int peak = 0;
   for(uint32_t start_time = millis(); (millis() - start_time) < VOLTMETER_POLL_INTERVAL; ) {
     unsigned int val = adcVoltMeter.read();
@@ -2505,6 +2936,137 @@ uint32_t J1772EVSEController::ReadVoltmeter()
   m_Voltage = ((uint32_t)peak) * ((uint32_t)m_VoltScaleFactor) + m_VoltOffset;
   return m_Voltage;
 }
+
+#ifdef POWERMETER
+// sample the voltmeter and ammeter interleaved in a single window, instead
+// of ReadVoltmeter() and readAmmeter() back to back.
+// sets m_Voltage (peak, as ReadVoltmeter()), m_AmmeterReading (RMS, as
+// readAmmeter()), m_RealPower and m_PowerFactor
+//
+// n.b. the voltmeter input only sees the positive half cycle, so real power
+// is taken as twice the mean of v*i over the positive half. by symmetry the
+// negative half contributes the same (-v * -i)
+uint8_t J1772EVSEController::readPowerMeter()
+{
+  LATENCY_PROBE(LAT_AMMETER); // voltmeter is sampled in the same window
+  WDT_RESET();
+
+#ifdef AMMETER_BACKGROUND
+  // the sampler owns the ADC and already has the current. only the
+  // voltmeter is read here, once per new reading
+  if (!readAmmeter()) return 0;
+  ReadVoltmeter();
+#else // !AMMETER_BACKGROUND
+  unsigned int vpeak = 0;
+  unsigned long isum = 0; // sum of i^2
+  int64_t visum = 0; // sum of v*i while v > 0. overflows 32 bits on SAMD
+  long vidsum = 0; // sum of i while v > 0
+  unsigned int sample_count = 0;
+  uint8_t zero_crossings = 0;
+  uint8_t complete = 0;
+  unsigned long last_zero_crossing_time = 0, now_ms;
+  uint8_t is_first_sample = 1;
+  uint16_t last_sample;
+#ifdef AMMETER_CYCLE_LOCK
+  uint16_t locksamps = ammeterLockSamples();
+  unsigned long next_us = micros();
+#else
+  const uint16_t locksamps = 0;
+#endif // AMMETER_CYCLE_LOCK
+  for(unsigned long start = millis(); ((now_ms = millis()) - start) < VOLTMETER_POLL_INTERVAL; ) {
+#ifdef AMMETER_CYCLE_LOCK
+    if (locksamps) {
+      long waitus = (long)(next_us - micros());
+      if (waitus > 0) delayMicroseconds(waitus);
+      next_us += 1000000UL / AMMETER_LOCK_SAMPLE_HZ;
+    }
+#endif // AMMETER_CYCLE_LOCK
+    unsigned int v = adcVoltMeter.read();
+    uint16_t sample = adcCurrent.read();
+    if (v > vpeak) vpeak = v;
+
+    if (locksamps) {
+      if (sample_count == locksamps) {
+	complete = 1;
+	break;
+      }
+    }
+    else {
+      // same zero crossing windowing as readAmmeter()
+      if (!is_first_sample && ((last_sample > ADC_HALF) != (sample > ADC_HALF))) {
+	if ((now_ms - last_zero_crossing_time) > CURRENT_ZERO_DEBOUNCE_INTERVAL) {
+	  zero_crossings++;
+	  last_zero_crossing_time = now_ms;
+	}
+      }
+      is_first_sample = 0;
+      last_sample = sample;
+      if (zero_crossings == 3) {
+	complete = 1;
+	break;
+      }
+      if (!zero_crossings) continue; // Still waiting to start sampling
+    }
+
+    long i = (long)sample - ADC_HALF;
+    isum += (unsigned long)(i * i);
+    if (v) {
+      visum += (long)v * i;
+      vidsum += i;
+    }
+    sample_count++;
+  }
+
+  m_Voltage = ((uint32_t)vpeak) * ((uint32_t)m_VoltScaleFactor) + m_VoltOffset;
+
+  if (!complete) {
+    // not oscillating
+    m_AmmeterReading = 0;
+    m_RealPower = 0;
+    m_PowerFactor = 0;
+    WDT_RESET();
+    return 1;
+  }
+  // can't happen w/ a whole window, but don't divide by it if it does
+  if (!sample_count) return 0;
+
+  m_AmmeterReading = ulong_sqrt(isum / sample_count);
+#endif // AMMETER_BACKGROUND
+
+  // apparent power, mW
+  int32_t ma = m_AmmeterReading * m_CurrentScaleFactor - m_AmmeterCurrentOffset;
+  int32_t va = (ma > 0) ? (int32_t)(m_Voltage / 100) * (ma / 10) : 0;
+
+#ifdef AMMETER_BACKGROUND
+  // w/o voltage and current samples side by side there's no real power.
+  // take the apparent power, and report the power factor as unknown (0)
+  m_RealPower = va;
+  m_PowerFactor = 0;
+#else // !AMMETER_BACKGROUND
+  // the voltmeter calibration maps peak counts to RMS mV, so
+  //   instantaneous mV = (v * m_VoltScaleFactor + m_VoltOffset) * sqrt(2)
+  //   instantaneous mA = i * m_CurrentScaleFactor
+  //   mW = 2 * mean(mV * mA) / 1000
+  // ordered to stay within 32 bits
+  long vi = ((long)m_VoltScaleFactor * (long)(visum / (int64_t)sample_count) +
+             (long)m_VoltOffset * (vidsum / (long)sample_count)) / 1000;
+  int32_t mw = (vi * m_CurrentScaleFactor / 8) * 181 / 8; // 181/64 = 2*sqrt(2)
+  if (mw < 0) mw = 0;
+  m_RealPower = mw;
+
+  if (va >= 1000) {
+    uint32_t pf = (uint32_t)mw / (uint32_t)(va / 1000);
+    m_PowerFactor = (pf > 1000) ? 1000 : pf;
+  }
+  else {
+    m_PowerFactor = 0;
+  }
+#endif // AMMETER_BACKGROUND
+
+  WDT_RESET();
+  return 1;
+}
+#endif // POWERMETER
 #endif // VOLTMETER
 
 #ifdef CHARGE_LIMIT
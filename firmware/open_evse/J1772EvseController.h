@@ -59,6 +59,15 @@ typedef struct threshdata {
   uint16_t m_ThreshDS; // diode short
 } THRESH_DATA,*PTHRESH_DATA;
 
+#ifdef DEBOUNCE_SAMPLES
+// J1772EVSEController::m_DebounceCnt indices
+#define DEBOUNCE_IDX_OTHER 4 // 0-3 = EVSE_STATE_A-EVSE_STATE_D
+#define DEBOUNCE_IDX_CNT 5
+inline uint8_t debounceIdx(uint8_t state) {
+  return ((state >= EVSE_STATE_A) && (state <= EVSE_STATE_D)) ? (state - EVSE_STATE_A) : DEBOUNCE_IDX_OTHER;
+}
+#endif // DEBOUNCE_SAMPLES
+
 typedef struct calibdata {
   uint16_t m_pMax;
   uint16_t m_pAvg;
@@ -142,6 +151,9 @@ typedef uint8_t (*EvseStateTransitionReqFunc)(uint8_t prevPilotState,uint8_t cur
 #define RLY_TEST_PIN_OPEN ACPIN1_OPEN
 
 class J1772EVSEController {
+#ifdef TARGET_HOST
+  friend struct AmmeterBench; // tests/bench calls readAmmeter(), MovingAverage()
+#endif
   J1772Pilot m_Pilot;
 #ifdef GFI
   Gfi m_Gfi;
@@ -184,6 +196,20 @@ class J1772EVSEController {
   uint8_t m_NoGndTripCnt; // contains tripcnt-1
   unsigned long m_StuckRelayStartTimeMS;
   uint8_t m_StuckRelayTripCnt; // contains tripcnt-1
+  // power on self test - see postStep()
+  uint8_t m_PostStage; // POST_xxx
+  uint8_t m_PostSvcState;
+#if !defined(OPENEVSE_2) && defined(AUTOSVCLEVEL)
+  uint8_t m_PostRelayOff,m_PostRelay1,m_PostRelay2; // ReadACPins() results
+#endif
+  uint16_t m_PostWaitMs; // current stage waits this long before running
+  unsigned long m_PostWaitStartMs;
+#ifdef STAGED_POST
+  unsigned long m_PostStartMs;
+  uint16_t m_PostMs; // how long the last POST took
+  uint8_t m_PostSvcLvl; // service level for initFinish()
+  unsigned long m_ReadyMs; // millis() at first state transition after POST
+#endif // STAGED_POST
 #endif // ADVPWR
 #ifdef RELAY_PWM
   uint8_t m_relayCloseMs; // #ms for DC pulse to close relay
@@ -203,6 +229,10 @@ class J1772EVSEController {
   uint8_t m_PilotState;
   unsigned long m_TmpEvseStateStart;
   unsigned long m_TmpPilotStateStart;
+#ifdef DEBOUNCE_SAMPLES
+  uint8_t m_TmpEvseStateCnt; // consecutive readings of m_TmpEvseState
+  uint8_t m_DebounceCnt[DEBOUNCE_IDX_CNT]; // by debounceIdx()
+#endif // DEBOUNCE_SAMPLES
   uint8_t m_MaxHwCurrentCapacity; // max L2 amps that can be set
   uint8_t m_CurrentCapacity; // max amps we can output
   unsigned long m_ChargeOnTimeMS; // millis() when relay last closed
@@ -219,6 +249,16 @@ class J1772EVSEController {
 #ifdef OVERCURRENT_THRESHOLD
   unsigned long m_OverCurrentStartMs;
 #endif // OVERCURRENT_THRESHOLD
+  // timed fault shutdown - pilot is P12, relay opens and we hard fault
+  // m_FaultShutdownDelayMs after m_FaultShutdownStartMs. 0 = not pending
+  unsigned long m_FaultShutdownStartMs;
+  uint16_t m_FaultShutdownDelayMs;
+  int8_t m_HardFaultRecoverable;
+
+  void startFaultShutdown(unsigned long startms,uint16_t delayms) {
+    m_FaultShutdownStartMs = startms;
+    m_FaultShutdownDelayMs = delayms;
+  }
 
 
   void setFlags(uint16_t flags) { 
@@ -260,18 +300,61 @@ class J1772EVSEController {
 #define OG 3 // open ground
 #define SR 4 // stuck relay
 #define FG 5 // GFI fault
-
+#define POST_BUSY 255 // postStep() not done yet
+// postStep() stages
+#define POST_IDLE        0
+#define POST_START       1
+#define POST_PILOT       2
+#define POST_RELAY1      3
+#define POST_RELAY2      4
+#define POST_RELAY2_READ 5
+#define POST_SVC_LEVEL   6
+#define POST_STUCK_RELAY 7
+#define POST_GFI         8
+#define POST_GFI_WAIT    9
+#define POST_FINISH     10
+#define POST_FAILED     11 // STAGED_POST: waiting to retry/hard faulted
+
+#ifndef STAGED_POST
   uint8_t doPost();
+#endif
+  void postStart();
+  uint8_t postStep();
+  void postWait(uint16_t ms) {
+    m_PostWaitStartMs = millis();
+    m_PostWaitMs = ms;
+  }
+  uint8_t postResult(uint8_t psvclvl,uint8_t *svclvl);
+#if !defined(OPENEVSE_2) && defined(AUTOSVCLEVEL)
+  void postRelay1(uint8_t on);
+  void postRelay2(uint8_t on);
+#endif
 #endif // ADVPWR
+  void initFinish(uint8_t svclvl);
   void chargingOn();
   void chargingOff(uint8_t emergency = 0);
+#ifdef PILOT_HYSTERESIS
+  uint8_t pilotBand(uint16_t phigh,uint8_t prevstate);
+#endif
+#ifdef ISR_EVENT_QUEUE
+  void drainEvents();
+#endif
+  void relayPinsOn();
+  void relayPinsOff();
 #ifdef RELAY_ZC_SWITCH
   void zcWaitRelay(uint8_t advanceMs);
   void zcWaitRelayClose();
   void zcWaitRelayOpen();
   void waitCurrentZero();
+#ifndef ZC_TRACKER
   uint32_t measureAcFreq(unsigned long *zcTimeMsOut);
 #endif
+#ifdef RELAY_TIMER
+  uint8_t zcScheduleRelay(uint8_t on,uint8_t advanceMs);
+  static void relayCloseIsr();
+  static void relayOpenIsr();
+#endif // RELAY_TIMER
+#endif // RELAY_ZC_SWITCH
   uint8_t chargingIsOn() { return vFlagIsSet(ECVF_CHARGING_ON); }
 
 #ifdef TIME_LIMIT
@@ -281,6 +364,8 @@ class J1772EVSEController {
 
 #ifdef AMMETER
   unsigned long m_AmmeterReading;
+  uint32_t m_AmmeterAvgAcc; // MovingAverage(): average << AMMETER_EMA_SHIFT
+  uint8_t m_AmmeterAvgSeed; // 1 = MovingAverage() starts over w/ next reading
   int32_t m_ChargingCurrent;
   int32_t m_AmmeterCurrentOffset;
   int32_t m_CurrentScaleFactor;
@@ -289,13 +374,28 @@ class J1772EVSEController {
   uint32_t m_chargeLimitTotWs; // total Ws limit
 #endif
 
-  void readAmmeter();
+  // returns 1 if m_AmmeterReading was refreshed with a new reading
+  uint8_t readAmmeter();
+  uint32_t MovingAverage(uint32_t samp);
+#ifdef AMMETER_CYCLE_LOCK
+  // # samples at AMMETER_LOCK_SAMPLE_HZ spanning AMMETER_LOCK_CYCLES mains
+  // cycles, or 0 if the mains frequency hasn't been measured yet
+  uint16_t ammeterLockSamples() {
+    return m_AcFreqX100 ? (uint16_t)(((uint32_t)AMMETER_LOCK_CYCLES*AMMETER_LOCK_SAMPLE_HZ*100UL + m_AcFreqX100/2) / m_AcFreqX100) : 0;
+  }
+#endif // AMMETER_CYCLE_LOCK
 #endif // AMMETER
 #ifdef VOLTMETER
   uint16_t m_VoltScaleFactor;
   uint32_t m_VoltOffset;
 #endif // VOLTMETER
   uint32_t m_Voltage; // mV
+#ifdef POWERMETER
+  int32_t m_RealPower; // mW
+  uint16_t m_PowerFactor; // x1000
+
+  uint8_t readPowerMeter();
+#endif // POWERMETER
 
 #ifdef HEARTBEAT_SUPERVISION
   uint16_t      m_HsInterval;   // Number of seconds HS will wait for a heartbeat before reducing ampacity to m_IFallback.  If 0 disable.
@@ -307,7 +407,17 @@ class J1772EVSEController {
 public:
   J1772EVSEController();
   void Init();
+#ifdef STAGED_POST
+  uint8_t PostRun();
+  uint16_t GetPostMs() { return m_PostMs; }
+  unsigned long GetReadyMs() { return m_ReadyMs; } // 0 = not ready yet
+#endif // STAGED_POST
   void Update(uint8_t forcetransition=0); // read sensors
+#ifdef DEBOUNCE_SAMPLES
+  // idx = debounceIdx() of the destination state
+  void SetDebounceCnt(uint8_t idx,uint8_t cnt) { m_DebounceCnt[idx] = cnt ? cnt : 1; }
+  uint8_t GetDebounceCnt(uint8_t idx) { return m_DebounceCnt[idx]; }
+#endif // DEBOUNCE_SAMPLES
   void Enable();
   void Disable(); // panic stop - open relays abruptly
   void Sleep(); // graceful stop - e.g. waiting for timer to fire- give the EV time to stop charging first
@@ -335,6 +445,14 @@ public:
   int8_t InFaultState() {
     return ((m_EvseState >= EVSE_FAULT_STATE_BEGIN) && (m_EvseState <= EVSE_FAULT_STATE_END));
   }
+  // over temperature/overcurrent: pilot is P12, relay not opened yet
+  uint8_t FaultShutdownPending() { return m_FaultShutdownDelayMs ? 1 : 0; }
+#ifdef STAGED_POST
+  uint8_t PostIsRunning() { return (m_PostStage != POST_IDLE) ? 1 : 0; }
+#endif // STAGED_POST
+#ifdef GFI_TEST_TIMER
+  uint8_t GfiSelfTestActive() { return m_Gfi.SelfTestActive(); }
+#endif // GFI_TEST_TIMER
 
 #ifdef RELAY_PWM
   void setPwmPinParms(uint8_t delayms,uint8_t pwm) {
@@ -438,8 +556,8 @@ public:
   uint8_t AutoSvcLvlSkipped() { return vFlagIsSet(ECVF_AUTOSVCLVL_SKIPPED); }
 #else
   uint8_t AutoSvcLevelEnabled() { return 0; }
-  void EnableAutoSvcLevel(uint8_t tf) {}
-  void SetAutoSvcLvlSkipped(uint8_t tf) {}
+  void EnableAutoSvcLevel(uint8_t) {}
+  void SetAutoSvcLvlSkipped(uint8_t) {}
   uint8_t AutoSvcLvlSkipped() { return 1; }
 #endif // AUTOSVCLEVEL
   void SetNoGndTripped();
@@ -518,6 +636,10 @@ int GetHearbeatTrigger();
   void SetVoltmeter(uint16_t scale,uint32_t offset);
   uint32_t ReadVoltmeter();
 #endif // VOLTMETER
+#ifdef POWERMETER
+  int32_t GetRealPower() { return m_RealPower; } // mW
+  uint16_t GetPowerFactor() { return m_PowerFactor; } // x1000
+#endif // POWERMETER
 #ifdef AMMETER
   int32_t GetChargingCurrent() {
 #ifdef OCPPDBG
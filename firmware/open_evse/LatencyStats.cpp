@@ -0,0 +1,68 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+#ifdef LATENCY_STATS
+
+LatencyStats g_LatencyStats;
+
+void LatencyStats::Record(uint8_t id,uint32_t us)
+{
+  LATENCY_HIST *h = &m_Hist[id];
+
+  if (us > h->maxUs) h->maxUs = us;
+  h->cnt++;
+
+  uint8_t b = 0;
+  uint32_t u = us;
+  while ((u > 1) && (b < (LAT_BUCKETS-1))) {
+    u >>= 1;
+    b++;
+  }
+  h->bucket[b]++;
+}
+
+// call once at the top of every loop()
+void LatencyStats::LoopTick()
+{
+  unsigned long usnow = micros();
+  if (m_LastLoopUs) {
+    uint32_t us = usnow - m_LastLoopUs;
+    if (us > m_MaxLoopUs) m_MaxLoopUs = us;
+  }
+  m_LastLoopUs = usnow;
+}
+
+// watchdog time left at the end of the slowest loop() pass, assuming
+// the WDT_RESET() at the top of loop() was the only one in that pass
+int32_t LatencyStats::GetWdtMarginMs()
+{
+#ifdef WATCHDOG
+  return (int32_t)WATCHDOG_TIMEOUT_MS - (int32_t)(m_MaxLoopUs / 1000UL);
+#else
+  return -1;
+#endif // WATCHDOG
+}
+
+#endif // LATENCY_STATS
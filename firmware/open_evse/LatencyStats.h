@@ -0,0 +1,82 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+#ifdef LATENCY_STATS
+
+// latency probe IDs
+enum {
+  LAT_UPDATE,    // J1772EVSEController::Update()
+  LAT_PILOT,     // J1772EVSEController::ReadPilot()
+  LAT_AMMETER,   // readAmmeter() / readPowerMeter()
+  LAT_VOLTMETER, // ReadVoltmeter()
+  LAT_RAPI,      // RapiDoCmd()
+  LAT_LCD,       // OnboardDisplay::Update()
+  LAT_TEMP,      // TempMonitor::Read()
+  LAT_EVENT,     // ISR event queued until drained (ISR_EVENT_QUEUE)
+  LAT_CNT
+};
+
+// bucket n counts runs of 2^n..2^(n+1)-1 us. bucket 0 also counts 0us,
+// and the last bucket counts everything >= 2^(LAT_BUCKETS-1) us
+#define LAT_BUCKETS 16
+
+typedef struct latency_hist {
+  uint32_t bucket[LAT_BUCKETS];
+  uint32_t cnt;
+  uint32_t maxUs;
+} LATENCY_HIST;
+
+class LatencyStats {
+  LATENCY_HIST m_Hist[LAT_CNT];
+  unsigned long m_LastLoopUs;
+  uint32_t m_MaxLoopUs;
+public:
+  LatencyStats() {}
+  void Record(uint8_t id,uint32_t us);
+  void LoopTick();
+  const LATENCY_HIST *GetHist(uint8_t id) {
+    return (id < LAT_CNT) ? &m_Hist[id] : NULL;
+  }
+  uint32_t GetMaxLoopUs() { return m_MaxLoopUs; }
+  int32_t GetWdtMarginMs();
+};
+
+extern LatencyStats g_LatencyStats;
+
+// times the enclosing scope
+class LatencyProbe {
+  unsigned long m_StartUs;
+  uint8_t m_Id;
+public:
+  LatencyProbe(uint8_t id) { m_Id = id; m_StartUs = micros(); }
+  ~LatencyProbe() { g_LatencyStats.Record(m_Id,micros()-m_StartUs); }
+};
+
+#define LATENCY_PROBE(id) LatencyProbe _latprobe(id)
+#define LATENCY_LOOP_TICK() g_LatencyStats.LoopTick()
+#else
+#define LATENCY_PROBE(id)
+#define LATENCY_LOOP_TICK()
+#endif // LATENCY_STATS
@@ -0,0 +1,58 @@
+// -*- C++ -*-
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+// pilot classification w/ hysteresis (PILOT_HYSTERESIS)
+// n.b. keep this file free of Arduino/target dependencies so it can be
+// compiled on a host as-is
+#include <stdint.h>
+
+// A/B, B/C and C/D thresholds, by where the last reading was:
+// [0] above the boundary - has to drop below thresh-hyst to cross
+// [1] unknown - plain thresh
+// [2] below the boundary - has to reach thresh+hyst to cross
+#define PILOT_BAND_LO(t,hyst) ((uint16_t)((t)-(hyst)))
+#define PILOT_BAND_HI(t,hyst) ((uint16_t)((t)+(hyst)))
+#define PILOT_BAND_TABLE(ab,bc,cd,hyst) {				\
+    { PILOT_BAND_LO(ab,hyst),PILOT_BAND_LO(bc,hyst),PILOT_BAND_LO(cd,hyst) }, \
+    { (ab),(bc),(cd) },							\
+    { PILOT_BAND_HI(ab,hyst),PILOT_BAND_HI(bc,hyst),PILOT_BAND_HI(cd,hyst) } \
+  }
+
+// fetches a table entry. define as pgm_read_word() for a PROGMEM table
+#ifndef PILOT_BAND_READ
+#define PILOT_BAND_READ(p) (*(p))
+#endif
+
+// classify phigh as band 0-3 = state A, B, C, or D and below.
+// prevband is the last reading's band; anything but 0-3 means no
+// hysteresis
+static inline uint8_t pilotBandOf(const uint16_t thresh[3][3],uint16_t phigh,
+                                  uint8_t prevband)
+{
+  uint8_t known = (prevband <= 3);
+  uint8_t band = 0;
+  for (uint8_t i=0;i < 3;i++) {
+    // boundary i is between bands i and i+1
+    uint8_t row = known ? ((prevband > i) ? 2 : 0) : 1;
+    band += (phigh < PILOT_BAND_READ(&thresh[row][i])) ? 1 : 0;
+  }
+  return band;
+}
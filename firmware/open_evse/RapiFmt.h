@@ -0,0 +1,72 @@
+// -*- C++ -*-
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+// number formatting for RAPI_STREAM responses, instead of sprintf()
+// n.b. keep this file free of Arduino/target dependencies so it can be
+// compiled on a host as-is
+#include <stdint.h>
+
+// buffer sizes, w/ the terminating NUL
+#define RAPI_FMT_HEX_LEN 9
+#define RAPI_FMT_DEC_LEN 12
+
+// each writes a NUL terminated string to s and returns its length
+
+// as %0<width>x, or %0<width>X w/ a = 'A'
+static inline uint8_t rapiFmtHex(char *s,uint32_t u,uint8_t width,char a)
+{
+  char digits[8];
+  uint8_t n = 0;
+  do {
+    uint8_t d = u & 0xf;
+    digits[n++] = (d < 10) ? ('0' + d) : (a + d - 10);
+    u >>= 4;
+  } while (u || (n < width));
+  uint8_t len = n;
+  while (n) *(s++) = digits[--n];
+  *s = '\0';
+  return len;
+}
+
+// as %lu
+static inline uint8_t rapiFmtUDec(char *s,uint32_t u)
+{
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    digits[n++] = '0' + (u % 10);
+    u /= 10;
+  } while (u);
+  uint8_t len = n;
+  while (n) *(s++) = digits[--n];
+  *s = '\0';
+  return len;
+}
+
+// as %ld
+static inline uint8_t rapiFmtDec(char *s,int32_t i)
+{
+  if (i < 0) {
+    *s = '-';
+    return rapiFmtUDec(s+1,-(uint32_t)i) + 1;
+  }
+  return rapiFmtUDec(s,(uint32_t)i);
+}
@@ -0,0 +1,151 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+#ifdef TASK_SCHEDULER
+
+static inline void incSat(uint16_t &cnt)
+{
+  if (cnt != 0xffff) cnt++;
+}
+
+void TaskScheduler::Init(const TASK *tasks,TASK_STATS *stats,uint8_t taskcnt)
+{
+  m_Tasks = tasks;
+  m_Stats = stats;
+  m_TaskCnt = taskcnt;
+  ClrStats();
+}
+
+void TaskScheduler::ClrStats()
+{
+  unsigned long msnow = millis();
+  for (uint8_t i=0;i < m_TaskCnt;i++) {
+    memset(&m_Stats[i],0,sizeof(m_Stats[i]));
+    m_Stats[i].nextMs = msnow;
+  }
+#ifdef IDLE_SLEEP
+  m_IdleUs = 0;
+  m_WinStartUs = micros();
+  m_IdlePct = 0;
+#endif // IDLE_SLEEP
+}
+
+//
+// run every task that is due, highest priority first.
+// event triggered runs (ready() != 0) always run - the event might not
+// still be pending on the next pass. a periodic run is deferred if its
+// budget doesn't fit before the next deadline of a higher priority task,
+// unless it is already a full period late, so low priority I2C work can't
+// make EVSE Update() late, and can't itself be starved forever
+// returns the number of tasks that ran
+//
+uint8_t TaskScheduler::Run()
+{
+  unsigned long slackus = 0xffffffffUL; // time until next higher prio deadline
+  uint8_t rancnt = 0;
+
+  for (uint8_t i=0;i < m_TaskCnt;i++) {
+    const TASK *t = &m_Tasks[i];
+    TASK_STATS *s = &m_Stats[i];
+    unsigned long msnow = millis();
+    uint8_t event = (t->ready && t->ready()) ? 1 : 0;
+    uint8_t due = 0;
+
+    if (t->periodMs) {
+      long late = (long)(msnow - s->nextMs);
+      if (late >= (long)t->periodMs) {
+	incSat(s->misses);
+	due = 1;
+      }
+      else if ((late >= 0) && (t->budgetUs <= slackus)) {
+	due = 1;
+      }
+    }
+
+    if (event || due) {
+      unsigned long us = micros();
+      t->run();
+      us = micros() - us;
+
+      rancnt++;
+      incSat(s->runs);
+      if (us > t->budgetUs) incSat(s->overruns);
+      if (us > 0xffff) us = 0xffff;
+      if (us > s->maxUs) s->maxUs = us;
+
+      if (t->periodMs) {
+	msnow = millis();
+	if (due) s->nextMs += t->periodMs;
+	// after an event run, or if we fell behind, restart the period
+	// from now instead of bursting to catch up
+	if (!due || ((long)(msnow - s->nextMs) >= 0)) {
+	  s->nextMs = msnow + t->periodMs;
+	}
+      }
+    }
+
+    if (t->periodMs) {
+      long left = (long)(s->nextMs - millis());
+      if (left < 0) left = 0;
+      if ((unsigned long)left*1000UL < slackus) slackus = (unsigned long)left*1000UL;
+    }
+  }
+
+#ifdef IDLE_SLEEP
+  // keep the window rolling while we're too busy to sleep
+  idleAcct(0);
+#endif // IDLE_SLEEP
+  return rancnt;
+}
+
+#ifdef IDLE_SLEEP
+void TaskScheduler::idleAcct(unsigned long sleptus)
+{
+  unsigned long usnow = micros();
+  m_IdleUs += sleptus;
+  unsigned long winus = usnow - m_WinStartUs;
+  if (winus >= IDLE_WINDOW_US) {
+    m_IdlePct = (uint8_t)(m_IdleUs / (winus / 100UL));
+    m_IdleUs = 0;
+    m_WinStartUs = usnow;
+  }
+}
+
+//
+// call when Run() ran nothing. nothing in the task table is interrupt
+// driven except through ready(), and every wakeup source (tick, serial RX,
+// GFI, ZC) is an interrupt, so sleeping until the next one delays an event
+// task by at most one tick. the SAMD ammeter sampler's ticks don't end the
+// sleep (see idleSleep()), but their ISR time is counted as idle
+//
+void TaskScheduler::Idle()
+{
+  unsigned long us = micros();
+  idleSleep();
+  idleAcct(micros() - us);
+}
+#endif // IDLE_SLEEP
+
+#endif // TASK_SCHEDULER
@@ -0,0 +1,82 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+#ifdef TASK_SCHEDULER
+
+typedef void (*TaskFunc)();
+typedef uint8_t (*TaskReadyFunc)();
+
+// one entry per task. the table is in priority order - entry 0 is the
+// highest priority. every pass of Run() visits each task at most once,
+// so a task is never delayed by more than one run of each task below it
+typedef struct task {
+  TaskFunc run;
+  TaskReadyFunc ready; // event trigger, NULL if purely periodic
+  uint16_t periodMs;   // 0 = run only when ready() returns nonzero
+  uint16_t budgetUs;   // worst case run time
+} TASK;
+
+typedef struct task_stats {
+  unsigned long nextMs; // next periodic deadline
+  uint16_t runs;
+  uint16_t misses;      // periodic run started a full period late
+  uint16_t overruns;    // run took longer than budgetUs
+  uint16_t maxUs;       // longest run, saturates at 0xffff
+} TASK_STATS;
+
+#ifdef IDLE_SLEEP
+// idle percentage is recomputed once per window
+#define IDLE_WINDOW_US 1000000UL
+#endif // IDLE_SLEEP
+
+class TaskScheduler {
+  const TASK *m_Tasks;
+  TASK_STATS *m_Stats;
+  uint8_t m_TaskCnt;
+#ifdef IDLE_SLEEP
+  unsigned long m_IdleUs;   // time asleep in current window
+  unsigned long m_WinStartUs;
+  uint8_t m_IdlePct;        // idle % of last complete window
+
+  void idleAcct(unsigned long sleptus);
+#endif // IDLE_SLEEP
+public:
+  TaskScheduler() {}
+  void Init(const TASK *tasks,TASK_STATS *stats,uint8_t taskcnt);
+  uint8_t Run();
+  void ClrStats();
+  uint8_t GetTaskCnt() { return m_TaskCnt; }
+#ifdef IDLE_SLEEP
+  void Idle();
+  uint8_t GetIdlePct() { return m_IdlePct; }
+#endif // IDLE_SLEEP
+  const TASK_STATS *GetStats(uint8_t idx) {
+    return (idx < m_TaskCnt) ? &m_Stats[idx] : NULL;
+  }
+};
+
+extern TaskScheduler g_Scheduler;
+
+#endif // TASK_SCHEDULER
@@ -0,0 +1,112 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+#ifdef ZC_TRACKER
+
+ZcTracker g_ZcTracker;
+
+// us = micros() of a voltage zero crossing. called from ISR
+void ZcTracker::Crossing(uint32_t us)
+{
+  if (!m_HaveZc) {
+    m_HaveZc = 1;
+    reset(us);
+    return;
+  }
+
+  uint32_t dt = us - m_ZcUs;
+  uint32_t half = m_HalfUsX16 >> 4;
+
+  if (!half) { // acquiring - take the first plausible interval
+    if (dt < ZC_MIN_HALF_US) return; // edge bounce
+    if (dt <= ZC_MAX_HALF_US) {
+      m_HalfUsX16 = dt << 4;
+      m_LockCnt = 1;
+    }
+    m_ZcUs = us;
+    return;
+  }
+
+  // edge bounce. the phase correction can leave m_ZcUs a little after
+  // the crossing, so dt can also be just under 0
+  if ((dt < (half >> 1)) || (dt > (uint32_t)-half)) return;
+
+  // # of half periods since the last crossing, normally 1
+  uint32_t n = (dt + (half >> 1)) / half;
+  int32_t err = (int32_t)(dt - n*half); // phase error vs. prediction
+  if ((n > ZC_MAX_MISSED) || (err > (int32_t)(half >> 2)) || (err < -(int32_t)(half >> 2))) {
+    // lost it - start over from this crossing
+    reset(us);
+    return;
+  }
+
+  // PI loop filter: pull phase 1/4 of the way to the measured crossing,
+  // and period 1/16 of the way
+  m_ZcUs += n*half + err/4;
+  uint32_t halfx16 = m_HalfUsX16 + err/(int32_t)n;
+  if ((halfx16 < (ZC_MIN_HALF_US << 4)) || (halfx16 > (ZC_MAX_HALF_US << 4))) {
+    reset(us);
+    return;
+  }
+  m_HalfUsX16 = halfx16;
+  if (m_LockCnt < ZC_LOCK_CNT) m_LockCnt++;
+}
+
+// consistent copy of the ISR state. returns 0 if not locked or stale
+uint8_t ZcTracker::snapshot(uint32_t *zcus,uint32_t *halfx16)
+{
+  noInterrupts();
+  uint8_t lockcnt = m_LockCnt;
+  *zcus = m_ZcUs;
+  *halfx16 = m_HalfUsX16;
+  interrupts();
+
+  if (lockcnt < ZC_LOCK_CNT) return 0;
+  return ((micros() - *zcus) < (ZC_MAX_MISSED * (*halfx16 >> 4))) ? 1 : 0;
+}
+
+// AC frequency * 100, 0 = not locked
+uint16_t ZcTracker::GetFreqX100()
+{
+  uint32_t zcus,halfx16;
+  if (!snapshot(&zcus,&halfx16)) return 0;
+  // 100 * 1e6 / (2 * halfus)
+  return (uint16_t)(800000000UL / halfx16);
+}
+
+// us from now until advanceus before the next predicted crossing that's
+// at least advanceus away. ZC_UNLOCKED if we don't know where it is
+uint32_t ZcTracker::UsUntilSwitch(uint32_t advanceus)
+{
+  uint32_t zcus,halfx16;
+  if (!snapshot(&zcus,&halfx16)) return ZC_UNLOCKED;
+
+  uint32_t halfus = halfx16 >> 4;
+  uint32_t lead = (micros() - zcus) + advanceus;
+  uint32_t k = (lead + halfus - 1) / halfus;
+  return k*halfus - lead;
+}
+
+#endif // ZC_TRACKER
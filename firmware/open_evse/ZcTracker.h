@@ -0,0 +1,61 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+#ifdef ZC_TRACKER
+
+#define ZC_MIN_HALF_US  5000UL // 100Hz
+#define ZC_MAX_HALF_US 15000UL // 33Hz
+#define ZC_LOCK_CNT 4 // consecutive in-phase crossings before we trust it
+#define ZC_MAX_MISSED 4 // half periods w/o a crossing before we lose lock
+#define ZC_UNLOCKED 0xffffffffUL
+
+//
+// software PLL on the AC voltage zero crossings. the target feeds it
+// crossing timestamps from a pin interrupt (see zcTrackerBegin()), and it
+// keeps a running estimate of the phase and half period of the mains, so
+// the relay can be switched at a predicted crossing without sampling first
+//
+class ZcTracker {
+  volatile uint32_t m_ZcUs; // estimated micros() of the last crossing
+  volatile uint32_t m_HalfUsX16; // estimated half period, us * 16. 0 = acquiring
+  volatile uint8_t m_LockCnt;
+  volatile uint8_t m_HaveZc;
+
+  void reset(uint32_t us) {
+    m_ZcUs = us;
+    m_HalfUsX16 = 0;
+    m_LockCnt = 0;
+  }
+  uint8_t snapshot(uint32_t *zcus,uint32_t *halfx16);
+public:
+  ZcTracker() {}
+  void Crossing(uint32_t us); // called from ISR
+  uint16_t GetFreqX100();
+  uint32_t UsUntilSwitch(uint32_t advanceus);
+};
+
+extern ZcTracker g_ZcTracker;
+
+#endif // ZC_TRACKER
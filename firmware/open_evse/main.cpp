@@ -257,6 +257,8 @@ void TempMonitor::Init()
 
 void TempMonitor::Read()
 {
+  LATENCY_PROBE(LAT_TEMP);
+
   unsigned long curms = millis();
   if ((curms - m_LastUpdate) >= TEMPMONITOR_UPDATE_INTERVAL) {
 #ifdef TMP007_IS_ON_I2C
@@ -411,7 +413,9 @@ void OnboardDisplay::Init()
 #endif
   LcdPrint_P(0,1,PSTR("Ver. "));
   LcdPrint_P(VERSTR);
-  wdt_delay(1500);
+#ifndef STAGED_POST // POST holds the splash while it runs instead
+  wdt_delay(LCD_SPLASH_MS);
+#endif
   WDT_RESET();
 #endif //#ifdef LCD16X2
 }
@@ -477,6 +481,8 @@ void OnboardDisplay::LcdMsg(const char *l1,const char *l2)
 
 void OnboardDisplay::Update(int8_t updmode)
 {
+  LATENCY_PROBE(LAT_LCD);
+
   if (updateDisabled() && !g_EvseController.InFaultState()) return;
 
   uint8_t curstate = g_EvseController.GetState();
@@ -2447,7 +2453,7 @@ void EvseReset()
 }
 
 #ifdef PP_AUTO_AMPACITY
-uint8_t StateTransitionReqFunc(uint8_t curPilotState,uint8_t newPilotState,uint8_t curEvseState,uint8_t newEvseState)
+uint8_t StateTransitionReqFunc(uint8_t /*curPilotState*/,uint8_t /*newPilotState*/,uint8_t /*curEvseState*/,uint8_t newEvseState)
 {
   uint8_t retEvseState = newEvseState;
 
@@ -2477,14 +2483,131 @@ uint8_t StateTransitionReqFunc(uint8_t curPilotState,uint8_t newPilotState,uint8
 }
 #endif //PP_AUTO_AMPACITY
 
+#ifdef TASK_SCHEDULER
+static uint8_t s_LcdPending;
+
+static void evseTask()
+{
+  g_EvseController.Update();
+  if (g_EvseController.StateTransition()) s_LcdPending = 1;
+
+#ifdef KWH_RECORDING
+  g_EnergyMeter.Update();
+#endif // KWH_RECORDING
+}
+
+static uint8_t lcdReady()
+{
+  return s_LcdPending;
+}
+
+static void lcdTask()
+{
+  s_LcdPending = 0;
+#ifdef PERIODIC_LCD_REFRESH_MS
+  // Force LCD update (required for CE certification testing) to restore LCD if corrupted.
+  static unsigned long lastlcdreset = 0;
+  if ((millis()-lastlcdreset)>PERIODIC_LCD_REFRESH_MS) {
+    g_OBD.Update(OBD_UPD_FORCE);
+    lastlcdreset = millis();
+  }
+  else g_OBD.Update();
+#else // !PERIODIC_LCD_REFRESH_MS
+  g_OBD.Update();
+#endif // PERIODIC_LCD_REFRESH_MS
+}
+
+#ifdef RAPI
+#ifdef RAPI_SERIAL
+static uint8_t rapiReady()
+{
+  return RAPI_SERIAL_PORT.available() ? 1 : 0;
+}
+#endif // RAPI_SERIAL
+
+static void rapiTask()
+{
+  RapiDoCmd();
+}
+#endif // RAPI
+
+#ifdef BTN_MENU
+static void btnTask()
+{
+  g_BtnHandler.ChkBtn();
+}
+#endif // BTN_MENU
+
+#ifdef TEMPERATURE_MONITORING
+static void tempTask()
+{
+  g_TempMonitor.Read();
+}
+#endif // TEMPERATURE_MONITORING
+
+#ifdef DELAYTIMER
+static void delayTimerTask()
+{
+  g_DelayTimer.CheckTime();
+}
+#endif // DELAYTIMER
+
+// EVSE Update() worst case is the ReadPilot() scan (~13ms SAMD, ~11ms m328p)
+// plus, in state C, the readAmmeter() window when the ammeter isn't sampled
+// in the background. the period must cover the budget, or the top priority
+// task could never be on time and its overruns/misses would mean nothing
+#if defined(AMMETER) && !defined(AMMETER_BACKGROUND)
+#define EVSE_TASK_BUDGET_US (15000U + CURRENT_SAMPLE_INTERVAL*1000U)
+#else
+#define EVSE_TASK_BUDGET_US 15000U
+#endif
+#define EVSE_TASK_PERIOD_MS ((EVSE_TASK_BUDGET_US + 999U)/1000U + 5U)
+
+// highest priority first. TempMonitor::Read() and DelayTimer::CheckTime()
+// rate limit themselves to 1/sec, so they are polled faster than that
+// to keep scheduling jitter from stretching their interval to 2 sec
+const TASK g_Tasks[] = {
+  // run, ready, periodMs, budgetUs
+  { evseTask, NULL, EVSE_TASK_PERIOD_MS, EVSE_TASK_BUDGET_US },
+#ifdef RAPI
+#ifdef RAPI_SERIAL
+  { rapiTask, rapiReady, 50, 4000 },
+#else
+  { rapiTask, NULL, 10, 4000 },
+#endif // RAPI_SERIAL
+#endif // RAPI
+#ifdef BTN_MENU
+  { btnTask, NULL, 20, 1000 },
+#endif // BTN_MENU
+  { lcdTask, lcdReady, 250, 8000 },
+#ifdef TEMPERATURE_MONITORING
+  { tempTask, NULL, 250, 4000 },
+#endif // TEMPERATURE_MONITORING
+#ifdef DELAYTIMER
+  { delayTimerTask, NULL, 250, 2000 },
+#endif // DELAYTIMER
+};
+#define TASK_CNT (sizeof(g_Tasks)/sizeof(g_Tasks[0]))
+TASK_STATS g_TaskStats[TASK_CNT];
+TaskScheduler g_Scheduler;
+#endif // TASK_SCHEDULER
+
 
 void setup()
 {
   WDT_DISABLE();
   
+#ifdef STAGED_POST
+  RAPI_SERIAL_PORT.begin(SERIAL_BAUD);
+
+  // same as the delay(400) below, but counts the time the core took to get
+  // here and the serial port setup
+  while (millis() < 400);
+#else
   delay(400);  // give I2C devices time to be ready before running code that wants to initialize I2C devices.  Otherwise a hang can occur upon powerup.
   
   RAPI_SERIAL_PORT.begin(SERIAL_BAUD);
+#endif // STAGED_POST
 
   initTarget();
 
@@ -2505,10 +2628,17 @@ void setup()
   g_OBD.LcdMsg_P(PSTR("Waiting for"),PSTR("Initialization.."));
 #endif // LCD16X2
   while (g_EvseController.IsBootLocked()) {
+#ifdef STAGED_POST
+    // boot notification goes out when POST passes
+    g_EvseController.PostRun();
+#endif
     ProcessInputs();
   }
 #endif // BOOTLOCK
 
+#ifdef TASK_SCHEDULER
+  g_Scheduler.Init(g_Tasks,g_TaskStats,TASK_CNT);
+#endif // TASK_SCHEDULER
 
   WDT_ENABLE();
 }  // setup()
@@ -2517,7 +2647,15 @@ void setup()
 void loop()
 {
   WDT_RESET();
+  LATENCY_LOOP_TICK();
 
+#ifdef TASK_SCHEDULER
+#ifdef IDLE_SLEEP
+  if (!g_Scheduler.Run()) g_Scheduler.Idle();
+#else
+  g_Scheduler.Run();
+#endif // IDLE_SLEEP
+#else // !TASK_SCHEDULER
   g_EvseController.Update();
 
 #ifdef KWH_RECORDING
@@ -2545,4 +2683,5 @@ void loop()
 #ifdef DELAYTIMER
   g_DelayTimer.CheckTime();
 #endif //#ifdef DELAYTIMER
+#endif // TASK_SCHEDULER
 }
@@ -120,6 +120,31 @@ extern bool g_hasCGMI;
 // enable sending of RAPI commands
 //#define RAPI_SENDER
 
+// RAPI $GX - state, current, voltage, temperatures and energy in one
+// response
+//#define RAPI_SNAPSHOT
+
+// RAPI binary framing (COBS, CRC-16, 1-byte command id), switched on by
+// $FF M 1. commands share the ASCII handlers. incompatible w/ RAPI_SENDER
+//#define RAPI_BINARY
+
+// RAPI $SU - push $AM telemetry (current, voltage, energy, temperatures)
+// periodically from the main loop instead of being polled
+//#define RAPI_TELEMETRY
+
+// write RAPI responses straight to the port w/ a running checksum instead
+// of sprintf()ing them into g_sTmp. $GS $GG $GP $GU $GX skip sprintf()
+//#define RAPI_STREAM
+
+// dispatch RAPI commands through a PROGMEM table of handlers and token
+// counts (rapi_cmds.h) instead of a switch. unknown commands/wrong # of
+// args are NK'd either way
+//#define RAPI_CMD_TABLE
+
+// queue up to RAPI_INQ_DEPTH whole RAPI commands, so clients can send
+// several w/o waiting for each response. costs ESRAPI_BUFLEN RAM per slot
+//#define RAPI_PIPELINE
+
 // EVSE must call state transition function for permission to change states
 //#define STATE_TRANSITION_REQ_FUNC
 
@@ -190,6 +215,11 @@ extern AutoCurrentCapacityController g_ACCController;
 #define GFI_SELFTEST
 #endif //UL_COMPLIANT
 
+// GFI_TEST_TIMER - generate the GFI self test pulse train from a hardware
+// timer (TC5 SAMD/Timer2 m328p). the test before closing the relay runs in
+// the background while Update() holds STATE C w/ the relay open
+//#define GFI_TEST_TIMER
+
 #define TEMPERATURE_MONITORING  // Temperature monitoring support
 // TEMPERATURE_THROTTLING enables adjusting max current based on temperature
 // if not defined, and TEMPERATURE_MONITORING is enabled, then only
@@ -327,10 +357,52 @@ extern AutoCurrentCapacityController g_ACCController;
 // when not defined, use fast PWM -> 1/250 resolution
 #define PAFC_PWM
 
+// m328p: ADC auto-triggered by Timer1 to sample the middle of each pilot
+// plateau in the background, so ReadPilot() doesn't spin PILOT_LOOP_CNT reads
+// samd: the AMMETER_BACKGROUND sampler takes turns on the pilot and
+// CURRENT_PIN, and ReadPilot() gets the min/max of its pilot samples
+//#define PILOT_ADC_TRIGGER
+
 // glynhudson reports that LCD gets corrupted by EMC testing during CE
 // certification.. redraw display periodically when enabled
 //#define PERIODIC_LCD_REFRESH_MS 120000UL
 
+// run loop() from a table of tasks w/ per task period, priority and
+// run time budget instead of calling everything back to back.
+// per task stats via RAPI $GK
+//#define TASK_SCHEDULER
+
+// log2 latency histograms of the main loop subsystems via RAPI $GL
+// compiles out completely when not defined
+//#define LATENCY_STATS
+
+// gfi_isr() only opens the relay and posts an event to a SPSC ring
+// (EventQueue); the vflags, pilot and charging state changes are made when
+// Update() drains it. queue wait time via LATENCY_STATS probe LAT_EVENT
+//#define ISR_EVENT_QUEUE
+
+// sleep the MCU in idle mode (WFI on SAMD, SLEEP_MODE_IDLE on m328p) when
+// a scheduler pass has nothing to run. timers, UART, ADC and pin change
+// interrupts keep running and wake it, so the tick interrupt bounds the
+// sleep to ~1ms. idle percentage via RAPI $GK. w/ AMMETER_BACKGROUND, SAMD
+// sleeps through the sampler's 60us ticks, and m328p wakes on every ADC
+// interrupt (2k/sec), so there the saving is smaller
+//#define IDLE_SLEEP
+
+// run POST one stage at a time from Update() instead of blocking in Init(),
+// so RAPI, buttons and the LCD are live during the relay settling delays.
+// POST duration and time from reset to ready via RAPI $GB
+//#define STAGED_POST
+// ms the version splash stays on the LCD at boot
+#define LCD_SPLASH_MS 1500
+
+// classify the pilot w/ hysteresis around the A/B, B/C and C/D thresholds
+// (PILOT_THRESH_xx in target.h), relative to the previous reading, so
+// noise at a boundary doesn't keep restarting the transition debounce
+//#define PILOT_HYSTERESIS
+// ADC counts either side of a threshold. ~0.25V of pilot on both targets
+#define PILOT_HYST (ADC_MAX/128)
+
 // when closing DC relay set to HIGH for m_relayCloseMs, then
 // switch to m_relayHoldPwm
 // ONLY WORKS PWM-CAPABLE PINS!!!
@@ -354,7 +426,18 @@ extern AutoCurrentCapacityController g_ACCController;
 // contacts care about.
 #define CURRENT_ZERO_THRESHOLD_MA 200
 #define CURRENT_ZERO_TIMEOUT_MS  1000  // ms; give up waiting for zero and open the relay anyway
+
+// ZC_TRACKER - track the mains phase from pin interrupts (ZcTracker.h)
+// instead of sampling for up to ZC_DETECT_TIMEOUT_MS*3 on every relay
+// switch. targets that define RELAY_TIMER also switch the relay from a
+// timer ISR instead of waiting for the crossing
+#if defined(RELAY_TIMER) && defined(OEV6) && defined(RELAY_PWM)
+#error RELAY_TIMER cannot switch the relay from ISR w/ RELAY_PWM
+#endif
 #endif // RELAY_ZC_SWITCH
+#if defined(ZC_TRACKER) && !defined(RELAY_ZC_SWITCH)
+#error ZC_TRACKER requires RELAY_ZC_SWITCH
+#endif
 
 // OEV6 w/ CGMI - when power is loss, temporarily triggers NO GROUND fault
 // delay recording of NO GROUND fault to avoid recording this spurious fault
@@ -387,6 +470,26 @@ extern AutoCurrentCapacityController g_ACCController;
 #error INVALID_CONFIG - GFI NEEDED FOR GFI SELF TEST
 #endif
 
+#if defined(STAGED_POST) && !defined(ADVPWR)
+#error INVALID_CONFIG - STAGED_POST NEEDS ADVPWR
+#endif
+
+#if defined(IDLE_SLEEP) && !defined(TASK_SCHEDULER)
+#error INVALID_CONFIG - IDLE_SLEEP NEEDS TASK_SCHEDULER
+#endif
+
+#if defined(PILOT_ADC_TRIGGER) && !((defined(TARGET_M328P) && defined(PAFC_PWM)) || (defined(TARGET_SAMD) && defined(AMMETER_BACKGROUND)))
+#error INVALID_CONFIG - PILOT_ADC_TRIGGER NEEDS TARGET_M328P AND PAFC_PWM, OR TARGET_SAMD AND AMMETER_BACKGROUND
+#endif
+
+#if defined(AMMETER_BACKGROUND) && defined(TARGET_M328P) && !defined(PILOT_ADC_TRIGGER)
+#error INVALID_CONFIG - AMMETER_BACKGROUND NEEDS PILOT_ADC_TRIGGER ON TARGET_M328P
+#endif
+
+#if defined(GFI_TEST_TIMER) && !defined(GFI_SELFTEST)
+#error INVALID_CONFIG - GFI_TEST_TIMER NEEDS GFI_SELFTEST
+#endif
+
 // for testing print various diagnostic messages to the UART
 //#define SERDBG
 
@@ -451,7 +554,7 @@ extern AutoCurrentCapacityController g_ACCController;
 // 10-byte MCU id needs only 33 for $GI, so the LCD-derived 34 still fits;
 // keep AVR unchanged so its RAM footprint does not grow. See the matching
 // #error guard in rapi_proc.cpp.
-#ifdef TARGET_SAMD
+#if defined(TARGET_SAMD) || defined(TARGET_HOST) // both have a 16-byte MCU id
 #define TMP_BUF_SIZE 48
 #else
 #define TMP_BUF_SIZE ((LCD_MAX_CHARS_PER_LINE+1)*2)
@@ -550,11 +653,35 @@ extern AutoCurrentCapacityController g_ACCController;
 // but Leaf sometimes bounces from 3->1 so we will debounce it a little anyway
 #define DELAY_STATE_TRANSITION_A 25
 
+// debounce EVSE state transitions by counting consecutive Update() passes
+// (pilot readings) that agree on the new state, per destination state,
+// instead of by DELAY_STATE_TRANSITION(_A) alone. a disagreeing reading
+// starts the count over. settable via RAPI $SD (not saved)
+//#define DEBOUNCE_SAMPLES
+// readings needed to confirm each destination state. one reading per
+// Update(): 20ms w/ AMMETER_BACKGROUND, 55ms w/o (TASK_SCHEDULER)
+#define DEBOUNCE_CNT_A 3
+#define DEBOUNCE_CNT_B 25
+#define DEBOUNCE_CNT_C 3 // B->C is the plug in to charge latency
+#define DEBOUNCE_CNT_D 25
+#define DEBOUNCE_CNT_OTHER 25 // unknown, diode check failed
+// floor under a count of 2 or more, in case Update() passes come faster
+// than the pilot reading changes. a count of 1 takes the first reading
+#define DEBOUNCE_MIN_MS 20
+
 // for ADVPWR
 #define GROUND_CHK_DELAY  1000 // delay after charging started to test, ms
 #define STUCK_RELAY_DELAY 1000 // delay after charging opened to test, ms
 #define RelaySettlingTime  250 // time for relay to settle in post, ms
 
+// timed fault shutdowns (over temperature, overcurrent) return to loop()
+// while waiting for the EV to stop drawing current, and open the relay on
+// the first Update() pass after the deadline. targets w/ RELAY_TIMER arm
+// it for the deadline once it's FAULT_SHUTDOWN_TIMER_MS away, so a slow
+// pass can't make the relay open late. must be longer than the slowest
+// loop() pass, and fit the relay timer (87ms on SAMD)
+#define FAULT_SHUTDOWN_TIMER_MS 80
+
 // ACPINS sample interval - max number of ms to sample
 // used only when ADVPWR - for rectified MID400 chips which block
 // half cycle
@@ -568,6 +695,11 @@ extern AutoCurrentCapacityController g_ACCController;
 // GFI pulse should be 50% duty cycle
 #define GFI_PULSE_ON_US 8333 // 1/2 of roughly 60 Hz.
 #define GFI_PULSE_OFF_US 8334 // 1/2 of roughly 60 Hz.
+#ifdef GFI_TEST_TIMER
+// max ms to wait for the GFI pin to clear before/after the pulse train
+#define GFI_TEST_CLEAR_PRE_MS 1000
+#define GFI_TEST_CLEAR_POST_MS 2000
+#endif // GFI_TEST_TIMER
 #endif
 #endif // GFI
 
@@ -631,6 +763,34 @@ extern AutoCurrentCapacityController g_ACCController;
 // Once we detect a zero-crossing, we should not look for one for another quarter cycle or so. 1/4 // cycle at 50 Hz is 5 ms.
 #define CURRENT_ZERO_DEBOUNCE_INTERVAL 5
 
+// time constant of the charging current filter is ~2^AMMETER_EMA_SHIFT
+// readings. 4 gives about the same noise rejection as the old 32 point
+// block average, but updates m_ChargingCurrent on every reading
+#ifndef AMMETER_EMA_SHIFT
+#define AMMETER_EMA_SHIFT 4
+#endif
+
+#ifdef AMMETER_CYCLE_LOCK
+#ifndef RELAY_ZC_SWITCH
+#error AMMETER_CYCLE_LOCK requires RELAY_ZC_SWITCH
+#endif
+// once measureAcFreq() has found the mains frequency, integrate over
+// AMMETER_LOCK_CYCLES whole cycles at a fixed AMMETER_LOCK_SAMPLE_HZ instead
+// of counting zero crossings
+#ifdef AMMETER_BACKGROUND
+#define AMMETER_LOCK_SAMPLE_HZ AMMETER_SAMPLE_HZ
+#define AMMETER_LOCK_CYCLES 3 // ~280 samples @ 60Hz on SAMD, 100 on m328p
+#else
+#define AMMETER_LOCK_SAMPLE_HZ 4000 // must be slower than adcCurrent.read()
+#define AMMETER_LOCK_CYCLES 1 // 67 samples @ 60Hz, 80 @ 50Hz
+#endif // AMMETER_BACKGROUND
+#endif // AMMETER_CYCLE_LOCK
+
+#ifdef VOLTMETER
+// sample voltage and current together in one window, and measure real power
+#define POWERMETER
+#endif // VOLTMETER
+
 #endif // AMMETER
 
 #ifdef TEMPERATURE_MONITORING
@@ -770,12 +930,16 @@ public:
   void SetGreenLed(uint8_t state) {
 #ifdef GREEN_LED_REG
     pinGreenLed.write(state);
+#else
+    (void)state;
 #endif
   }
 
   void SetRedLed(uint8_t state) {
 #ifdef RED_LED_REG
   pinRedLed.write(state);
+#else
+  (void)state;
 #endif
   }
 #ifdef LCD16X2
@@ -1327,5 +1491,9 @@ extern TempMonitor g_TempMonitor;
 char *GetFirmwareVersion(char *str);
 void wdt_delay(uint32_t ms);
 
+#include "TaskScheduler.h"
+#include "ZcTracker.h"
+#include "EventQueue.h"
+#include "LatencyStats.h"
 #include "strings.h"
 #include "rapi_proc.h"
@@ -0,0 +1,188 @@
+// -*- C++ -*-
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// RAPI command list. n.b. no include guard - included w/ RAPI_CMD()
+// defined, once for each thing generated from it: the handler
+// declarations in EvseRapiProcessor, and the dispatch table (or switch)
+// in dispatch()
+//
+// RAPI_CMD(family,char,min,max) - $<family><char> is handled by
+// EvseRapiProcessor::rapi<family><char>(). min/max = token count,
+// including the command itself and excluding the sequence id. the handler
+// is only called w/ a count in range. guard an entry w/ the same #ifdef as
+// its handler
+//
+// to add a command: an entry here, and its handler in rapi_proc.cpp
+//
+
+// F - function
+RAPI_CMD(F,0,2,2) // enable/disable LCD update
+#ifdef BTN_MENU
+RAPI_CMD(F,1,1,RAPIC_ANY) // simulate front panel short press
+#endif
+#ifdef LCD16X2
+RAPI_CMD(F,B,2,2) // LCD backlight
+#endif
+RAPI_CMD(F,C,1,RAPIC_ANY) // reset fault counters + total energy
+RAPI_CMD(F,D,1,RAPIC_ANY) // disable EVSE
+RAPI_CMD(F,E,1,RAPIC_ANY) // enable EVSE
+RAPI_CMD(F,F,3,3) // enable/disable feature
+#ifdef TEMPERATURE_MONITORING
+RAPI_CMD(F,O,2,2) // set panic temperature
+#endif
+#ifdef LCD16X2
+RAPI_CMD(F,P,4,RAPIC_ANY) // print to LCD
+#endif
+RAPI_CMD(F,R,1,RAPIC_ANY) // reset EVSE
+RAPI_CMD(F,S,1,RAPIC_ANY) // sleep
+
+// S - set parameter
+#ifdef LCD16X2
+RAPI_CMD(S,0,2,2) // set LCD type
+#endif
+#ifdef HAVE_RTC
+RAPI_CMD(S,1,7,7) // set RTC
+#endif
+#if defined(AMMETER) && defined(ECVF_AMMETER_CAL)
+RAPI_CMD(S,2,2,2) // ammeter calibration mode
+#endif
+#ifdef TIME_LIMIT
+RAPI_CMD(S,3,2,2) // set time limit
+#endif
+#if defined(AUTH_LOCK) && !defined(AUTH_LOCK_REG)
+RAPI_CMD(S,4,2,2) // auth lock
+#endif
+#ifdef MENNEKES_LOCK
+RAPI_CMD(S,5,2,2) // mennekes setting
+#endif
+#ifdef AMMETER
+RAPI_CMD(S,A,3,3) // ammeter settings
+#endif
+#ifdef BOOTLOCK
+RAPI_CMD(S,B,1,RAPIC_ANY) // clear boot lock
+#endif
+RAPI_CMD(S,C,2,3) // current capacity
+#ifdef DEBOUNCE_SAMPLES
+RAPI_CMD(S,D,3,3) // state transition debounce
+#endif
+#ifdef CHARGE_LIMIT
+RAPI_CMD(S,H,2,2) // charge limit
+#endif
+#ifdef KWH_RECORDING
+RAPI_CMD(S,K,2,RAPIC_ANY) // set accumulated kwh
+#endif
+RAPI_CMD(S,L,2,2) // service level
+#ifdef VOLTMETER
+RAPI_CMD(S,M,3,3) // voltmeter settings
+#endif
+RAPI_CMD(S,R,3,3) // relay enable/disable
+#ifdef DELAYTIMER
+RAPI_CMD(S,T,5,5) // timer
+#endif
+#ifdef RAPI_TELEMETRY
+RAPI_CMD(S,U,3,3) // subscribe to telemetry
+#endif
+#if defined(KWH_RECORDING) && !defined(VOLTMETER)
+RAPI_CMD(S,V,2,2) // set voltage
+#endif
+#ifdef HEARTBEAT_SUPERVISION
+RAPI_CMD(S,Y,1,3) // heartbeat supervision
+#endif
+
+// G - get parameter
+RAPI_CMD(G,0,1,RAPIC_ANY) // get EV connect state
+#ifdef TIME_LIMIT
+RAPI_CMD(G,3,1,RAPIC_ANY) // get time limit
+#endif
+#if defined(AUTH_LOCK) && !defined(AUTH_LOCK_REG)
+RAPI_CMD(G,4,1,RAPIC_ANY) // get auth lock
+#endif
+#ifdef MENNEKES_LOCK
+RAPI_CMD(G,5,1,RAPIC_ANY) // get mennekes setting
+#endif
+#ifdef AMMETER
+RAPI_CMD(G,A,1,RAPIC_ANY) // get ammeter settings
+#endif
+#ifdef STAGED_POST
+RAPI_CMD(G,B,1,RAPIC_ANY) // get boot timing
+#endif
+RAPI_CMD(G,C,1,RAPIC_ANY) // get current capacity range
+#ifdef DELAYTIMER
+RAPI_CMD(G,D,1,RAPIC_ANY) // get delay timer
+#endif
+RAPI_CMD(G,E,1,RAPIC_ANY) // get settings
+RAPI_CMD(G,F,1,RAPIC_ANY) // get fault counters
+#if defined(AMMETER) || defined(VOLTMETER)
+RAPI_CMD(G,G,1,RAPIC_ANY) // get charging current and voltage
+#endif
+#ifdef CHARGE_LIMIT
+RAPI_CMD(G,H,1,RAPIC_ANY) // get charge limit
+#endif
+#ifdef MCU_ID_LEN
+RAPI_CMD(G,I,1,RAPIC_ANY) // get MCU ID
+#endif
+#ifdef TASK_SCHEDULER
+RAPI_CMD(G,K,1,2) // get task stats
+#endif
+#ifdef LATENCY_STATS
+RAPI_CMD(G,L,1,3) // get latency stats
+#endif
+#ifdef VOLTMETER
+RAPI_CMD(G,M,1,RAPIC_ANY) // get voltmeter settings
+#endif
+#ifdef DEBOUNCE_SAMPLES
+RAPI_CMD(G,N,2,2) // get debounce
+#endif
+#ifdef TEMPERATURE_MONITORING
+RAPI_CMD(G,O,1,RAPIC_ANY) // get panic temperature
+RAPI_CMD(G,P,1,RAPIC_ANY) // get temperatures
+#endif
+RAPI_CMD(G,R,1,RAPIC_ANY) // get relay enable status
+RAPI_CMD(G,S,1,RAPIC_ANY) // get state
+#ifdef HAVE_RTC
+RAPI_CMD(G,T,1,RAPIC_ANY) // get time
+#endif
+#ifdef KWH_RECORDING
+RAPI_CMD(G,U,1,RAPIC_ANY) // get energy usage
+#endif
+RAPI_CMD(G,V,1,RAPIC_ANY) // get version
+#ifdef POWERMETER
+RAPI_CMD(G,W,1,RAPIC_ANY) // get real power
+#endif
+#ifdef RAPI_SNAPSHOT
+RAPI_CMD(G,X,1,RAPIC_ANY) // get extended status snapshot
+#endif
+#ifdef HEARTBEAT_SUPERVISION
+RAPI_CMD(G,Y,1,RAPIC_ANY) // get heartbeat supervision
+#endif
+#ifdef RELAY_ZC_SWITCH
+RAPI_CMD(G,Z,1,RAPIC_ANY) // get AC frequency
+#endif
+
+// T - testing op
+#if defined(RAPI_T_COMMANDS) && defined(FAKE_CHARGING_CURRENT)
+RAPI_CMD(T,0,2,2) // set fake charging current
+#endif
+
+// Z - reserved op
+#if defined(RELAY_PWM) && defined(RELAY_HOLD_DELAY_TUNING)
+RAPI_CMD(Z,0,3,3) // set relayCloseMs
+#endif
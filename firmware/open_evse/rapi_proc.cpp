@@ -28,6 +28,9 @@
 #include "WProgram.h" // shouldn't need this but arduino sometimes messes up and puts inside an #ifdef
 #endif // ARDUINO
 #include "open_evse.h"
+#if defined(RAPI_STREAM) || defined(RAPI_BINARY)
+#include "RapiFmt.h"
+#endif
 
 #ifdef RAPI
 
@@ -38,6 +41,24 @@
 #error "TMP_BUF_SIZE too small for the $GI RAPI response on this target"
 #endif
 
+#ifdef LATENCY_STATS
+// $GL returns this many 32-bit hex histogram buckets per page
+#define LAT_PAGE_BUCKETS 4
+#if (ESRAPI_BUFLEN < (LAT_PAGE_BUCKETS*9)) || (TMP_BUF_SIZE < (3 + 1 + (LAT_PAGE_BUCKETS*9 - 1) + 4 + 4 + 1))
+#error "RAPI buffers too small for the $GL response on this target"
+#endif
+#endif // LATENCY_STATS
+
+#ifdef RAPI_BINARY
+#ifdef RAPI_SENDER
+#error "RAPI_SENDER doesn't support RAPI_BINARY"
+#endif
+// binFrame() builds ss st text crc in g_sTmp
+#if TMP_BUF_SIZE < (2 + ESRAPI_BUFLEN + 2)
+#error "TMP_BUF_SIZE too small for RAPI_BINARY responses on this target"
+#endif
+#endif // RAPI_BINARY
+
 const char RAPI_VER[] PROGMEM = RAPIVER;
 
 
@@ -88,6 +109,103 @@ uint32_t dtoi32(const char *s)
   return i;
 }
 
+// set while processCmd() runs, so nothing else writes to the port
+uint8_t g_inRapiCommand = 0;
+
+#ifdef RAPI_BINARY
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(const uint8_t *buf,uint8_t len)
+{
+  uint16_t crc = 0xffff;
+  while (len--) {
+    crc ^= (uint16_t)*(buf++) << 8;
+    for (uint8_t i=0;i < 8;i++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+// decode a COBS frame (w/o its 00 delimiter) in place
+// returns decoded length, -1 if malformed
+static int8_t cobsDecode(uint8_t *buf,uint8_t len)
+{
+  uint8_t in = 0;
+  uint8_t out = 0;
+  while (in < len) {
+    uint8_t code = buf[in++];
+    if (!code || ((in + code - 1) > len)) return -1;
+    for (uint8_t i=1;i < code;i++) {
+      buf[out++] = buf[in++];
+    }
+    if ((code != 0xff) && (in < len)) buf[out++] = 0;
+  }
+  return out;
+}
+#endif // RAPI_BINARY
+
+// command key of $<f><c>, RAPIC_NOKEY if there's no such family/char
+static constexpr uint8_t rapicFamily(char f)
+{
+  return (f == 'F') ? 0 : (f == 'S') ? 1 : (f == 'G') ? 2 : (f == 'T') ? 3 :
+    (f == 'Z') ? 4 : RAPIC_NOKEY;
+}
+static constexpr uint8_t rapicChar(char c)
+{
+  return ((c >= '0') && (c <= '9')) ? (c - '0') :
+    ((c >= 'A') && (c <= 'Z')) ? (c - 'A' + 10) : RAPIC_NOKEY;
+}
+static constexpr uint8_t rapicKey(char f,char c)
+{
+  return ((rapicFamily(f) == RAPIC_NOKEY) || (rapicChar(c) == RAPIC_NOKEY)) ?
+    RAPIC_NOKEY : (rapicFamily(f) * RAPIC_CHARS + rapicChar(c));
+}
+#define RAPIC_KEY(fam,ch) rapicKey(#fam[0],#ch[0])
+
+static inline uint8_t rapicArityOk(uint8_t arity,int8_t tokencnt)
+{
+  return (tokencnt >= (arity >> 4)) && (tokencnt <= (arity & 0xf));
+}
+
+#ifdef RAPI_CMD_TABLE
+// keys of the rapi_cmds.h entries, in order
+static constexpr uint8_t s_RapiCmdKeys[] = {
+#define RAPI_CMD(fam,ch,min,max) RAPIC_KEY(fam,ch),
+#include "rapi_cmds.h"
+#undef RAPI_CMD
+};
+#define RAPIC_CNT (sizeof(s_RapiCmdKeys)/sizeof(s_RapiCmdKeys[0]))
+
+// entry # + 1 of key, 0 if it has none
+static constexpr uint8_t rapicIdx(uint8_t key,uint8_t i)
+{
+  return (i == RAPIC_CNT) ? 0 :
+    (s_RapiCmdKeys[i] == key) ? (i + 1) : rapicIdx(key,i + 1);
+}
+static constexpr uint8_t rapicDup(uint8_t i)
+{
+  return (i == RAPIC_CNT) ? 0 :
+    ((rapicIdx(s_RapiCmdKeys[i],0) != (i + 1)) || rapicDup(i + 1));
+}
+static_assert(RAPIC_CNT < 255,"too many RAPI commands for s_RapiCmdIdx");
+static_assert(!rapicDup(0),"rapi_cmds.h has the same command twice");
+
+// first level of the lookup, generated from rapi_cmds.h: entry # + 1 by
+// command key
+#define RAPIC_I6(k) rapicIdx(k,0),rapicIdx(k+1,0),rapicIdx(k+2,0),	\
+    rapicIdx(k+3,0),rapicIdx(k+4,0),rapicIdx(k+5,0)
+#define RAPIC_I36(k) RAPIC_I6(k),RAPIC_I6(k+6),RAPIC_I6(k+12),		\
+    RAPIC_I6(k+18),RAPIC_I6(k+24),RAPIC_I6(k+30)
+static const uint8_t s_RapiCmdIdx[RAPIC_FAMILIES*RAPIC_CHARS] PROGMEM = {
+  RAPIC_I36(0),RAPIC_I36(36),RAPIC_I36(72),RAPIC_I36(108),RAPIC_I36(144)
+};
+
+typedef struct rapi_cmd {
+  RAPI_HANDLER handler;
+  uint8_t arity;
+} RAPI_CMD_ENTRY;
+#endif // RAPI_CMD_TABLE
+
 #ifdef RAPI_I2C
 //get data from master - HINT: this is a ISR call!
 //HINT2: do not handle stuff here!! this will NOT work
@@ -109,9 +227,103 @@ EvseRapiProcessor::EvseRapiProcessor()
 void EvseRapiProcessor::init()
 {
   echo = 0;
+#ifdef RAPI_BINARY
+  binMode = 0;
+  binModeReq = RAPIB_REQ_NONE;
+#endif
+#ifdef RAPI_TELEMETRY
+  telemMask = 0;
+#endif
+#ifdef RAPI_PIPELINE
+  inqHead = 0;
+  inqCnt = 0;
+  inqPos = 0;
+#endif
   reset();
 }
 
+#ifdef RAPI_PIPELINE
+// read while there's a free slot, queueing whole commands
+// returns # of whole commands waiting
+uint8_t EvseRapiProcessor::inqReceive()
+{
+  while ((inqCnt < RAPI_INQ_DEPTH) && available()) {
+    char c = read();
+    char *f = inq[(inqHead + inqCnt) % RAPI_INQ_DEPTH];
+#ifdef RAPI_BINARY
+    if (binMode) {
+      if (!c) { // end of frame
+	if (inqPos > 0) {
+	  f[inqPos] = '\0';
+	  inqCnt++;
+	}
+	inqPos = 0;
+      }
+      else if ((inqPos >= 0) && (inqPos < RAPIB_FRAME_MAX)) {
+	f[inqPos++] = c;
+      }
+      else { // too many chars - drop the rest of the frame
+	inqPos = -1;
+      }
+      continue;
+    }
+#endif // RAPI_BINARY
+    if (echo) write(c);
+
+    if (c == ESRAPI_SOC) {
+      f[0] = ESRAPI_SOC;
+      inqPos = 1;
+    }
+    else if (inqPos > 0) {
+      if (inqPos < ESRAPI_BUFLEN) {
+	if (c == ESRAPI_EOC) {
+	  f[inqPos] = '\0';
+	  inqCnt++;
+	  inqPos = 0;
+	}
+	else {
+	  f[inqPos++] = c;
+	}
+      }
+      else { // too many chars
+	inqPos = 0;
+      }
+    }
+  }
+  return inqCnt;
+}
+
+// one command per call, so a burst can't stall the main loop
+int EvseRapiProcessor::doCmd()
+{
+  int rc = 1;
+
+  if (inqReceive()) {
+    strcpy(buffer,inq[inqHead]);
+    inqHead = (inqHead + 1) % RAPI_INQ_DEPTH;
+    inqCnt--;
+#ifdef RAPI_BINARY
+    if (binMode) {
+      bufCnt = strlen(buffer);
+      rc = doBinCmd();
+      reset();
+      return rc;
+    }
+#endif // RAPI_BINARY
+    bufCnt = strlen(buffer) + 1;
+    if (!tokenize(buffer)) {
+      rc = processCmd();
+    }
+    else {
+      reset();
+      curReceivedSeqId = INVALID_SEQUENCE_ID;
+      response(0);
+    }
+  }
+
+  return rc;
+}
+#else // !RAPI_PIPELINE
 int EvseRapiProcessor::doCmd()
 {
   int rc = 1;
@@ -120,6 +332,21 @@ int EvseRapiProcessor::doCmd()
   if (bcnt) {
     for (int i=0;i < bcnt;i++) {
       char c = read();
+#ifdef RAPI_BINARY
+      if (binMode) {
+	if (!c) { // end of frame
+	  if (bufCnt > 0) rc = doBinCmd();
+	  reset();
+	}
+	else if ((bufCnt >= 0) && (bufCnt < RAPIB_FRAME_MAX)) {
+	  buffer[bufCnt++] = c;
+	}
+	else { // too many chars - drop the rest of the frame
+	  bufCnt = -1;
+	}
+	continue;
+      }
+#endif // RAPI_BINARY
       if (echo) write(c);
 
       if (c == ESRAPI_SOC) {
@@ -152,37 +379,287 @@ int EvseRapiProcessor::doCmd()
 
   return rc;
 }
+#endif // RAPI_PIPELINE
+
+
+#ifdef RAPI_BINARY
+// ss id [args] crc, COBS decoded from buffer[0..bufCnt). int args go to
+// args[] as is, and every arg is also turned back into a token, so
+// processCmd() handles it like ASCII
+int EvseRapiProcessor::doBinCmd()
+{
+  uint8_t *f = (uint8_t *)g_sTmp;
+  int8_t len = cobsDecode((uint8_t *)buffer,bufCnt);
+  if ((len < 4) ||
+      (crc16((uint8_t *)buffer,len-2) != ((uint8_t)buffer[len-2] | ((uint16_t)(uint8_t)buffer[len-1] << 8)))) {
+    binFrame(INVALID_SEQUENCE_ID,RAPIB_NK,NULL,0);
+    return -1;
+  }
+  len -= 2;
+  memcpy(f,buffer,len);
+
+  uint8_t id = f[1];
+  uint8_t c = id & 0x3f;
+  char *s = buffer;
+  tokens[0] = s;
+  *(s++) = "FSGT"[id >> 6];
+  *(s++) = (c < 10) ? ('0' + c) : ('A' + c - 10);
+  *(s++) = '\0';
+  tokenCnt = 1;
+
+  uint8_t pos = 2;
+  int8_t ok = (c < 36);
+  while (ok && (pos < len)) {
+    if (tokenCnt >= ESRAPI_MAX_ARGS) ok = 0;
+    else if ((f[pos] == RAPIB_ARG_INT) && ((pos + 5) <= len) &&
+	     ((s + 12) <= (buffer + ESRAPI_BUFLEN))) {
+      int32_t v = (int32_t)((uint32_t)f[pos+1] | ((uint32_t)f[pos+2] << 8) |
+			    ((uint32_t)f[pos+3] << 16) | ((uint32_t)f[pos+4] << 24));
+      args[tokenCnt] = v;
+      tokens[tokenCnt++] = s;
+      s += rapiFmtDec(s,v) + 1;
+      pos += 5;
+    }
+    else if ((f[pos] == RAPIB_ARG_STR) && ((pos + 2) <= len) &&
+	     ((pos + 2 + f[pos+1]) <= len) &&
+	     ((s + f[pos+1] + 1) <= (buffer + ESRAPI_BUFLEN))) {
+      uint8_t n = f[pos+1];
+      tokens[tokenCnt] = s;
+      memcpy(s,f+pos+2,n);
+      s += n;
+      *(s++) = '\0';
+      args[tokenCnt] = dtoi32(tokens[tokenCnt]);
+      tokenCnt++;
+      pos += 2 + n;
+    }
+    else ok = 0;
+  }
+
+  curReceivedSeqId = f[0];
+  if (!ok) {
+    tokenCnt = 0;
+    binFrame(curReceivedSeqId,RAPIB_NK,NULL,0);
+    return -1;
+  }
+  return processCmd();
+}
+
+// write ss st text crc as a COBS frame. text can be in g_sTmp
+void EvseRapiProcessor::binFrame(uint8_t seq,uint8_t status,const char *text,uint8_t len)
+{
+  uint8_t *f = (uint8_t *)g_sTmp;
+  if (len > (TMP_BUF_SIZE - 4)) len = TMP_BUF_SIZE - 4;
+  if (len) memmove(f+2,text,len);
+  f[0] = seq;
+  f[1] = status;
+  len += 2;
+  uint16_t crc = crc16(f,len);
+  f[len++] = crc & 0xff;
+  f[len++] = crc >> 8;
+
+  writeStart();
+  // frames are < 254 bytes, so every block ends at a 00 or at the end
+  uint8_t start = 0;
+  for (uint8_t i=0;i <= len;i++) {
+    if ((i == len) || !f[i]) {
+      write((uint8_t)(i - start + 1));
+      for (uint8_t j=start;j < i;j++) write(f[j]);
+      start = i + 1;
+    }
+  }
+  write((uint8_t)0);
+  writeEnd();
+}
 
+// $OK w/ a fixed little-endian payload instead of text. returns 0 for the
+// handler to return
+int EvseRapiProcessor::binData(const void *data,uint8_t len)
+{
+  // both targets are little-endian
+  binFrame(curReceivedSeqId,RAPIB_OK,(const char *)data,len);
+  bufCnt = -1; // response already written
+  return 0;
+}
+#endif // RAPI_BINARY
+
+#ifdef RAPI_SNAPSHOT
+// $GX - writes its own response, it doesn't fit buffer[]
+void EvseRapiProcessor::sendSnapshot()
+{
+  RAPI_SNAPSHOT_DATA snap;
+  snap.ver = RAPI_SNAPSHOT_VER;
+  snap.evseState = g_EvseController.GetState();
+  snap.pilotState = g_EvseController.GetPilotState();
+  snap.currentCapacity = g_EvseController.GetCurrentCapacity();
+  snap.chargingCurrent = g_EvseController.GetChargingCurrent();
+  snap.voltage = g_EvseController.GetVoltage();
+#ifdef TEMPERATURE_MONITORING
+  snap.ds3231Temp = g_TempMonitor.m_DS3231_temperature;
+  snap.mcp9808Temp = g_TempMonitor.m_MCP9808_temperature;
+  snap.tmp007Temp = g_TempMonitor.m_TMP007_temperature;
+#else
+  snap.ds3231Temp = snap.mcp9808Temp = snap.tmp007Temp = -2560; // TEMPERATURE_NOT_INSTALLED
+#endif // TEMPERATURE_MONITORING
+#ifdef KWH_RECORDING
+  snap.sessionWs = g_EnergyMeter.GetSessionWs();
+  snap.totWh = g_EnergyMeter.GetTotkWh();
+#else
+  snap.sessionWs = snap.totWh = 0;
+#endif // KWH_RECORDING
+  snap.elapsedSec = (uint32_t)g_EvseController.GetElapsedChargeTime();
+  snap.vFlags = g_EvseController.GetVFlags();
+
+#ifdef RAPI_BINARY
+  if (binMode) {
+    // both targets are little-endian
+    binFrame(curReceivedSeqId,RAPIB_OK,(const char *)&snap,sizeof(snap));
+    return;
+  }
+#endif // RAPI_BINARY
+
+#ifdef RAPI_STREAM
+  wrRespStart(1);
+  wrDec(snap.ver);
+  wrHex(snap.evseState,2);
+  wrHex(snap.pilotState,2);
+  wrDec(snap.currentCapacity);
+  wrDec(snap.chargingCurrent);
+  wrDec(snap.voltage);
+  wrDec(snap.ds3231Temp);
+  wrDec(snap.mcp9808Temp);
+  wrDec(snap.tmp007Temp);
+  wrUDec(snap.sessionWs);
+  wrUDec(snap.totWh);
+  wrUDec(snap.elapsedSec);
+  wrHex(snap.vFlags,4);
+  wrRespEnd();
+#else // !RAPI_STREAM
+  char buf[RAPI_SNAPSHOT_BUFLEN];
+  sprintf(buf,"%cOK %d %02x %02x %d %ld %ld %d %d %d %lu %lu %lu %04x",ESRAPI_SOC,
+	  (int)snap.ver,(int)snap.evseState,(int)snap.pilotState,(int)snap.currentCapacity,
+	  (long)snap.chargingCurrent,(long)snap.voltage,
+	  (int)snap.ds3231Temp,(int)snap.mcp9808Temp,(int)snap.tmp007Temp,
+	  (unsigned long)snap.sessionWs,(unsigned long)snap.totWh,
+	  (unsigned long)snap.elapsedSec,(unsigned)snap.vFlags);
+  if (curReceivedSeqId != INVALID_SEQUENCE_ID) {
+    appendSequenceId(buf,curReceivedSeqId);
+  }
+  appendChk(buf);
+  writeStart();
+  write(buf);
+  if (echo) write('\n');
+  writeEnd();
+#endif // RAPI_STREAM
+}
+#endif // RAPI_SNAPSHOT
+
+#ifdef RAPI_TELEMETRY
+// $AM - call from the main loop. sends nothing until $SU
+void EvseRapiProcessor::sendTelemetry()
+{
+  if (!telemMask || g_inRapiCommand) return;
+  unsigned long msnow = millis();
+  if ((msnow - telemLastMs) < ((unsigned long)telemPeriodMs << telemBackoff)) return;
+  telemLastMs = msnow;
+
+  int32_t v[TLM_MAX_VALUES];
+  uint8_t n = 0;
+  if (telemMask & TLM_CURRENT) v[n++] = g_EvseController.GetChargingCurrent();
+  if (telemMask & TLM_VOLTAGE) v[n++] = g_EvseController.GetVoltage();
+#ifdef KWH_RECORDING
+  if (telemMask & TLM_SESSION_WS) v[n++] = g_EnergyMeter.GetSessionWs();
+  if (telemMask & TLM_TOT_WH) v[n++] = g_EnergyMeter.GetTotkWh();
+#else
+  if (telemMask & TLM_SESSION_WS) v[n++] = 0;
+  if (telemMask & TLM_TOT_WH) v[n++] = 0;
+#endif // KWH_RECORDING
+  if (telemMask & TLM_TEMP) {
+#ifdef TEMPERATURE_MONITORING
+    v[n++] = g_TempMonitor.m_DS3231_temperature;
+    v[n++] = g_TempMonitor.m_MCP9808_temperature;
+    v[n++] = g_TempMonitor.m_TMP007_temperature;
+#else
+    for (uint8_t i=0;i < 3;i++) v[n++] = -2560; // TEMPERATURE_NOT_INSTALLED
+#endif // TEMPERATURE_MONITORING
+  }
+  if (telemMask & TLM_ELAPSED) v[n++] = (int32_t)g_EvseController.GetElapsedChargeTime();
+
+  char buf[RAPI_TELEM_BUFLEN];
+  char *s = buf;
+  uint8_t len;
+#ifdef RAPI_BINARY
+  if (binMode) {
+    *(s++) = 'A';
+    *(s++) = 'M';
+    *(s++) = telemMask;
+    for (uint8_t i=0;i < n;i++) {
+      for (uint8_t j=0;j < 4;j++) {
+	*(s++) = (char)(v[i] >> (j*8));
+      }
+    }
+    len = s - buf;
+    // ss st + crc + COBS overhead and delimiter
+    if (txAvailable() < (len + 6)) goto full;
+    binFrame(INVALID_SEQUENCE_ID,RAPIB_ASYNC,buf,len);
+    telemBackoff = 0;
+    return;
+  }
+#endif // RAPI_BINARY
+  s += sprintf(s,"%cAM %x",ESRAPI_SOC,(unsigned)telemMask);
+  for (uint8_t i=0;i < n;i++) {
+    s += sprintf(s," %ld",(long)v[i]);
+  }
+  appendChk(buf);
+  len = strlen(buf);
+  if (txAvailable() < len) goto full;
+  writeStart();
+  write(buf);
+  if (echo) write('\n');
+  writeEnd();
+  telemBackoff = 0;
+  return;
+
+ full:
+  // host isn't keeping up, or the link is busy - send less often
+  if (telemBackoff < RAPI_TELEM_MAX_BACKOFF) telemBackoff++;
+}
+#endif // RAPI_TELEMETRY
+
+// msg starts with ESRAPI_SOC, and must have room for the checksum
+void EvseRapiProcessor::writeAsync(char *msg)
+{
+#ifdef RAPI_BINARY
+  if (binMode) {
+    binFrame(INVALID_SEQUENCE_ID,RAPIB_ASYNC,msg+1,strlen(msg+1));
+    return;
+  }
+#endif // RAPI_BINARY
+  appendChk(msg);
+  writeStart();
+  write(msg);
+  writeEnd();
+}
 
 void EvseRapiProcessor::sendBootNotification()
 {
   sprintf(g_sTmp,"%cAB %02x ",ESRAPI_SOC,g_EvseController.GetState());
   char *s = g_sTmp+strlen(g_sTmp);
   GetVerStr(s);
-  appendChk(g_sTmp);
-  writeStart();
-  write(g_sTmp);
-  writeEnd();
+  writeAsync(g_sTmp);
 }
 
 
 void EvseRapiProcessor::sendEvseState()
 {
   sprintf(g_sTmp,"%cAT %02x %02x %d %04x",ESRAPI_SOC,g_EvseController.GetState(),g_EvseController.GetPilotState(),g_EvseController.GetCurrentCapacity(),g_EvseController.GetVFlags());
-  appendChk(g_sTmp);
-  writeStart();
-  write(g_sTmp);
-  writeEnd();
+  writeAsync(g_sTmp);
 }
 
 #ifdef RAPI_WF
 void EvseRapiProcessor::setWifiMode(uint8_t mode)
 {
   sprintf(g_sTmp,"%cWF %02x",ESRAPI_SOC,(int)mode);
-  appendChk(g_sTmp);
-  writeStart();
-  write(g_sTmp);
-  writeEnd();
+  writeAsync(g_sTmp);
 }
 #endif // RAPI_WF
 
@@ -190,10 +667,7 @@ void EvseRapiProcessor::setWifiMode(uint8_t mode)
 void EvseRapiProcessor::sendButtonPress(uint8_t long_press)
 {
   sprintf(g_sTmp,"%cAN %d", ESRAPI_SOC, long_press);
-  appendChk(g_sTmp);
-  writeStart();
-  write(g_sTmp);
-  writeEnd();
+  writeAsync(g_sTmp);
 }
 #endif // RAPI_BTN
 
@@ -243,12 +717,10 @@ int EvseRapiProcessor::tokenize(char *buf)
   return rc;
 }
 
-uint8_t g_inRapiCommand = 0;
 int EvseRapiProcessor::processCmd()
 {
   g_inRapiCommand = 1;
 
-  UNION4B u1,u2,u3,u4;
   int rc = -1;
 
 #ifdef RAPI_SENDER
@@ -260,699 +732,924 @@ int EvseRapiProcessor::processCmd()
   }
 #endif // RAPI_SENDER
 
+#ifdef RAPI_BINARY
+  // doBinCmd() already set them from the frame
+  if (!binMode)
+#endif
+  {
   curReceivedSeqId = INVALID_SEQUENCE_ID;
   const char *seqtoken = tokens[tokenCnt-1];
   if ((tokenCnt > 1) && (*seqtoken == ESRAPI_SOS)) {
     curReceivedSeqId = htou8(++seqtoken);
     tokenCnt--;
   }
+  for (int8_t i=1;i < tokenCnt;i++) {
+    args[i] = dtoi32(tokens[i]);
+  }
+  }
 
   // we use bufCnt as a flag in response() to signify data to write
   bufCnt = 0;
 
-  char *s = tokens[0];
-  switch(*(s++)) {
-  case 'F': // function
-    switch(*s) {
-    case '0': // enable/disable LCD update
-      if (tokenCnt == 2) {
-	g_OBD.DisableUpdate((*tokens[1] == '0') ? 1 : 0);
-	if (*tokens[1] != '0') g_OBD.Update(OBD_UPD_FORCE);
-	rc = 0;
-      }
-      break;
- #ifdef BTN_MENU
-    case '1': // simulate front panel short press
-      g_BtnHandler.DoShortPress(g_EvseController.InFaultState());
-      g_OBD.Update(OBD_UPD_FORCE);
-      rc = 0;
-      break;
+  rc = dispatch();
+
+  if (bufCnt != -1){
+    response((rc == 0) ? 1 : 0);
+  }
+
+#ifdef RAPI_BINARY
+  if (binModeReq != RAPIB_REQ_NONE) {
+    binMode = binModeReq;
+    binModeReq = RAPIB_REQ_NONE;
+    if (binMode) echo = 0; // would write raw chars between frames
+#ifdef RAPI_PIPELINE
+    // anything queued or half received behind us is in the old framing
+    inqCnt = 0;
+    inqPos = 0;
+#endif
+  }
+#endif // RAPI_BINARY
+
+  reset();
+
+  g_inRapiCommand = 0;
+
+  // command might have changed EVSE state
+  RapiSendEvseState();
+
+  return rc;
+}
+
+// looks tokens[0] up in rapi_cmds.h and calls its handler if the token
+// count is in range. returns -1 for unknown commands and bad counts
+int EvseRapiProcessor::dispatch()
+{
+  const char *s = tokens[0];
+  uint8_t key = *s ? rapicKey(s[0],s[1]) : RAPIC_NOKEY;
+#ifdef RAPI_CMD_TABLE
+  // second level of the lookup: handler and token count by entry #
+  static const RAPI_CMD_ENTRY cmds[] PROGMEM = {
+#define RAPI_CMD(fam,ch,min,max) { rapi##fam##ch,RAPIC_ARITY(min,max) },
+#include "rapi_cmds.h"
+#undef RAPI_CMD
+  };
+  if (key != RAPIC_NOKEY) {
+    uint8_t idx = pgm_read_byte(&s_RapiCmdIdx[key]);
+    if (idx) {
+      RAPI_CMD_ENTRY cmd;
+      memcpy_P(&cmd,&cmds[idx-1],sizeof(cmd));
+      if (rapicArityOk(cmd.arity,tokenCnt)) return cmd.handler(this);
+    }
+  }
+#else // !RAPI_CMD_TABLE
+  switch(key) {
+#define RAPI_CMD(fam,ch,min,max)					\
+  case RAPIC_KEY(fam,ch):						\
+    return rapicArityOk(RAPIC_ARITY(min,max),tokenCnt) ? rapi##fam##ch(this) : -1;
+#include "rapi_cmds.h"
+#undef RAPI_CMD
+  }
+#endif // RAPI_CMD_TABLE
+  return -1;
+}
+
+//
+// command handlers, in rapi_cmds.h order. the token count is already
+// checked. set rp->bufCnt = 1 to send rp->buffer w/ the response, or -1 if
+// the handler wrote the response itself
+//
+
+int EvseRapiProcessor::rapiF0(EvseRapiProcessor *rp) // enable/disable LCD update
+{
+  g_OBD.DisableUpdate((*rp->tokens[1] == '0') ? 1 : 0);
+  if (*rp->tokens[1] != '0') g_OBD.Update(OBD_UPD_FORCE);
+  return 0;
+}
+
+#ifdef BTN_MENU
+int EvseRapiProcessor::rapiF1(EvseRapiProcessor *) // simulate front panel short press
+{
+  g_BtnHandler.DoShortPress(g_EvseController.InFaultState());
+  g_OBD.Update(OBD_UPD_FORCE);
+  return 0;
+}
 #endif // BTN_MENU
+
 #ifdef LCD16X2
-    case 'B': // LCD backlight
-      if (tokenCnt == 2) {
-	g_OBD.LcdSetBacklightColor(dtoi32(tokens[1]));
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiFB(EvseRapiProcessor *rp) // LCD backlight
+{
+  g_OBD.LcdSetBacklightColor(rp->args[1]);
+  return 0;
+}
 #endif // LCD16X2
-    case 'C': // reset fault counters + total energy
-      g_EvseController.ResetFaultCounters();
-      g_EnergyMeter.ResetTotkWh();
-      rc = 0;
-      break;
-    case 'D': // disable EVSE
-      g_EvseController.Disable();
-      rc = 0;
-      break;
-    case 'E': // enable EVSE
-      g_EvseController.Enable();
-      rc = 0;
-      break;
-    case 'F': // enable/disable feature
-      if (tokenCnt == 3) {
-	u1.u8 = (uint8_t)(*tokens[2] - '0');
-	if (u1.u8 <= 1) {
-	  rc = 0;
-	  switch(*tokens[1]) {
+
+int EvseRapiProcessor::rapiFC(EvseRapiProcessor *) // reset fault counters + total energy
+{
+  g_EvseController.ResetFaultCounters();
+  g_EnergyMeter.ResetTotkWh();
+  return 0;
+}
+
+int EvseRapiProcessor::rapiFD(EvseRapiProcessor *) // disable EVSE
+{
+  g_EvseController.Disable();
+  return 0;
+}
+
+int EvseRapiProcessor::rapiFE(EvseRapiProcessor *) // enable EVSE
+{
+  g_EvseController.Enable();
+  return 0;
+}
+
+int EvseRapiProcessor::rapiFF(EvseRapiProcessor *rp) // enable/disable feature
+{
+  uint8_t enable = (uint8_t)(*rp->tokens[2] - '0');
+  if (enable > 1) return -1;
+  switch(*rp->tokens[1]) {
 #ifdef BTN_MENU
-	  case 'B': // front button enable
-	    g_EvseController.ButtonEnable(u1.u8);
-	    break;
+  case 'B': // front button enable
+    g_EvseController.ButtonEnable(enable);
+    break;
 #endif // BTN_MENU
-	  case 'D': // diode check
-	    g_EvseController.EnableDiodeCheck(u1.u8);
-	    break;
-	  case 'E': // command echo
-	    echo = ((u1.u8 == '0') ? 0 : 1);
-	    break;
+  case 'D': // diode check
+    g_EvseController.EnableDiodeCheck(enable);
+    break;
+  case 'E': // command echo
+    rp->echo = ((enable == '0') ? 0 : 1);
+    break;
+#ifdef RAPI_BINARY
+  case 'M': // binary framing mode
+    rp->binModeReq = enable;
+    break;
+#endif // RAPI_BINARY
 #ifdef ADVPWR
-	  case 'F': // GFI self test
-	    g_EvseController.EnableGfiSelfTest(u1.u8);
-	    break;
-	  case 'G': // ground check
-	    g_EvseController.EnableGndChk(u1.u8);
-	    break;
-	  case 'R': // stuck relay check
-	    g_EvseController.EnableStuckRelayChk(u1.u8);
-	    break;
+  case 'F': // GFI self test
+    g_EvseController.EnableGfiSelfTest(enable);
+    break;
+  case 'G': // ground check
+    g_EvseController.EnableGndChk(enable);
+    break;
+  case 'R': // stuck relay check
+    g_EvseController.EnableStuckRelayChk(enable);
+    break;
 #endif // ADVPWR
 #ifdef BOOTLOCK
-	  case 'L': // boot lock
-	    g_EvseController.EnableBootLock(u1.u8);
-	    break;
+  case 'L': // boot lock
+    g_EvseController.EnableBootLock(enable);
+    break;
 #endif // BOOTLOCK
 #ifdef OVERCURRENT_THRESHOLD
-	  case 'O': // overcurrent check
-	    g_EvseController.EnableOverCurrentCheck(u1.u8);
-	    break;
+  case 'O': // overcurrent check
+    g_EvseController.EnableOverCurrentCheck(enable);
+    break;
 #endif // OVERCURRENT_THRESHOLD
 #ifdef PP_AUTO_AMPACITY
-	  case 'P': // PP auto ampacity 
-	    g_EvseController.EnablePPAutoAmpacity(u1.u8);
-	    break;
+  case 'P': // PP auto ampacity 
+    g_EvseController.EnablePPAutoAmpacity(enable);
+    break;
 #endif // PP_AUTO_AMPACITY
 #ifdef TEMPERATURE_MONITORING
-	  case 'T': // temperature monitoring
-	    g_EvseController.EnableTempChk(u1.u8);
-	    break;
+  case 'T': // temperature monitoring
+    g_EvseController.EnableTempChk(enable);
+    break;
 #endif // TEMPERATURE_MONITORING
-	  case 'V': // vent required check
-	    g_EvseController.EnableVentReq(u1.u8);
-	    break;
+  case 'V': // vent required check
+    g_EvseController.EnableVentReq(enable);
+    break;
 #ifdef RELAY_ZC_SWITCH
-	  case 'Z': // zero-crossing relay switch
-	    g_EvseController.EnableRelayZCSwitch(u1.u8);
-	    break;
+  case 'Z': // zero-crossing relay switch
+    g_EvseController.EnableRelayZCSwitch(enable);
+    break;
 #endif // RELAY_ZC_SWITCH
-	  default: // unknown
-	    rc = -1;
-	  }
-	}
-      }
-      break;
+  default: // unknown
+    return -1;
+  }
+  return 0;
+}
+
 #ifdef TEMPERATURE_MONITORING
-    case 'O': // print to LCD
-      if (tokenCnt == 2) {
-        u1.i16 = dtoi32(tokens[1]);
-        if (u1.i16 > 0) {
-          g_TempMonitor.SetPanicTemperature(u1.i16);
-          rc = 0;
-        }
-      }
-      break;
+int EvseRapiProcessor::rapiFO(EvseRapiProcessor *rp) // set panic temperature
+{
+  int16_t temp = rp->args[1];
+  if (temp <= 0) return -1;
+  g_TempMonitor.SetPanicTemperature(temp);
+  return 0;
+}
 #endif // TEMPERATURE_MONITORING
+
 #ifdef LCD16X2
-    case 'P': // print to LCD
-      if ((tokenCnt >= 4) && !g_EvseController.InHardFault()) {
-	u1.u = dtoi32(tokens[1]); // x
-	u2.u = dtoi32(tokens[2]); // y
-	// now restore the spaces that were replaced w/ nulls by tokenizing
-	for (u3.i=4;u3.i < tokenCnt;u3.i++) {
-	  *(tokens[u3.i]-1) = ' ';
-	}
-	g_OBD.LcdPrint(u1.u,u2.u,tokens[3]);
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiFP(EvseRapiProcessor *rp) // print to LCD
+{
+  if (g_EvseController.InHardFault()) return -1;
+  uint8_t x = rp->args[1];
+  uint8_t y = rp->args[2];
+  // now restore the spaces that were replaced w/ nulls by tokenizing
+  for (int8_t i=4;i < rp->tokenCnt;i++) {
+    *(rp->tokens[i]-1) = ' ';
+  }
+  g_OBD.LcdPrint(x,y,rp->tokens[3]);
+  return 0;
+}
 #endif // LCD16X2
-    case 'R': // reset EVSE
-      g_EvseController.Reboot();
-      rc = 0;
-      break;
-    case 'S': // sleep
-      g_EvseController.Sleep();
-      rc = 0;
-      break;
-    }
-    break;
 
-  case 'S': // set parameter
-    switch(*s) {
+int EvseRapiProcessor::rapiFR(EvseRapiProcessor *) // reset EVSE
+{
+  g_EvseController.Reboot();
+  return 0;
+}
+
+int EvseRapiProcessor::rapiFS(EvseRapiProcessor *) // sleep
+{
+  g_EvseController.Sleep();
+  return 0;
+}
+
 #ifdef LCD16X2
-    case '0': // set LCD type
-      if (tokenCnt == 2) {
+int EvseRapiProcessor::rapiS0(EvseRapiProcessor *rp) // set LCD type
+{
 #ifdef RGBLCD
-	rc = g_EvseController.SetBacklightType((*tokens[1] == '0') ? BKL_TYPE_MONO : BKL_TYPE_RGB);
+  return g_EvseController.SetBacklightType((*rp->tokens[1] == '0') ? BKL_TYPE_MONO : BKL_TYPE_RGB);
+#else
+  return -1;
 #endif // RGBLCD
-      }
-      break;
+}
 #endif // LCD16X2
+
 #ifdef HAVE_RTC
-    case '1': // set RTC
-      if (tokenCnt == 7) {
-	extern void SetRTC(uint8_t y,uint8_t m,uint8_t d,uint8_t h,uint8_t mn,uint8_t s);
-	SetRTC(dtoi32(tokens[1]),dtoi32(tokens[2]),dtoi32(tokens[3]),
-	       dtoi32(tokens[4]),dtoi32(tokens[5]),dtoi32(tokens[6]));
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiS1(EvseRapiProcessor *rp) // set RTC
+{
+  extern void SetRTC(uint8_t y,uint8_t m,uint8_t d,uint8_t h,uint8_t mn,uint8_t s);
+  SetRTC(rp->args[1],rp->args[2],rp->args[3],
+	 rp->args[4],rp->args[5],rp->args[6]);
+  return 0;
+}
 #endif // HAVE_RTC
+
 #if defined(AMMETER) && defined(ECVF_AMMETER_CAL)
-    case '2': // ammeter calibration mode
-      if (tokenCnt == 2) {
-	g_EvseController.EnableAmmeterCal((*tokens[1] == '1') ? 1 : 0);
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiS2(EvseRapiProcessor *rp) // ammeter calibration mode
+{
+  g_EvseController.EnableAmmeterCal((*rp->tokens[1] == '1') ? 1 : 0);
+  return 0;
+}
 #endif // AMMETER && ECVF_AMMETER_CAL
+
 #ifdef TIME_LIMIT
-    case '3': // set time limit
-      if (tokenCnt == 2) {
-	if (g_EvseController.LimitsAllowed()) {
-	  g_EvseController.SetTimeLimit15(dtoi32(tokens[1]));
-	  if (!g_OBD.UpdatesDisabled()) g_OBD.Update(OBD_UPD_FORCE);
-	  rc = 0;
-	}
-      }
-      break;
+int EvseRapiProcessor::rapiS3(EvseRapiProcessor *rp) // set time limit
+{
+  if (!g_EvseController.LimitsAllowed()) return -1;
+  g_EvseController.SetTimeLimit15(rp->args[1]);
+  if (!g_OBD.UpdatesDisabled()) g_OBD.Update(OBD_UPD_FORCE);
+  return 0;
+}
 #endif // TIME_LIMIT
+
 #if defined(AUTH_LOCK) && !defined(AUTH_LOCK_REG)
-    case '4': // auth lock
-      if (tokenCnt == 2) {
-	g_EvseController.AuthLock((int8_t)dtoi32(tokens[1]),1);
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiS4(EvseRapiProcessor *rp) // auth lock
+{
+  g_EvseController.AuthLock((int8_t)rp->args[1],1);
+  return 0;
+}
 #endif // AUTH_LOCK && !AUTH_LOCK_REG
+
 #ifdef MENNEKES_LOCK
-    case '5': // mennekes setting
-      if (tokenCnt == 2) {
-	rc = 0;
-        switch(*tokens[1]) {
-        case '0':
-          g_EvseController.UnlockMennekes();
-          break;
-        case '1':
-          g_EvseController.LockMennekes();
-          break;
-        case 'A':
-          g_EvseController.ClrMennekesManual();
-          break;
-        case 'M':
-          g_EvseController.SetMennekesManual();
-          break;
-        default:
-          rc = 1;
-        }
-      }
-      break;
+int EvseRapiProcessor::rapiS5(EvseRapiProcessor *rp) // mennekes setting
+{
+  switch(*rp->tokens[1]) {
+  case '0':
+    g_EvseController.UnlockMennekes();
+    break;
+  case '1':
+    g_EvseController.LockMennekes();
+    break;
+  case 'A':
+    g_EvseController.ClrMennekesManual();
+    break;
+  case 'M':
+    g_EvseController.SetMennekesManual();
+    break;
+  default:
+    return 1;
+  }
+  return 0;
+}
 #endif // MENNEKES_LOCK
+
 #ifdef AMMETER
-    case 'A':
-      if (tokenCnt == 3) {
-	g_EvseController.SetCurrentScaleFactor(dtoi32(tokens[1]));
-	g_EvseController.SetAmmeterCurrentOffset(dtoi32(tokens[2]));
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiSA(EvseRapiProcessor *rp) // ammeter settings
+{
+  g_EvseController.SetCurrentScaleFactor(rp->args[1]);
+  g_EvseController.SetAmmeterCurrentOffset(rp->args[2]);
+  return 0;
+}
 #endif // AMMETER
+
 #ifdef BOOTLOCK
-    case 'B':
-      if (g_EvseController.InFaultState()) {
-        strcpy(buffer,"1");
-      }
-      else {
-        g_EvseController.ClearBootLock();
-        strcpy(buffer,"0");
-      }
-      bufCnt=1;
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiSB(EvseRapiProcessor *rp) // clear boot lock
+{
+  if (g_EvseController.InFaultState()) {
+    strcpy(rp->buffer,"1");
+  }
+  else {
+    g_EvseController.ClearBootLock();
+    strcpy(rp->buffer,"0");
+  }
+  rp->bufCnt = 1;
+  return 0;
+}
 #endif // BOOTLOCK
-    case 'C': // current capacity
-      if ((tokenCnt == 2) || (tokenCnt == 3)) {
-	u2.u8 = dtoi32(tokens[1]);
-	if ((tokenCnt == 3) && (*tokens[2] == 'M')) {
-	  rc = g_EvseController.SetMaxHwCurrentCapacity(u2.u8);
-	  sprintf(buffer,"%d",(int)g_EvseController.GetMaxHwCurrentCapacity());
-	}
-	else {
-	  if (tokenCnt == 3) {
-	    // just make volatile no matter what character specified
-	    u1.u8 = 1; // nosave = 1
-	  }
-	  else {
-	    u1.u8 = 0; // nosave = 0
-	  }
+
+int EvseRapiProcessor::rapiSC(EvseRapiProcessor *rp) // current capacity
+{
+  int rc;
+  uint8_t amps = rp->args[1];
+  if ((rp->tokenCnt == 3) && (*rp->tokens[2] == 'M')) {
+    rc = g_EvseController.SetMaxHwCurrentCapacity(amps);
+    sprintf(rp->buffer,"%d",(int)g_EvseController.GetMaxHwCurrentCapacity());
+  }
+  else {
+    // just make volatile no matter what character specified
+    uint8_t nosave = (rp->tokenCnt == 3) ? 1 : 0;
 #ifdef TEMPERATURE_MONITORING
-	  if (g_TempMonitor.OverTemperature() &&
-	      (u2.u8 > g_EvseController.GetCurrentCapacity())) {
-	    // don't allow raising current capacity during
-	    // overtemperature event
-	    rc = 1;
-	  }
-	  else {
-	    rc = g_EvseController.SetCurrentCapacity(u2.u8,1,u1.u8);
-	  }
+    if (g_TempMonitor.OverTemperature() &&
+	(amps > g_EvseController.GetCurrentCapacity())) {
+      // don't allow raising current capacity during
+      // overtemperature event
+      rc = 1;
+    }
+    else {
+      rc = g_EvseController.SetCurrentCapacity(amps,1,nosave);
+    }
 #else // !TEMPERATURE_MONITORING
-	  rc = g_EvseController.SetCurrentCapacity(u2.u8,1,u1.u8);
+    rc = g_EvseController.SetCurrentCapacity(amps,1,nosave);
 #endif // TEMPERATURE_MONITORING
   
-	  sprintf(buffer,"%d",(int)g_EvseController.GetCurrentCapacity());
-	}
-	bufCnt = 1; // flag response text output
-      }
-      break;
+    sprintf(rp->buffer,"%d",(int)g_EvseController.GetCurrentCapacity());
+  }
+  rp->bufCnt = 1; // flag response text output
+  return rc;
+}
+
+#ifdef DEBOUNCE_SAMPLES
+int EvseRapiProcessor::rapiSD(EvseRapiProcessor *rp) // state transition Debounce
+{
+  uint8_t state = (uint8_t)rp->args[1];
+  int32_t cnt = rp->args[2];
+  if ((state > EVSE_STATE_D) || (cnt < 1) || (cnt > 255)) return -1;
+  g_EvseController.SetDebounceCnt(debounceIdx(state),(uint8_t)cnt);
+  return 0;
+}
+#endif // DEBOUNCE_SAMPLES
+
 #ifdef CHARGE_LIMIT
-    case 'H': // cHarge limit
-      if (tokenCnt == 2) {
-	if (g_EvseController.LimitsAllowed()) {
-	  g_EvseController.SetChargeLimitkWh(dtoi32(tokens[1]));
-	  if (!g_OBD.UpdatesDisabled()) g_OBD.Update(OBD_UPD_FORCE);
-	  rc = 0;
-	}
-      }
-      break;
+int EvseRapiProcessor::rapiSH(EvseRapiProcessor *rp) // cHarge limit
+{
+  if (!g_EvseController.LimitsAllowed()) return -1;
+  g_EvseController.SetChargeLimitkWh(rp->args[1]);
+  if (!g_OBD.UpdatesDisabled()) g_OBD.Update(OBD_UPD_FORCE);
+  return 0;
+}
 #endif // CHARGE_LIMIT
+
 #ifdef KWH_RECORDING
-    case 'K': // set accumulated kwh
-      g_EnergyMeter.SetTotkWh(dtoi32(tokens[1]));
-      g_EnergyMeter.SaveTotkWh();
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiSK(EvseRapiProcessor *rp) // set accumulated kwh
+{
+  g_EnergyMeter.SetTotkWh(rp->args[1]);
+  g_EnergyMeter.SaveTotkWh();
+  return 0;
+}
 #endif //KWH_RECORDING
-    case 'L': // service level
-      if (tokenCnt == 2) {
-      switch(*tokens[1]) {
-	case '1':
-	case '2':
-	  g_EvseController.SetSvcLevel(*tokens[1] - '0',1);
+
+int EvseRapiProcessor::rapiSL(EvseRapiProcessor *rp) // service level
+{
+  switch(*rp->tokens[1]) {
+  case '1':
+  case '2':
+    g_EvseController.SetSvcLevel(*rp->tokens[1] - '0',1);
 #if defined(ADVPWR) && defined(AUTOSVCLEVEL)
-	  g_EvseController.EnableAutoSvcLevel(0);
+    g_EvseController.EnableAutoSvcLevel(0);
 #endif
-	  rc = 0;
-	  break;
+    return 0;
 #if defined(ADVPWR) && defined(AUTOSVCLEVEL)
-	case 'A':
-	  g_EvseController.EnableAutoSvcLevel(1);
-	  rc = 0;
-	  break;
+  case 'A':
+    g_EvseController.EnableAutoSvcLevel(1);
+    return 0;
 #endif // ADVPWR && AUTOSVCLEVEL
-	}
-      }
-      break;
+  }
+  return -1;
+}
+
 #ifdef VOLTMETER
-    case 'M':
-      if (tokenCnt == 3) {
-        g_EvseController.SetVoltmeter(dtoi32(tokens[1]),dtoi32(tokens[2]));
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiSM(EvseRapiProcessor *rp) // voltmeter settings
+{
+  g_EvseController.SetVoltmeter(rp->args[1],rp->args[2]);
+  return 0;
+}
 #endif // VOLTMETER
+
+int EvseRapiProcessor::rapiSR(EvseRapiProcessor *rp) // relay enable/disable  $SR n 0|1
+{
+  uint8_t relay = (uint8_t)rp->args[1]; // relay number 1=DC1 2=DC2 3=AC
+  uint8_t enable = (*rp->tokens[2] != '0') ? 1 : 0; // 1=enable 0=disable
+  uint8_t flag;
+  switch (relay) {
+  case 1: flag = ERELAYF_DC1_DISABLED; break;
+  case 2: flag = ERELAYF_DC2_DISABLED; break;
+  case 3: flag = ERELAYF_AC_DISABLED;  break;
+  default: return -1;
+  }
+  uint8_t flags = g_EvseController.GetRelayFlags();
+  if (enable) flags &= ~flag;
+  else        flags |=  flag;
+  g_EvseController.SetRelayFlags(flags);
+  return 0;
+}
+
 #ifdef DELAYTIMER     
-    case 'T': // timer
-      if (tokenCnt == 5) {
-	extern DelayTimer g_DelayTimer;
-	u1.u8 = (uint8_t)dtoi32(tokens[1]);
-	u2.u8 = (uint8_t)dtoi32(tokens[2]);
-	u3.u8 = (uint8_t)dtoi32(tokens[3]);
-	u4.u8 = (uint8_t)dtoi32(tokens[4]);
-	if ((u1.u8 == 0) && (u2.u8 == 0) && (u3.u8 == 0) && (u4.u8 == 0)) {
-	  g_DelayTimer.Disable();
-	}
-	else {
-	  g_DelayTimer.SetStartTimer(u1.u8,u2.u8);
-	  g_DelayTimer.SetStopTimer(u3.u8,u4.u8);
-	  g_DelayTimer.Enable();
-	}
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiST(EvseRapiProcessor *rp) // timer
+{
+  extern DelayTimer g_DelayTimer;
+  uint8_t starth = (uint8_t)rp->args[1];
+  uint8_t startm = (uint8_t)rp->args[2];
+  uint8_t stoph = (uint8_t)rp->args[3];
+  uint8_t stopm = (uint8_t)rp->args[4];
+  if ((starth == 0) && (startm == 0) && (stoph == 0) && (stopm == 0)) {
+    g_DelayTimer.Disable();
+  }
+  else {
+    g_DelayTimer.SetStartTimer(starth,startm);
+    g_DelayTimer.SetStopTimer(stoph,stopm);
+    g_DelayTimer.Enable();
+  }
+  return 0;
+}
 #endif // DELAYTIMER      
 
+#ifdef RAPI_TELEMETRY
+int EvseRapiProcessor::rapiSU(EvseRapiProcessor *rp) // sUbscribe to telemetry
+{
+  uint8_t mask = htou8(rp->tokens[1]) & TLM_ALL;
+  int32_t periodms = rp->args[2];
+  if (!mask || !periodms) {
+    rp->telemMask = 0;
+    return 0;
+  }
+  if ((periodms < RAPI_TELEM_MIN_MS) || (periodms > 65535)) return -1;
+  rp->telemMask = mask;
+  rp->telemPeriodMs = (uint16_t)periodms;
+  rp->telemBackoff = 0;
+  rp->telemLastMs = millis() - rp->telemPeriodMs; // first one right away
+  return 0;
+}
+#endif // RAPI_TELEMETRY
+
 #if defined(KWH_RECORDING) && !defined(VOLTMETER)
-    case 'V': // set voltage
-      if (tokenCnt == 2) {
-        g_EvseController.SetMV(dtoi32(tokens[1]));
-	rc = 0;
-      }
-      break;
+int EvseRapiProcessor::rapiSV(EvseRapiProcessor *rp) // set voltage
+{
+  g_EvseController.SetMV(rp->args[1]);
+  return 0;
+}
 #endif //defined(KWH_RECORDING) && !defined(VOLTMETER)
 
 #ifdef HEARTBEAT_SUPERVISION
-    case 'Y': // HEARTBEAT SUPERVISION
-      if (tokenCnt == 1)  { //This is a heartbeat
-        rc = g_EvseController.HsPulse(); //pet the dog
-      }
-      else if (tokenCnt == 3) { //This is a full HEARTBEAT_SUPERVISION setpoint command with both parameters
-	    rc = 0;
-        u1.u16 = (uint16_t)dtoi32(tokens[1]);	// HS Interval in seconds.  0 = disabled
-        u2.u8 = (uint8_t)dtoi32(tokens[2]);	// HS fallback current, in amperes 
-		if (u1.u16 == 0) { //Test for deactivation {
-          rc = g_EvseController.HsRestoreAmpacity();
-		}
-		rc |= g_EvseController.HeartbeatSupervision(u1.u16, u2.u8);
-      }
-      else if (tokenCnt == 2) { //This is a command to ack a heartbeat supervision miss
-        u1.u8 = (uint8_t)dtoi32(tokens[1]); //Magic cookie
-        rc = g_EvseController.HsAckMissedPulse(u1.u8);
-      }
-      else { //Invalid number of tokens, return 1
-        rc = 1; //Invalid number of tokens
-      }
-      sprintf(buffer,"%d %d %d", g_EvseController.GetHearbeatInterval(), g_EvseController.GetHearbeatCurrent(), g_EvseController.GetHearbeatTrigger());
-      bufCnt = 1;
-      break;
+int EvseRapiProcessor::rapiSY(EvseRapiProcessor *rp) // HEARTBEAT SUPERVISION
+{
+  int rc;
+  if (rp->tokenCnt == 1)  { //This is a heartbeat
+    rc = g_EvseController.HsPulse(); //pet the dog
+  }
+  else if (rp->tokenCnt == 3) { //This is a full HEARTBEAT_SUPERVISION setpoint command with both parameters
+    rc = 0;
+    uint16_t interval = (uint16_t)rp->args[1]; // HS Interval in seconds.  0 = disabled
+    uint8_t amps = (uint8_t)rp->args[2]; // HS fallback current, in amperes 
+    if (interval == 0) { //Test for deactivation {
+      rc = g_EvseController.HsRestoreAmpacity();
+    }
+    rc |= g_EvseController.HeartbeatSupervision(interval,amps);
+  }
+  else { //This is a command to ack a heartbeat supervision miss
+    uint8_t cookie = (uint8_t)rp->args[1]; //Magic cookie
+    rc = g_EvseController.HsAckMissedPulse(cookie);
+  }
+  sprintf(rp->buffer,"%d %d %d", g_EvseController.GetHearbeatInterval(), g_EvseController.GetHearbeatCurrent(), g_EvseController.GetHearbeatTrigger());
+  rp->bufCnt = 1;
+  return rc;
+}
 #endif //HEARTBEAT_SUPERVISION
 
-    case 'R': // relay enable/disable  $SR n 0|1
-      if (tokenCnt == 3) {
-        u1.u8 = (uint8_t)dtoi32(tokens[1]); // relay number 1=DC1 2=DC2 3=AC
-        u2.u8 = (*tokens[2] != '0') ? 1 : 0; // 1=enable 0=disable
-        switch (u1.u8) {
-        case 1: u3.u8 = ERELAYF_DC1_DISABLED; break;
-        case 2: u3.u8 = ERELAYF_DC2_DISABLED; break;
-        case 3: u3.u8 = ERELAYF_AC_DISABLED;  break;
-        default: u3.u8 = 0; break;
-        }
-        if (u3.u8) {
-          u4.u8 = g_EvseController.GetRelayFlags();
-          if (u2.u8) u4.u8 &= ~u3.u8;
-          else       u4.u8 |=  u3.u8;
-          g_EvseController.SetRelayFlags(u4.u8);
-          rc = 0;
-        }
-      }
-      break;
-
-    }
-    break;
+int EvseRapiProcessor::rapiG0(EvseRapiProcessor *rp) // get EV connect state
+{
+  uint8_t connstate;
+  if (g_EvseController.GetPilot()->GetState() == PILOT_STATE_N12) {
+    connstate = 2; // unknown
+  }
+  else {
+    if (g_EvseController.EvConnected()) connstate = 1;
+    else connstate = 0;
+  }
+  sprintf(rp->buffer,"%d",(int)connstate);
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 
-  case 'G': // get parameter
-    switch(*s) {
-    case '0': // get EV connect state
-      {
-	uint8_t connstate;
-	if (g_EvseController.GetPilot()->GetState() == PILOT_STATE_N12) {
-	  connstate = 2; // unknown
-	}
-	else {
-	  if (g_EvseController.EvConnected()) connstate = 1;
-	  else connstate = 0;
-	}
-	sprintf(buffer,"%d",(int)connstate);
-      }
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
 #ifdef TIME_LIMIT
-    case '3': // get time limit
-      sprintf(buffer,"%d",(int)g_EvseController.GetTimeLimit15());
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiG3(EvseRapiProcessor *rp) // get time limit
+{
+  sprintf(rp->buffer,"%d",(int)g_EvseController.GetTimeLimit15());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // TIME_LIMIT
+
 #if defined(AUTH_LOCK) && !defined(AUTH_LOCK_REG)
-    case '4': // get auth lock
-      sprintf(buffer,"%d",(int)g_EvseController.AuthLockIsOn() ? 1 : 0);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiG4(EvseRapiProcessor *rp) // get auth lock
+{
+  sprintf(rp->buffer,"%d",(int)g_EvseController.AuthLockIsOn() ? 1 : 0);
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // AUTH_LOCK && !AUTH_LOCK_REG
+
 #ifdef MENNEKES_LOCK
-    case '5': // get mennekes setting
-      sprintf(buffer,"%d %c",g_EvseController.MennekesIsLocked(),
-              g_EvseController.MennekesIsManual() ? 'M' : 'A');
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiG5(EvseRapiProcessor *rp) // get mennekes setting
+{
+  sprintf(rp->buffer,"%d %c",g_EvseController.MennekesIsLocked(),
+	  g_EvseController.MennekesIsManual() ? 'M' : 'A');
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // MENNEKES_LOCK
+
 #ifdef AMMETER
-    case 'A':
-      u1.i = g_EvseController.GetCurrentScaleFactor();
-      u2.i = g_EvseController.GetAmmeterCurrentOffset();
-      sprintf(buffer,"%d %d",u1.i,u2.i);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGA(EvseRapiProcessor *rp) // get ammeter settings
+{
+  sprintf(rp->buffer,"%d %d",(int)g_EvseController.GetCurrentScaleFactor(),
+	  (int)g_EvseController.GetAmmeterCurrentOffset());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // AMMETER
-    case 'C': // get current capacity range
-      u1.i = MIN_CURRENT_CAPACITY_J1772;
-      if (g_EvseController.GetCurSvcLevel() == 2) {
-	u2.i = g_EvseController.GetMaxHwCurrentCapacity();
-      }
-      else {
-	u2.i = MAX_CURRENT_CAPACITY_L1;
-      }
-      u3.i = g_EvseController.GetCurrentCapacity();
-      u4.i = g_EvseController.GetMaxCurrentCapacity();
-      sprintf(buffer,"%d %d %d %d",u1.i,u2.i,u3.i,u4.i);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+
+#ifdef STAGED_POST
+int EvseRapiProcessor::rapiGB(EvseRapiProcessor *rp) // get Boot timing
+{
+  sprintf(rp->buffer,"%u %lu",(unsigned)g_EvseController.GetPostMs(),(unsigned long)g_EvseController.GetReadyMs());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+#endif // STAGED_POST
+
+int EvseRapiProcessor::rapiGC(EvseRapiProcessor *rp) // get current capacity range
+{
+  int maxamps;
+  if (g_EvseController.GetCurSvcLevel() == 2) {
+    maxamps = g_EvseController.GetMaxHwCurrentCapacity();
+  }
+  else {
+    maxamps = MAX_CURRENT_CAPACITY_L1;
+  }
+  sprintf(rp->buffer,"%d %d %d %d",(int)MIN_CURRENT_CAPACITY_J1772,maxamps,
+	  (int)g_EvseController.GetCurrentCapacity(),
+	  (int)g_EvseController.GetMaxCurrentCapacity());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+
 #ifdef DELAYTIMER
-    case 'D': // get delay timer
-      extern DelayTimer g_DelayTimer;
-      if (g_DelayTimer.IsTimerEnabled()) {
-	u1.i = g_DelayTimer.GetStartTimerHour();
-	u2.i = g_DelayTimer.GetStartTimerMin();
-	u3.i = g_DelayTimer.GetStopTimerHour();
-	u4.i = g_DelayTimer.GetStopTimerMin();
-      }
-      else {
-	u1.i = 0;
-	u2.i = 0;
-	u3.i = 0;
-	u4.i = 0;
-      }
-      sprintf(buffer,"%d %d %d %d",u1.i,u2.i,u3.i,u4.i);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGD(EvseRapiProcessor *rp) // get delay timer
+{
+  extern DelayTimer g_DelayTimer;
+  if (g_DelayTimer.IsTimerEnabled()) {
+    sprintf(rp->buffer,"%d %d %d %d",
+	    (int)g_DelayTimer.GetStartTimerHour(),(int)g_DelayTimer.GetStartTimerMin(),
+	    (int)g_DelayTimer.GetStopTimerHour(),(int)g_DelayTimer.GetStopTimerMin());
+  }
+  else {
+    strcpy(rp->buffer,"0 0 0 0");
+  }
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // DELAYTIMER
-    case 'E': // get settings
-      u1.u = g_EvseController.GetCurrentCapacity();
-      u2.u = g_EvseController.GetFlags();
-      sprintf(buffer,"%d %04x",u1.u,u2.u);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
-    case 'F': // get fault counters
+
+int EvseRapiProcessor::rapiGE(EvseRapiProcessor *rp) // get settings
+{
+  sprintf(rp->buffer,"%d %04x",(int)g_EvseController.GetCurrentCapacity(),
+	  (unsigned)g_EvseController.GetFlags());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+
+int EvseRapiProcessor::rapiGF(EvseRapiProcessor *rp) // get fault counters
+{
+  unsigned gfi,nognd,stuck;
 #ifdef GFI
-      u1.u = g_EvseController.GetGfiTripCnt();
+  gfi = g_EvseController.GetGfiTripCnt();
 #else
-      u1.u = 0;
+  gfi = 0;
 #endif // GFI
 #ifdef ADVPWR
-      u2.u = g_EvseController.GetNoGndTripCnt();
-      u3.u = g_EvseController.GetStuckRelayTripCnt();
+  nognd = g_EvseController.GetNoGndTripCnt();
+  stuck = g_EvseController.GetStuckRelayTripCnt();
 #else
-	  u2.u = 0;
-	  u3.u = 0;
+  nognd = 0;
+  stuck = 0;
 #endif // ADVPWR
-      sprintf(buffer,"%x %x %x",u1.u,u2.u,u3.u);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+  sprintf(rp->buffer,"%x %x %x",gfi,nognd,stuck);
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+
 #if defined(AMMETER)||defined(VOLTMETER)
-    case 'G':
-      u1.i32 = g_EvseController.GetChargingCurrent();
-      u2.i32 = (int32_t)g_EvseController.GetVoltage();
-      sprintf(buffer,"%ld %ld",u1.i32,u2.i32);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGG(EvseRapiProcessor *rp) // get charging current and voltage
+{
+  RAPI_GG_DATA d;
+  d.chargingCurrent = g_EvseController.GetChargingCurrent();
+  d.voltage = (int32_t)g_EvseController.GetVoltage();
+#ifdef RAPI_BINARY
+  if (rp->binMode) return rp->binData(&d,sizeof(d));
+#endif
+#ifdef RAPI_STREAM
+  rp->wrRespStart(1);
+  rp->wrDec(d.chargingCurrent);
+  rp->wrDec(d.voltage);
+  rp->wrRespEnd();
+#else
+  sprintf(rp->buffer,"%ld %ld",(long)d.chargingCurrent,(long)d.voltage);
+  rp->bufCnt = 1; // flag response text output
+#endif // RAPI_STREAM
+  return 0;
+}
 #endif // AMMETER || VOLTMETER
+
 #ifdef CHARGE_LIMIT
-    case 'H': // get cHarge limit
-      sprintf(buffer,"%d",(int)g_EvseController.GetChargeLimitkWh());
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGH(EvseRapiProcessor *rp) // get cHarge limit
+{
+  sprintf(rp->buffer,"%d",(int)g_EvseController.GetChargeLimitkWh());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // CHARGE_LIMIT
+
 #ifdef MCU_ID_LEN
-    case 'I': // get MCU ID
-      {
-        uint8_t mcuid[MCU_ID_LEN];
-        getMcuId(mcuid);
-        char *s = buffer;
+int EvseRapiProcessor::rapiGI(EvseRapiProcessor *rp) // get MCU ID
+{
+  uint8_t mcuid[MCU_ID_LEN];
+  getMcuId(mcuid);
+  char *s = rp->buffer;
 #ifdef TARGET_M328P
-        *(s++) = ' ';
-        for (int i=0;i < 6;i++) {
-          *(s++) = mcuid[i];
-        }
-        for (int i=6;i < MCU_ID_LEN;i++) {
-          sprintf(s,"%02X",mcuid[i]);
-          s += 2;
-        }
+  *(s++) = ' ';
+  for (int i=0;i < 6;i++) {
+    *(s++) = mcuid[i];
+  }
+  for (int i=6;i < MCU_ID_LEN;i++) {
+    sprintf(s,"%02X",mcuid[i]);
+    s += 2;
+  }
 #else
-        for (int i=0;i < MCU_ID_LEN;i++) {
-          sprintf(s,"%02X",mcuid[i]);
-          s += 2;
-        }
+  for (int i=0;i < MCU_ID_LEN;i++) {
+    sprintf(s,"%02X",mcuid[i]);
+    s += 2;
+  }
 #endif
-        bufCnt = 1; // flag response text output
-        rc = 0;
-      }
-      break;
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // MCU_ID_LEN
+
+#ifdef TASK_SCHEDULER
+int EvseRapiProcessor::rapiGK(EvseRapiProcessor *rp) // get tasK stats
+{
+  if (rp->tokenCnt == 1) {
+#ifdef IDLE_SLEEP
+    sprintf(rp->buffer,"%d %d",(int)g_Scheduler.GetTaskCnt(),(int)g_Scheduler.GetIdlePct());
+#else
+    sprintf(rp->buffer,"%d",(int)g_Scheduler.GetTaskCnt());
+#endif // IDLE_SLEEP
+  }
+  else {
+    const TASK_STATS *ts = g_Scheduler.GetStats((uint8_t)rp->args[1]);
+    if (!ts) return -1;
+    sprintf(rp->buffer,"%x %x %x %x",ts->runs,ts->misses,ts->overruns,ts->maxUs);
+  }
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+#endif // TASK_SCHEDULER
+
+#ifdef LATENCY_STATS
+int EvseRapiProcessor::rapiGL(EvseRapiProcessor *rp) // get Latency stats
+{
+  if (rp->tokenCnt == 1) {
+    sprintf(rp->buffer,"%d %lx %ld",(int)LAT_CNT,(unsigned long)g_LatencyStats.GetMaxLoopUs(),(long)g_LatencyStats.GetWdtMarginMs());
+    rp->bufCnt = 1; // flag response text output
+    return 0;
+  }
+  const LATENCY_HIST *lh = g_LatencyStats.GetHist((uint8_t)rp->args[1]);
+  if (!lh) return -1;
+  if (rp->tokenCnt == 2) {
+    sprintf(rp->buffer,"%lx %lx",(unsigned long)lh->cnt,(unsigned long)lh->maxUs);
+  }
+  else {
+    unsigned first = (uint8_t)rp->args[2] * LAT_PAGE_BUCKETS;
+    if (first >= LAT_BUCKETS) return -1;
+    char *s = rp->buffer;
+    for (unsigned i=first;i < (first+LAT_PAGE_BUCKETS);i++) {
+      s += sprintf(s,(i == first) ? "%lx" : " %lx",(unsigned long)lh->bucket[i]);
+    }
+  }
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+#endif // LATENCY_STATS
+
 #ifdef VOLTMETER
-    case 'M':
-      u1.i = g_EvseController.GetVoltScaleFactor();
-      u2.i32 = g_EvseController.GetVoltOffset();
-      sprintf(buffer,"%d %ld",u1.i,u2.i32);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGM(EvseRapiProcessor *rp) // get voltmeter settings
+{
+  sprintf(rp->buffer,"%d %ld",(int)g_EvseController.GetVoltScaleFactor(),
+	  (long)g_EvseController.GetVoltOffset());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // VOLTMETER
+
+#ifdef DEBOUNCE_SAMPLES
+int EvseRapiProcessor::rapiGN(EvseRapiProcessor *rp) // get debouNce
+{
+  uint8_t state = (uint8_t)rp->args[1];
+  if (state > EVSE_STATE_D) return -1;
+  sprintf(rp->buffer,"%d",(int)g_EvseController.GetDebounceCnt(debounceIdx(state)));
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+#endif // DEBOUNCE_SAMPLES
+
 #ifdef TEMPERATURE_MONITORING
-    case 'O':
-      u1.i = g_TempMonitor.m_panicTemperature;
-      sprintf(buffer,"%d",u1.i);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
-    case 'P':
-      sprintf(buffer,"%d %d %d",(int)g_TempMonitor.m_DS3231_temperature,
-	      (int)g_TempMonitor.m_MCP9808_temperature,
-	      (int)g_TempMonitor.m_TMP007_temperature);
-      /* this is bigger than using sprintf
-      strcpy(buffer,u2a(g_TempMonitor.m_DS3231_temperature));
-      strcat(buffer,g_sSpace);
-      strcat(buffer,u2a(g_TempMonitor.m_MCP9808_temperature));
-      strcat(buffer,g_sSpace);
-      strcat(buffer,u2a(g_TempMonitor.m_TMP007_temperature));
-      */
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
-#endif // TEMPERATURE_MONITORING
-    case 'S': // get state
-      u1.u8 = g_EvseController.GetState();
-      u2.u8 = g_EvseController.GetPilotState();
-      u3.u16 = g_EvseController.GetVFlags();
-#ifdef TARGET_M328P
-      sprintf(buffer,"%02x %ld %02x %04x",u1.u8,g_EvseController.GetElapsedChargeTime(),u2.u8,u3.u16);
+int EvseRapiProcessor::rapiGO(EvseRapiProcessor *rp) // get panic temperature
+{
+  sprintf(rp->buffer,"%d",(int)g_TempMonitor.m_panicTemperature);
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+
+int EvseRapiProcessor::rapiGP(EvseRapiProcessor *rp) // get temperatures
+{
+  RAPI_GP_DATA d;
+  d.ds3231Temp = g_TempMonitor.m_DS3231_temperature;
+  d.mcp9808Temp = g_TempMonitor.m_MCP9808_temperature;
+  d.tmp007Temp = g_TempMonitor.m_TMP007_temperature;
+#ifdef RAPI_BINARY
+  if (rp->binMode) return rp->binData(&d,sizeof(d));
+#endif
+#ifdef RAPI_STREAM
+  rp->wrRespStart(1);
+  rp->wrDec(d.ds3231Temp);
+  rp->wrDec(d.mcp9808Temp);
+  rp->wrDec(d.tmp007Temp);
+  rp->wrRespEnd();
 #else
-      sprintf(buffer,"%02x %ld %02x %04x",u1.u8,(long int)g_EvseController.GetElapsedChargeTime(),u2.u8,u3.u16);
+  sprintf(rp->buffer,"%d %d %d",(int)d.ds3231Temp,(int)d.mcp9808Temp,
+	  (int)d.tmp007Temp);
+  rp->bufCnt = 1; // flag response text output
+#endif // RAPI_STREAM
+  return 0;
+}
+#endif // TEMPERATURE_MONITORING
+
+int EvseRapiProcessor::rapiGR(EvseRapiProcessor *rp) // get relay enable status  $GR
+{
+  sprintf(rp->buffer,"%d %d %d",
+	  (int)g_EvseController.RelayDC1Enabled(),
+	  (int)g_EvseController.RelayDC2Enabled(),
+	  (int)g_EvseController.RelayACEnabled());
+  rp->bufCnt = 1;
+  return 0;
+}
+
+int EvseRapiProcessor::rapiGS(EvseRapiProcessor *rp) // get state
+{
+  RAPI_GS_DATA d;
+  d.evseState = g_EvseController.GetState();
+  d.elapsedSec = (uint32_t)g_EvseController.GetElapsedChargeTime();
+  d.pilotState = g_EvseController.GetPilotState();
+  d.vFlags = g_EvseController.GetVFlags();
+#ifdef RAPI_BINARY
+  if (rp->binMode) return rp->binData(&d,sizeof(d));
 #endif
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+#ifdef RAPI_STREAM
+  rp->wrRespStart(1);
+  rp->wrHex(d.evseState,2);
+  rp->wrDec((int32_t)d.elapsedSec);
+  rp->wrHex(d.pilotState,2);
+  rp->wrHex(d.vFlags,4);
+  rp->wrRespEnd();
+#else
+  sprintf(rp->buffer,"%02x %ld %02x %04x",d.evseState,(long int)d.elapsedSec,d.pilotState,d.vFlags);
+  rp->bufCnt = 1; // flag response text output
+#endif // RAPI_STREAM
+  return 0;
+}
+
 #ifdef HAVE_RTC
-    case 'T': // get time
-      extern void GetRTC(char *buf);
-      GetRTC(buffer);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGT(EvseRapiProcessor *rp) // get time
+{
+  extern void GetRTC(char *buf);
+  GetRTC(rp->buffer);
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 #endif // HAVE_RTC
+
 #ifdef KWH_RECORDING
-    case 'U':
-      sprintf(buffer,"%lu %lu",g_EnergyMeter.GetSessionWs(),g_EnergyMeter.GetTotkWh());
-      bufCnt = 1;
-      rc = 0;
-      break;
+int EvseRapiProcessor::rapiGU(EvseRapiProcessor *rp) // get energy usage
+{
+  RAPI_GU_DATA d;
+  d.sessionWs = g_EnergyMeter.GetSessionWs();
+  d.totWh = g_EnergyMeter.GetTotkWh();
+#ifdef RAPI_BINARY
+  if (rp->binMode) return rp->binData(&d,sizeof(d));
+#endif
+#ifdef RAPI_STREAM
+  rp->wrRespStart(1);
+  rp->wrUDec(d.sessionWs);
+  rp->wrUDec(d.totWh);
+  rp->wrRespEnd();
+#else
+  sprintf(rp->buffer,"%lu %lu",(unsigned long)d.sessionWs,(unsigned long)d.totWh);
+  rp->bufCnt = 1;
+#endif // RAPI_STREAM
+  return 0;
+}
 #endif // KWH_RECORDING
-    case 'V': // get version
-      GetVerStr(buffer);
-      strcat(buffer," ");
-      strcat_P(buffer,RAPI_VER);
-      bufCnt = 1; // flag response text output
-      rc = 0;
-      break;
-	  
-#ifdef HEARTBEAT_SUPERVISION
-    case 'Y': // HEARTBEAT SUPERVISION
-	  sprintf(buffer,"%d %d %d", g_EvseController.GetHearbeatInterval(), g_EvseController.GetHearbeatCurrent(), g_EvseController.GetHearbeatTrigger());
-      bufCnt = 1;
-	  rc = 0;
-      break;
-#endif //HEARTBEAT_SUPERVISION
-#ifdef RELAY_ZC_SWITCH
-    case 'Z': // get AC frequency
-      sprintf(buffer,"%u", g_EvseController.GetAcFreqX100());
-      bufCnt = 1;
-      rc = 0;
-      break;
-#endif // RELAY_ZC_SWITCH
-
-    case 'R': // get relay enable status  $GR
-      sprintf(buffer,"%d %d %d",
-        (int)g_EvseController.RelayDC1Enabled(),
-        (int)g_EvseController.RelayDC2Enabled(),
-        (int)g_EvseController.RelayACEnabled());
-      bufCnt = 1;
-      rc = 0;
-      break;
-
-    }
-    break;
-
-#ifdef RAPI_T_COMMANDS
-  case 'T': // testing op
-    switch(*s) {
-#ifdef FAKE_CHARGING_CURRENT
-    case '0': // set fake charging current
-      if (tokenCnt == 2) {
-	g_EvseController.SetChargingCurrent(dtoi32(tokens[1])*1000);
-	g_OBD.SetAmmeterDirty(1);
-	g_OBD.Update(OBD_UPD_FORCE);
-	rc = 0;
-      }
-      break;
-#endif // FAKE_CHARGING_CURRENT
-    }
-    break;
-#endif //RAPI_T_COMMANDS
-#if defined(RELAY_PWM) && defined(RELAY_HOLD_DELAY_TUNING)
-  case 'Z': // reserved op
-    switch(*s) {
-    case '0': // set relayCloseMs
-      if (tokenCnt == 3) {
-	u1.u8 = dtoi32(tokens[1]);
-	u2.u8 = dtoi32(tokens[2]);
-	g_EvseController.setPwmPinParms(u1.u8,u2.u8);
-	sprintf(g_sTmp,"\nZ0 %u %u",(unsigned)u1.u8,(unsigned)u2.u8);
-	Serial.println(g_sTmp);
-	eeprom_write_byte((uint8_t*)EOFS_RELAY_CLOSE_MS,u1.u8);
-	eeprom_write_byte((uint8_t*)EOFS_RELAY_HOLD_PWM,u2.u8);
-      }
-      rc = 0;
-      break;
 
-    }
-    break;
-#endif // RELAY_HOLD_DELAY_TUNING
+int EvseRapiProcessor::rapiGV(EvseRapiProcessor *rp) // get version
+{
+  GetVerStr(rp->buffer);
+  strcat(rp->buffer," ");
+  strcat_P(rp->buffer,RAPI_VER);
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
 
-  default:
-    ; // do nothing
-  }
+#ifdef POWERMETER
+int EvseRapiProcessor::rapiGW(EvseRapiProcessor *rp) // get real poWer
+{
+  sprintf(rp->buffer,"%ld %u",(long)g_EvseController.GetRealPower(),(unsigned)g_EvseController.GetPowerFactor());
+  rp->bufCnt = 1; // flag response text output
+  return 0;
+}
+#endif // POWERMETER
 
-  if (bufCnt != -1){
-    response((rc == 0) ? 1 : 0);
-  }
+#ifdef RAPI_SNAPSHOT
+int EvseRapiProcessor::rapiGX(EvseRapiProcessor *rp) // get eXtended status snapshot
+{
+  rp->sendSnapshot();
+  rp->bufCnt = -1; // sendSnapshot() wrote the response
+  return 0;
+}
+#endif // RAPI_SNAPSHOT
 
-  reset();
+#ifdef HEARTBEAT_SUPERVISION
+int EvseRapiProcessor::rapiGY(EvseRapiProcessor *rp) // HEARTBEAT SUPERVISION
+{
+  sprintf(rp->buffer,"%d %d %d", g_EvseController.GetHearbeatInterval(), g_EvseController.GetHearbeatCurrent(), g_EvseController.GetHearbeatTrigger());
+  rp->bufCnt = 1;
+  return 0;
+}
+#endif //HEARTBEAT_SUPERVISION
 
-  g_inRapiCommand = 0;
+#ifdef RELAY_ZC_SWITCH
+int EvseRapiProcessor::rapiGZ(EvseRapiProcessor *rp) // get AC frequency
+{
+  sprintf(rp->buffer,"%u", g_EvseController.GetAcFreqX100());
+  rp->bufCnt = 1;
+  return 0;
+}
+#endif // RELAY_ZC_SWITCH
 
-  // command might have changed EVSE state
-  RapiSendEvseState();
+#if defined(RAPI_T_COMMANDS) && defined(FAKE_CHARGING_CURRENT)
+int EvseRapiProcessor::rapiT0(EvseRapiProcessor *rp) // set fake charging current
+{
+  g_EvseController.SetChargingCurrent(rp->args[1]*1000);
+  g_OBD.SetAmmeterDirty(1);
+  g_OBD.Update(OBD_UPD_FORCE);
+  return 0;
+}
+#endif // RAPI_T_COMMANDS && FAKE_CHARGING_CURRENT
 
-  return rc;
+#if defined(RELAY_PWM) && defined(RELAY_HOLD_DELAY_TUNING)
+int EvseRapiProcessor::rapiZ0(EvseRapiProcessor *rp) // set relayCloseMs
+{
+  uint8_t closems = rp->args[1];
+  uint8_t holdpwm = rp->args[2];
+  g_EvseController.setPwmPinParms(closems,holdpwm);
+  sprintf(g_sTmp,"\nZ0 %u %u",(unsigned)closems,(unsigned)holdpwm);
+  Serial.println(g_sTmp);
+  eeprom_write_byte((uint8_t*)EOFS_RELAY_CLOSE_MS,closems);
+  eeprom_write_byte((uint8_t*)EOFS_RELAY_HOLD_PWM,holdpwm);
+  return 0;
 }
+#endif // RELAY_PWM && RELAY_HOLD_DELAY_TUNING
 
 // append
 void EvseRapiProcessor::appendChk(char *buf)
@@ -968,8 +1665,80 @@ void EvseRapiProcessor::appendChk(char *buf)
 }
 
 
+#ifdef RAPI_STREAM
+void EvseRapiProcessor::wrChar(char c)
+{
+  wrChk ^= c;
+  write((uint8_t)c);
+}
+
+// a = 'a' or 'A'
+void EvseRapiProcessor::wrHexRaw(uint32_t u,uint8_t width,char a)
+{
+  char s[RAPI_FMT_HEX_LEN];
+  rapiFmtHex(s,u,width,a);
+  wrStr(s);
+}
+
+void EvseRapiProcessor::wrDecRaw(uint32_t u)
+{
+  char s[RAPI_FMT_DEC_LEN];
+  rapiFmtUDec(s,u);
+  wrStr(s);
+}
+
+void EvseRapiProcessor::wrDec(int32_t i)
+{
+  char s[RAPI_FMT_DEC_LEN];
+  rapiFmtDec(s,i);
+  wrChar(' ');
+  wrStr(s);
+}
+
+// $OK/$NK - follow w/ wrDec()/wrHex()/wrStr(), then wrRespEnd(). ASCII
+// only, handlers send binary framing payloads w/ binData()
+void EvseRapiProcessor::wrRespStart(uint8_t ok)
+{
+  writeStart();
+  wrChk = 0;
+  wrChar(ESRAPI_SOC);
+  wrChar(ok ? 'O' : 'N');
+  wrChar('K');
+}
+
+void EvseRapiProcessor::wrRespEnd()
+{
+  bufCnt = -1; // response already written
+  if (curReceivedSeqId != INVALID_SEQUENCE_ID) {
+    wrChar(' ');
+    wrChar(ESRAPI_SOS);
+    wrHexRaw(curReceivedSeqId,2,'A');
+  }
+  uint8_t chk = wrChk;
+  wrChar('^');
+  wrHexRaw(chk,2,'A');
+  wrChar(ESRAPI_EOC);
+  if (echo) write('\n');
+  writeEnd();
+}
+#endif // RAPI_STREAM
+
 void EvseRapiProcessor::response(uint8_t ok)
 {
+#ifdef RAPI_BINARY
+  if (binMode) {
+    binFrame(curReceivedSeqId,ok ? RAPIB_OK : RAPIB_NK,buffer,bufCnt ? strlen(buffer) : 0);
+    return;
+  }
+#endif // RAPI_BINARY
+#ifdef RAPI_STREAM
+  wrRespStart(ok);
+  if (bufCnt) {
+    wrChar(' ');
+    wrStr(buffer);
+  }
+  wrRespEnd();
+#else // !RAPI_STREAM
   writeStart();
 
   sprintf(g_sTmp,"%c%s",ESRAPI_SOC,ok ? "OK" : "NK");
@@ -985,6 +1754,7 @@ void EvseRapiProcessor::response(uint8_t ok)
   if (echo) write('\n');
 
   writeEnd();
+#endif // RAPI_STREAM
 }
 
 void EvseRapiProcessor::appendSequenceId(char *s,uint8_t seqId)
@@ -1166,6 +1936,7 @@ void RapiInit()
 
 void RapiDoCmd()
 {
+  LATENCY_PROBE(LAT_RAPI);
 #ifdef RAPI_SERIAL
   g_ESRP.doCmd();
 #endif
@@ -1184,6 +1955,10 @@ void RapiDoCmd()
 
   g_EIRP.doCmd();
 #endif // RAPI_I2C
+
+#ifdef RAPI_TELEMETRY
+  RapiSendTelemetry();
+#endif
 }
 
 // return: 0=sent 
@@ -1238,6 +2013,18 @@ void RapiSendBootNotification()
 #endif
 }
 
+#ifdef RAPI_TELEMETRY
+void RapiSendTelemetry()
+{
+#ifdef RAPI_SERIAL
+  g_ESRP.sendTelemetry();
+#endif
+#ifdef RAPI_I2C
+  g_EIRP.sendTelemetry();
+#endif
+}
+#endif // RAPI_TELEMETRY
+
 #ifdef RAPI_WF
 void RapiSetWifiMode(uint8_t mode)
 {
@@ -64,6 +64,35 @@ xk = 2-hex-digit checksum - 8-bit XOR of all characters before '^'
 ss = optional 2-hex-digit sequence ID which was sent with the command
      only present if a sequence ID was send with the command
 
+pipelining (v6.1.0+, only if RAPI_PIPELINE defined)
+up to RAPI_INQ_DEPTH whole commands are queued as they arrive, and processed
+one per loop in the order received. a client can send several commands w/o
+waiting for each $OK/$NK - give each a different sequence id to match the
+responses. further input stays in the serial receive buffer until there's
+a free slot. don't pipeline commands after $FF M - the mode switch drops
+whatever is queued or half received behind it
+
+binary framing (v6.1.0+, only if RAPI_BINARY defined)
+$FF M 1 switches to binary framing after its $OK, $FF M 0 (sent as a binary
+frame) switches back after its response. always ASCII after a reset.
+every message is COBS encoded and terminated by a 00 byte. decoded:
+ command: ss id [args] crc
+ response/async: ss st [text] crc
+ ss = sequence id, 00 = none. echoed in the response
+ id = command, family << 6 | char. family: F=0 S=1 G=2 T=3
+      char: 0-9 = 0-9, A-Z = 10-35. e.g. $GS = 0x80|28 = 0x9C
+ args = one per parameter, each either
+        'i' (69) + 4 byte little-endian int32 - handed to the command as
+          is, w/o a decimal round trip
+        's' (73) + length byte + chars
+ st = 00 OK, 01 NK, 02 asynchronous notification (text w/o '$')
+ text = same as the ASCII response text after "$OK ", except for $GS $GG
+        $GP $GU $GX, which return a packed little-endian payload instead.
+        see each command
+ crc = CRC-16/CCITT-FALSE (poly 1021, init FFFF) of all preceding bytes,
+       little-endian
+ $GS w/o sequence id: 00 9C 3A 5F, sent as 01 04 9C 3A 5F 00
+
 A-prefix: asynchronous notification messages
 
 Boot Notification
@@ -88,6 +117,14 @@ When the button is disabled ($FF B 0) send the event via RAPI
 $AN type
  type: 0 - short press, 1 - long press
 
+Telemetry (v6.1.0+) - only if RAPI_TELEMETRY defined. sent every periodms after $SU
+$AM mask value ...
+ mask(hex): fields present, see $SU
+ value(dec): one per bit set in mask, in bit order. temperatures are 3
+   values, ds3231temp mcp9808temp tmp007temp
+ w/ RAPI_BINARY framing on, the text is replaced by 'A' 'M' mask, then each
+   value as a 4 byte little-endian int32
+
 Request client WiFi mode - only if RAPI_WF defined
 $WF mode\r
  mode: WIFI_MODE_XXX
@@ -146,6 +183,7 @@ FF - enable/disable feature
   F = GFI self test
   G = Ground check
   L = boot Lock
+  M = binary framing Mode (v6.1.0+) - requires RAPI_BINARY. not saved
   O = overcurrent check
   P = PP auto ampacity
   R = stuck Relay check
@@ -201,6 +239,11 @@ SC amps [V|M]- set current capacity
      to EEPROM. subsequent calls the $SC cannot exceed value set bye $SC M
      the value cannot be changed/erased via RAPI commands. Subsequent calls
      to $SC M will return $NK
+SD state cnt - set state transition Debounce (v6.1.0+) - requires DEBOUNCE_SAMPLES
+ state: destination state 1=A 2=B 3=C 4=D 0=any other
+ cnt: consecutive pilot readings (1-255) that must agree before the EVSE
+   enters state. not saved - reverts to DEBOUNCE_CNT_x at boot
+ $SD 3 2^32
 SH kWh - set cHarge limit to kWh
  NOTES:
   - allowed only when EV connected in State B or C
@@ -219,6 +262,20 @@ SL 1|2|A  - set service level L1/L2/Auto
 SM voltscalefactor voltoffset - set voltMeter settings
 ST starthr startmin endhr endmin - set timer
  $ST 0 0 0 0^23 - cancel timer
+SU mask periodms - sUbscribe to telemetry (v6.1.0+) - requires RAPI_TELEMETRY
+ mask(hex): fields to send in $AM
+  01 = charging current, mA (see $GG)
+  02 = voltage, mV (see $GG)
+  04 = session Wattseconds (see $GU)
+  08 = total Wh (see $GU)
+  10 = temperatures (see $GP)
+  20 = elapsed charge time, sec (see $GS)
+ periodms(dec): how often to send $AM, 250-65535
+ mask or periodms 0 = unsubscribe. not saved
+ if there isn't room in the serial transmit buffer for an $AM, it is
+ skipped, and the period doubles, up to 8x, until one fits
+ $SU 3 1000^10
+ $SU 0 0^22 - unsubscribe
 SV mv - Set Voltage for power calculations to mv millivolts
  $SV 223576 - set voltage to 223.576
  NOTES:
@@ -274,6 +331,13 @@ GA - get ammeter settings
  response: $OK currentscalefactor currentoffset
  $GA^22
 
+GB - get Boot timing (v6.1.0+) - requires STAGED_POST
+ response: $OK postms readyms
+ postms: how long the last POST took, ms
+ readyms: millis() when the EVSE entered its first state after POST, i.e.
+   time from reset to ready. 0 = POST still running
+ $GB^21
+
 GC - get current capacity info
  response: $OK minamps hmaxamps pilotamps cmaxamps
  all values decimal
@@ -304,6 +368,8 @@ GF - get fault counters
 GG - get charging current and voltage
  response: $OK milliamps millivolts
  AMMETER must be defined in order to get amps, otherwise returns -1 amps
+ w/ RAPI_BINARY framing on, the text is replaced by RAPI_GG_DATA, packed
+ little-endian
  $GG^24
 
 GH - get cHarge limit
@@ -329,10 +395,48 @@ GI - get MCU ID - requires MCU_ID_LEN to be defined
    mcuid is 128-bit number
    returned as a 32-character hex string
 
+GK - get tasK stats (v6.1.0+) - requires TASK_SCHEDULER
+ $GK - response: $OK taskcnt [idlepct]
+   idlepct(dec): % of the last second spent asleep - requires IDLE_SLEEP
+    w/ AMMETER_BACKGROUND it includes the sampler ISR, which runs while
+    asleep
+ $GK taskidx - response: $OK runs misses overruns maxus (all values hex)
+ taskidx: position in the task table, 0 = highest priority. with all
+   features enabled: 0=EVSE 1=RAPI 2=button 3=LCD 4=temperature 5=delay timer
+ runs: number of times the task has run
+ misses: number of periodic runs started a full period late
+ overruns: number of runs that exceeded the task's budget
+ maxus: longest run in microseconds
+ counters saturate at ffff
+ $GK^28
+ $GK 0^38
+
+GL - get Latency stats (v6.1.0+) - requires LATENCY_STATS
+ $GL - response: $OK probecnt maxloopus wdtmarginms
+   probecnt(dec): number of latency probes
+   maxloopus(hex): longest loop() pass in microseconds
+   wdtmarginms(dec): watchdog time left at the end of the longest loop() pass
+     (-1 if WATCHDOG not defined)
+ $GL probe - response: $OK cnt maxus (all values hex)
+ $GL probe page - response: $OK n n+1 n+2 n+3 (all values hex)
+   page 0-3 returns log2 histogram buckets n = page*4 .. page*4+3
+   bucket n counts runs of 2^n..2^(n+1)-1 us, bucket 15 counts all >= 32768us
+ probe: 0=Update() 1=ReadPilot() 2=readAmmeter()/readPowerMeter()
+   3=ReadVoltmeter() 4=RapiDoCmd() 5=OnboardDisplay::Update() 6=TempMonitor::Read()
+   7=ISR event post to drain (ISR_EVENT_QUEUE)
+ $GL^2F
+ $GL 0^3F
+ $GL 0 0^2F
+
 GM - get voltMeter settings
  response: $OK voltcalefactor voltoffset
  $GM^2E
 
+GN state - get debouNce count (v6.1.0+) - requires DEBOUNCE_SAMPLES
+ response: $OK cnt
+ state, cnt: see $SD
+ $GN 3^3E
+
 GO get Overtemperature threshold
  response: $OK panicthresh
  panicthresh in 10ths of a degree Celsius
@@ -345,6 +449,8 @@ GP - get temPerature (v1.0.3+)
  tmp007temp - temperature from TMP007
  all temperatures are in 10th's of a degree Celcius
  if any temperature sensor is not installed, its return value is -2560
+ w/ RAPI_BINARY framing on, the text is replaced by RAPI_GP_DATA, packed
+ little-endian
  $GP^33
 
 GS - get state
@@ -353,6 +459,8 @@ GS - get state
  elapsed(dec): elapsed charge time in seconds of current or last charging session
  pilotstate(hex): EVSE_STATE_xxx
  vflags(hex): EVCF_xxx
+ w/ RAPI_BINARY framing on, the text is replaced by RAPI_GS_DATA, packed
+ little-endian
  $GS^30
 
 GT - get time (RTC)
@@ -363,6 +471,8 @@ GU - get energy usage (v1.0.3+)
  response: $OK Wattseconds Whacc
  Wattseconds - Watt-seconds used this charging session, note you'll divide Wattseconds by 3600 to get Wh
  Whacc - total Wh accumulated over all charging sessions, note you'll divide Wh by 1000 to get kWh
+ w/ RAPI_BINARY framing on, the text is replaced by RAPI_GU_DATA, packed
+ little-endian
  $GU^36
 
 GV - get version
@@ -376,6 +486,26 @@ T0 amps - set fake charging current
  response: $OK
  $T0 75
  
+GW - get real poWer (v6.1.0+, requires OPENEVSE_2 voltmeter and AMMETER)
+ response: $OK milliwatts pf
+ milliwatts(dec): real power measured over the last ammeter window
+ pf(dec): power factor * 1000
+ both are 0 when not charging
+ $GW^34
+
+GX - get eXtended status snapshot (v6.1.0+) - requires RAPI_SNAPSHOT
+ one command for what takes $GS $GG $GP $GU $GC otherwise
+ response: $OK ver evsestate pilotstate amps milliamps millivolts ds3231temp mcp9808temp tmp007temp Wattseconds Whacc elapsed vflags
+ ver(dec): layout version, currently 1. fields are only ever appended
+ evsestate, pilotstate, elapsed, vflags: see $GS
+ amps(dec): current capacity, see $GC
+ milliamps, millivolts: see $GG
+ ds3231temp mcp9808temp tmp007temp: see $GP, -2560 w/o TEMPERATURE_MONITORING
+ Wattseconds Whacc: see $GU, 0 w/o KWH_RECORDING
+ w/ RAPI_BINARY framing on, the text is replaced by RAPI_SNAPSHOT_DATA, packed
+ little-endian
+ $GX^3B
+
 GY - Get Hearbeat Supervision Status
  Response includes heartbeatinterval hearbeatcurrentlimit hearbeattrigger
  hearbeattrigger: 0 - There has never been a missed pulse,
@@ -403,7 +533,7 @@ Z0 closems holdpwm
 
 #ifdef RAPI
 
-#define RAPIVER "6.0.0"
+#define RAPIVER "6.1.0"
 
 #define WIFI_MODE_AP 0
 #define WIFI_MODE_CLIENT 1
@@ -415,7 +545,7 @@ Z0 closems holdpwm
 // MCU_ID_LEN is 16, so that is 2*16+1 = 33 bytes and the historic 32-byte
 // buffer overflowed by one, corrupting the adjacent bufCnt member. Size
 // per target so AVR RAM cost stays zero.
-#ifdef TARGET_SAMD
+#if defined(TARGET_SAMD) || defined(TARGET_HOST) // both have a 16-byte MCU id
 #define ESRAPI_BUFLEN 40
 #else
 #define ESRAPI_BUFLEN 32
@@ -433,7 +563,102 @@ Z0 closems holdpwm
 
 #define INVALID_SEQUENCE_ID 0
 
+#ifdef RAPI_TELEMETRY
+// $SU mask bits
+#define TLM_CURRENT    0x01
+#define TLM_VOLTAGE    0x02
+#define TLM_SESSION_WS 0x04
+#define TLM_TOT_WH     0x08
+#define TLM_TEMP       0x10
+#define TLM_ELAPSED    0x20
+#define TLM_ALL        0x3f
+#define TLM_MAX_VALUES 8
+#define RAPI_TELEM_MIN_MS 250
+#define RAPI_TELEM_MAX_BACKOFF 3 // period doubles up to 8x
+// ASCII $AM incl. framing
+#define RAPI_TELEM_BUFLEN 96
+#endif // RAPI_TELEMETRY
+
+#ifdef RAPI_SNAPSHOT
+#define RAPI_SNAPSHOT_VER 1
+// ASCII $GX response incl. framing. worst case "$OK" + 97 chars of
+// fields + " :ss^xk\r" + NUL = 109
+#define RAPI_SNAPSHOT_BUFLEN 112
+// $GX payload in binary framing mode. fixed layout for each
+// RAPI_SNAPSHOT_VER, new fields only ever go at the end
+typedef struct rapi_snapshot {
+  uint8_t ver;
+  uint8_t evseState;
+  uint8_t pilotState;
+  uint8_t currentCapacity; // A
+  int32_t chargingCurrent; // mA
+  int32_t voltage;         // mV
+  int16_t ds3231Temp;      // 0.1C
+  int16_t mcp9808Temp;
+  int16_t tmp007Temp;
+  uint32_t sessionWs;
+  uint32_t totWh;
+  uint32_t elapsedSec;
+  uint16_t vFlags;
+} __attribute__((packed)) RAPI_SNAPSHOT_DATA;
+#endif // RAPI_SNAPSHOT
+
+#ifdef RAPI_PIPELINE
+#define RAPI_INQ_DEPTH 3 // whole commands waiting to be processed
+#endif
+
+// RAPI_CMD() token counts (rapi_cmds.h), packed min << 4 | max
+#define RAPIC_ARITY(min,max) (((min) << 4) | (max))
+#define RAPIC_ANY 0xf
+// command keys: family * RAPIC_CHARS + char
+#define RAPIC_FAMILIES 5 // F S G T Z
+#define RAPIC_CHARS 36 // 0-9 A-Z
+#define RAPIC_NOKEY 0xff
+
+class EvseRapiProcessor;
+// returns 0 for $OK, else $NK
+typedef int (*RAPI_HANDLER)(EvseRapiProcessor *rp);
+
+#ifdef RAPI_BINARY
+// binary frame status byte
+#define RAPIB_OK    0
+#define RAPIB_NK    1
+#define RAPIB_ASYNC 2
+// binary frame argument tags
+#define RAPIB_ARG_INT 'i' // int32 little-endian
+#define RAPIB_ARG_STR 's' // length byte + chars
+#define RAPIB_REQ_NONE 0xff
+// longest frame received, still COBS encoded. 1 less than the buffer,
+// like an ASCII command, so the RAPI_PIPELINE queue can NUL terminate it
+#define RAPIB_FRAME_MAX (ESRAPI_BUFLEN - 1)
+
+// binary framing payloads of the polled getters, instead of their text.
+// fixed layouts, new fields only ever go at the end
+typedef struct rapi_gs_data {
+  uint8_t evseState;
+  uint32_t elapsedSec;
+  uint8_t pilotState;
+  uint16_t vFlags;
+} __attribute__((packed)) RAPI_GS_DATA;
+typedef struct rapi_gg_data {
+  int32_t chargingCurrent; // mA
+  int32_t voltage;         // mV
+} __attribute__((packed)) RAPI_GG_DATA;
+typedef struct rapi_gp_data {
+  int16_t ds3231Temp;      // 0.1C
+  int16_t mcp9808Temp;
+  int16_t tmp007Temp;
+} __attribute__((packed)) RAPI_GP_DATA;
+typedef struct rapi_gu_data {
+  uint32_t sessionWs;
+  uint32_t totWh;
+} __attribute__((packed)) RAPI_GU_DATA;
+#endif // RAPI_BINARY
+
 class EvseRapiProcessor {
+#ifdef TARGET_HOST
+  friend struct DispatchBench; // tests/bench calls dispatch()
+#endif
 #ifdef GPPBUGKLUDGE
   char *buffer;
 public:
@@ -444,10 +669,28 @@ private:
 #endif // GPPBUGKLUDGE
   int8_t bufCnt; // # valid bytes in buffer
   char *tokens[ESRAPI_MAX_ARGS];
+  int32_t args[ESRAPI_MAX_ARGS]; // tokens[] as numbers, args[0] unused
   int8_t tokenCnt;
   char echo;
   uint8_t curReceivedSeqId;
+#ifdef RAPI_PIPELINE
+  // received commands, oldest at inqHead. the one being received goes in
+  // the slot after the last whole one. w/ RAPI_BINARY, frames are stored
+  // still COBS encoded, so they have no 00 bytes
+  char inq[RAPI_INQ_DEPTH][ESRAPI_BUFLEN];
+  uint8_t inqHead;
+  uint8_t inqCnt; // # whole commands
+  int8_t inqPos; // # chars received into the next slot, -1 = discarding
+  uint8_t inqReceive();
+#endif // RAPI_PIPELINE
   void appendSequenceId(char *s,uint8_t seqId);
+#ifdef RAPI_BINARY
+  uint8_t binMode; // COBS/CRC-16 framing instead of ASCII
+  uint8_t binModeReq; // set by $FF M, applied after the response
+  int doBinCmd();
+  void binFrame(uint8_t seq,uint8_t status,const char *text,uint8_t len);
+  int binData(const void *data,uint8_t len);
+#endif // RAPI_BINARY
 #ifdef RAPI_SENDER
   uint8_t curSentSeqId;
   uint8_t getSendSequenceId();
@@ -469,9 +712,41 @@ private:
 
   int tokenize(char *buf);
   int processCmd();
+  int dispatch();
+
+  // command handlers, see rapi_cmds.h
+#define RAPI_CMD(fam,ch,min,max) static int rapi##fam##ch(EvseRapiProcessor *rp);
+#include "rapi_cmds.h"
+#undef RAPI_CMD
 
   void response(uint8_t ok);
   void appendChk(char *buf);
+#ifdef RAPI_STREAM
+  // response written straight to the port, w/ running checksum
+  uint8_t wrChk;
+  void wrChar(char c);
+  void wrStr(const char *s) { while (*s) wrChar(*(s++)); }
+  void wrHexRaw(uint32_t u,uint8_t width,char a);
+  void wrDecRaw(uint32_t u);
+  // ' ' then value
+  void wrDec(int32_t i);
+  void wrUDec(uint32_t u) { wrChar(' ');wrDecRaw(u); }
+  void wrHex(uint32_t u,uint8_t width=1) { wrChar(' ');wrHexRaw(u,width,'a'); }
+  void wrRespStart(uint8_t ok);
+  void wrRespEnd();
+#endif // RAPI_STREAM
+  void writeAsync(char *msg);
+#ifdef RAPI_SNAPSHOT
+  void sendSnapshot();
+#endif
+#ifdef RAPI_TELEMETRY
+  uint8_t telemMask; // TLM_xxx, 0 = not subscribed
+  uint8_t telemBackoff; // period is shifted left by this
+  uint16_t telemPeriodMs;
+  unsigned long telemLastMs;
+  // bytes that can be written w/o blocking
+  virtual int txAvailable() { return 0x7fff; }
+#endif // RAPI_TELEMETRY
   
 #ifdef RAPI_SENDER
   char sendbuf[RAPIS_BUFLEN]; // input buffer
@@ -486,6 +761,9 @@ public:
   void sendBootNotification();
   void setWifiMode(uint8_t mode); // WIFI_MODE_xxx
   void sendButtonPress(uint8_t long_press);
+#ifdef RAPI_TELEMETRY
+  void sendTelemetry();
+#endif
   void writeStr(const char *msg) { writeStart();write(msg);writeEnd(); }
 
   virtual void init();
@@ -502,6 +780,9 @@ class EvseSerialRapiProcessor : public EvseRapiProcessor {
   int read() { return RAPI_SERIAL_PORT.read(); }
   int write(uint8_t u8) { return RAPI_SERIAL_PORT.write(u8); }
   int write(const char *str) { return RAPI_SERIAL_PORT.write(str); }
+#ifdef RAPI_TELEMETRY
+  int txAvailable() { return RAPI_SERIAL_PORT.availableForWrite(); }
+#endif
 
 public:
   EvseSerialRapiProcessor();
@@ -535,5 +816,8 @@ uint8_t RapiSendEvseState(uint8_t force=0);
 void RapiSetWifiMode(uint8_t mode);
 void RapiSendButtonPress(uint8_t long_press);
 void RapiSendBootNotification();
+#ifdef RAPI_TELEMETRY
+void RapiSendTelemetry();
+#endif
 
 #endif // RAPI
@@ -0,0 +1,111 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+//
+// the subset of the Arduino API that open_evse uses, for the host build.
+// time is virtual and pins are simulated - see HostSim.h
+//
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define F_CPU 48000000UL
+
+// no separate program memory
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcat_P strcat
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define sprintf_P sprintf
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint32_t pin,uint32_t mode);
+void digitalWrite(uint32_t pin,uint32_t val);
+int digitalRead(uint32_t pin);
+int analogRead(uint32_t pin);
+void analogWrite(uint32_t pin,int val);
+void analogReadResolution(int bits);
+
+void noInterrupts();
+void interrupts();
+typedef void (*voidFuncPtr)();
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint32_t pin,voidFuncPtr isr,uint32_t mode);
+void detachInterrupt(uint32_t pin);
+
+#define DEC 10
+#define HEX 16
+
+// RAPI_SERIAL_PORT. TX goes to HostSim, RX comes from it
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  int available();
+  int availableForWrite();
+  int read();
+  size_t write(uint8_t c);
+  size_t write(const char *s);
+  void flush() {}
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(long n,int base=DEC);
+  size_t print(unsigned long n,int base=DEC);
+  size_t print(int n,int base=DEC) { return print((long)n,base); }
+  size_t print(unsigned n,int base=DEC) { return print((unsigned long)n,base); }
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+  template<typename T> size_t println(T v,int base) { size_t n = print(v,base); return n + println(); }
+};
+
+extern HardwareSerial Serial;
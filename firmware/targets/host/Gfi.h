@@ -0,0 +1,4 @@
+// -*- C++ -*-
+// the SAMD Gfi only uses the Arduino API and target.h, so the host build
+// shares it as is
+#include "../samd/Gfi.h"
@@ -0,0 +1,498 @@
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+HostSim g_Sim;
+HardwareSerial Serial;
+
+void HostSim::Reset()
+{
+  evState = 'A';
+  evDiode = 1;
+  pilotAdc = 0;
+  evMa = 0;
+  acLive = 1;
+  acHz = 60;
+  gndOk = 1;
+  relayWelded = 0;
+  relayStuckOpen = 0;
+  gfiLeak = 0;
+  gfiTestCt = 1;
+  ppAdc = 4095;
+  adcNoise = 0;
+  adcUs = HOST_ADC_US;
+  currentAdc = NULL;
+  tempSensor = 1;
+  tempC10 = 250;
+
+  nowUs = 0;
+  memset(pinOut,0,sizeof(pinOut));
+  memset(m_Irq,0,sizeof(m_Irq));
+  memset(m_Timer,0,sizeof(m_Timer));
+  pilotPwm = 0;
+  pilotDutyUs = 0;
+  wdtBites = 0;
+  m_WdtMs = 0;
+  m_WdtResetUs = 0;
+  m_IrqOff = 0;
+  m_InIsr = 0;
+  m_GfiTestEdges = 0;
+  m_GfiTestLastUs = 0;
+  m_Rand = 1;
+  m_Polling = 0;
+  m_NextUs = 0;
+  m_MainsUs = 0;
+  m_MainsHigh = 0;
+  memset(eeprom,0xff,sizeof(eeprom));
+  rx.clear();
+  tx.clear();
+  echo = 0;
+  deadlineUs = UINT64_MAX;
+  onDeadline = NULL;
+}
+
+// the zero crossings are at multiples of half a period. around each one
+// the CGMI opto output is HIGH for HOST_ZC_PULSE_US
+uint8_t HostSim::MainsHigh(uint64_t t)
+{
+  if (!acLive) return 0;
+  uint64_t halfns = 500000000ULL / acHz;
+  uint64_t pos = (t * 1000) % halfns;
+  uint64_t w = HOST_ZC_PULSE_US * 1000ULL / 2;
+  return (pos >= w) && (pos < (halfns - w));
+}
+
+uint64_t HostSim::nextMainsEdge(uint64_t t)
+{
+  if (!acLive) return UINT64_MAX;
+  uint64_t halfns = 500000000ULL / acHz;
+  uint64_t tns = t * 1000;
+  uint64_t base = tns - (tns % halfns);
+  uint64_t w = HOST_ZC_PULSE_US * 1000ULL / 2;
+  uint64_t e;
+  if ((tns - base) < w) e = base + w;
+  else if ((tns - base) < (halfns - w)) e = base + halfns - w;
+  else e = base + halfns + w;
+  return (e + 999) / 1000;
+}
+
+uint8_t HostSim::Level(uint32_t pin)
+{
+  switch(pin) {
+  case HOST_PIN_GFI:
+    return gfiLeak || (m_GfiTestEdges >= HOST_GFI_TRIP_EDGES);
+  case HOST_PIN_ACLINE1: // active low, relay output side
+    mainsNow();
+    return !(RelayClosed() && m_MainsHigh);
+  case HOST_PIN_ACLINE2: // active low, CGMI
+    mainsNow();
+    return !(gndOk && m_MainsHigh);
+  default:
+    return pin < HOST_PIN_CNT ? pinOut[pin] : 0;
+  }
+}
+
+uint16_t HostSim::noise(uint16_t v)
+{
+  if (!adcNoise) return v;
+  m_Rand = m_Rand * 1103515245 + 12345;
+  int32_t n = (int32_t)((m_Rand >> 16) % (2 * adcNoise + 1)) - adcNoise;
+  n += v;
+  if (n < 0) n = 0;
+  else if (n > 4095) n = 4095;
+  return n;
+}
+
+uint16_t HostSim::Adc(uint32_t pin)
+{
+  Touch();
+  uint16_t v;
+  switch(pin) {
+  case HOST_PIN_PILOT_SENSE:
+    {
+      uint8_t high;
+      if (pilotPwm) high = (nowUs % 1000) < pilotDutyUs;
+      else high = pinOut[HOST_PIN_PILOT];
+      if (pilotAdc && (high || !evDiode)) {
+        v = pilotAdc;
+      }
+      else if (high || ((evState != 'A') && !evDiode)) {
+        switch(evState) {
+        case 'B': v = HOST_PILOT_B; break;
+        case 'C': v = HOST_PILOT_C; break;
+        case 'D': v = HOST_PILOT_D; break;
+        default: v = HOST_PILOT_A;
+        }
+      }
+      else {
+        v = HOST_PILOT_N12;
+      }
+    }
+    break;
+  case HOST_PIN_CURRENT:
+    v = 2048;
+    if (currentAdc) {
+      v = currentAdc(nowUs);
+    }
+    else if (RelayClosed() && acLive && ((evState == 'C') || (evState == 'D')) &&
+        (evMa > (uint32_t)-DEFAULT_AMMETER_CURRENT_OFFSET)) {
+      // inverse of the default calibration
+      double rms = (double)(evMa + DEFAULT_AMMETER_CURRENT_OFFSET) / DEFAULT_CURRENT_SCALE_FACTOR;
+      double ph = 2 * M_PI * ((double)nowUs * acHz / 1000000.0);
+      double a = 2048 + rms * M_SQRT2 * sin(ph);
+      v = (a < 0) ? 0 : ((a > 4095) ? 4095 : (uint16_t)(a + 0.5));
+    }
+    break;
+  case HOST_PIN_PP:
+    v = ppAdc;
+    break;
+  default:
+    v = Level(pin) ? 4095 : 0;
+  }
+  return noise(v);
+}
+
+void HostSim::Write(uint32_t pin,uint8_t val)
+{
+  Touch();
+  m_NextUs = 0;
+  if (pin >= HOST_PIN_CNT) return;
+  if ((pin == HOST_PIN_GFITEST) && val && !pinOut[pin] && gfiTestCt) {
+    m_GfiTestEdges++;
+    m_GfiTestLastUs = nowUs;
+  }
+  pinOut[pin] = val;
+  pollIrqs();
+  dispatch();
+}
+
+void HostSim::Attach(uint32_t pin,voidFuncPtr isr,uint8_t mode)
+{
+  Touch();
+  m_NextUs = 0;
+  if (pin >= HOST_PIN_CNT) return;
+  m_Irq[pin].isr = isr;
+  m_Irq[pin].mode = mode;
+  m_Irq[pin].level = Level(pin);
+  m_Irq[pin].pending = 0;
+}
+
+void HostSim::IrqEnable(uint8_t on)
+{
+  Touch();
+  m_NextUs = 0;
+  if (on) {
+    if (m_IrqOff) m_IrqOff--;
+    dispatch();
+  }
+  else {
+    m_IrqOff++;
+  }
+}
+
+void HostSim::TimerStart(uint8_t id,uint32_t us,HostTimerFunc fn)
+{
+  Touch();
+  m_NextUs = 0;
+  m_Timer[id].dueUs = nowUs + us;
+  m_Timer[id].fn = fn;
+}
+
+HostTimerFunc HostSim::TimerCancel(uint8_t id)
+{
+  Touch();
+  m_NextUs = 0;
+  HostTimerFunc fn = m_Timer[id].fn;
+  m_Timer[id].fn = NULL;
+  return fn;
+}
+
+// latch pin change interrupts the way the EIC does - an edge that comes
+// and goes while interrupts are off still leaves one pending
+void HostSim::pollIrqs()
+{
+  if ((m_GfiTestEdges >= HOST_GFI_TRIP_EDGES) &&
+      ((nowUs - m_GfiTestLastUs) >= HOST_GFI_CLEAR_US) &&
+      !pinOut[HOST_PIN_GFITEST]) {
+    m_GfiTestEdges = 0;
+  }
+  for (uint8_t i=0;i < HOST_PIN_CNT;i++) {
+    Irq *irq = &m_Irq[i];
+    if (irq->isr) {
+      uint8_t level = Level(i);
+      if (level != irq->level) {
+        if ((irq->mode == CHANGE) ||
+            ((irq->mode == RISING) && level) ||
+            ((irq->mode == FALLING) && !level)) {
+          irq->pending = 1;
+        }
+        irq->level = level;
+      }
+    }
+  }
+}
+
+void HostSim::dispatch()
+{
+  if (m_IrqOff || m_InIsr) return;
+  m_InIsr = 1;
+  for (uint8_t i=0;i < HOST_TIMER_CNT;i++) {
+    Timer *t = &m_Timer[i];
+    if (t->fn && (t->dueUs <= nowUs)) {
+      HostTimerFunc fn = t->fn;
+      t->fn = NULL;
+      m_Polling = 0;
+      fn();
+    }
+  }
+  for (uint8_t i=0;i < HOST_PIN_CNT;i++) {
+    if (m_Irq[i].pending) {
+      m_Irq[i].pending = 0;
+      m_Polling = 0;
+      m_Irq[i].isr();
+    }
+  }
+  m_InIsr = 0;
+}
+
+uint64_t HostSim::nextEvent()
+{
+  uint64_t next = UINT64_MAX;
+  for (uint8_t i=0;i < HOST_TIMER_CNT;i++) {
+    if (m_Timer[i].fn && (m_Timer[i].dueUs < next)) next = m_Timer[i].dueUs;
+  }
+  if (m_Irq[HOST_PIN_ACLINE1].isr || m_Irq[HOST_PIN_ACLINE2].isr) {
+    mainsNow();
+    if (m_MainsUs < next) next = m_MainsUs;
+  }
+  if (m_GfiTestEdges >= HOST_GFI_TRIP_EDGES) {
+    uint64_t e = m_GfiTestLastUs + HOST_GFI_CLEAR_US;
+    if (e < next) next = e;
+  }
+  return next;
+}
+
+void HostSim::Advance(uint32_t us)
+{
+  uint64_t end = nowUs + us;
+  if (m_IrqOff || m_InIsr) {
+    // nothing can fire until interrupts are back on
+    nowUs = end;
+    m_NextUs = 0;
+  }
+  else if (end < m_NextUs) {
+    // nothing due, and no pin can have changed
+    nowUs = end;
+  }
+  else {
+    for (;;) {
+      uint64_t next = nextEvent();
+      if (next <= nowUs) next = nowUs;
+      if (next > end) break;
+      nowUs = next;
+      pollIrqs();
+      dispatch();
+      if (nextEvent() <= nowUs) {
+        // a handler left something due right now. move on 1us rather
+        // than spinning
+        if (nowUs == end) break;
+        nowUs++;
+      }
+    }
+    nowUs = end;
+    pollIrqs();
+    dispatch();
+    m_NextUs = nextEvent();
+  }
+
+  if (m_WdtMs && ((nowUs - m_WdtResetUs) > (m_WdtMs * 1000ULL))) {
+    wdtBites++;
+    m_WdtResetUs = nowUs;
+  }
+  if ((nowUs > deadlineUs) && onDeadline) {
+    deadlineUs = UINT64_MAX;
+    onDeadline();
+  }
+}
+
+uint32_t HostSim::Millis()
+{
+  if (m_Polling && !m_IrqOff && !m_InIsr) {
+    uint64_t t = (nowUs / 1000 + 1) * 1000;
+    // m_NextUs only has the mains edges when there's a pin change
+    // interrupt on them
+    uint64_t e = m_NextUs ? m_NextUs : nextEvent();
+    if (e < t) t = e;
+    mainsNow();
+    if (m_MainsUs < t) t = m_MainsUs;
+    Advance((t > nowUs) ? (uint32_t)(t - nowUs) : HOST_PIN_US);
+  }
+  else {
+    Advance(HOST_PIN_US);
+  }
+  m_Polling = 1;
+  return (uint32_t)(nowUs / 1000);
+}
+
+void HostSim::EepromRead(uintptr_t ofs,void *buf,uint8_t len)
+{
+  for (uint8_t i=0;i < len;i++) {
+    ((uint8_t *)buf)[i] = eeprom[(ofs + i) % HOST_EEPROM_SIZE];
+  }
+}
+
+void HostSim::EepromWrite(uintptr_t ofs,const void *buf,uint8_t len)
+{
+  Touch();
+  for (uint8_t i=0;i < len;i++) {
+    eeprom[(ofs + i) % HOST_EEPROM_SIZE] = ((const uint8_t *)buf)[i];
+  }
+}
+
+
+//
+// Arduino API
+//
+uint32_t millis()
+{
+  return g_Sim.Millis();
+}
+
+uint32_t micros()
+{
+  g_Sim.Advance(HOST_PIN_US);
+  return (uint32_t)g_Sim.nowUs;
+}
+
+void delay(uint32_t ms)
+{
+  g_Sim.Advance(ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  g_Sim.Advance(us);
+}
+
+void pinMode(uint32_t pin,uint32_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint32_t pin,uint32_t val)
+{
+  g_Sim.Write(pin,val ? HIGH : LOW);
+}
+
+int digitalRead(uint32_t pin)
+{
+  g_Sim.Advance(HOST_PIN_US);
+  return g_Sim.Level(pin);
+}
+
+int analogRead(uint32_t pin)
+{
+  g_Sim.Advance(g_Sim.adcUs);
+  return g_Sim.Adc(pin);
+}
+
+void analogWrite(uint32_t pin,int val)
+{
+  g_Sim.Write(pin,val ? HIGH : LOW);
+}
+
+void analogReadResolution(int bits)
+{
+  (void)bits;
+}
+
+void noInterrupts()
+{
+  g_Sim.IrqEnable(0);
+}
+
+void interrupts()
+{
+  g_Sim.IrqEnable(1);
+}
+
+void attachInterrupt(uint32_t pin,voidFuncPtr isr,uint32_t mode)
+{
+  g_Sim.Attach(pin,isr,mode);
+}
+
+void detachInterrupt(uint32_t pin)
+{
+  g_Sim.Attach(pin,NULL,0);
+}
+
+int HardwareSerial::available()
+{
+  return g_Sim.rx.size();
+}
+
+int HardwareSerial::availableForWrite()
+{
+  return 64;
+}
+
+int HardwareSerial::read()
+{
+  g_Sim.Touch();
+  if (g_Sim.rx.empty()) return -1;
+  uint8_t c = g_Sim.rx[0];
+  g_Sim.rx.erase(0,1);
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  g_Sim.Touch();
+  g_Sim.tx += (char)c;
+  if (g_Sim.echo) putchar(c);
+  return 1;
+}
+
+size_t HardwareSerial::write(const char *s)
+{
+  size_t n = 0;
+  while (*s) n += write((uint8_t)*(s++));
+  return n;
+}
+
+size_t HardwareSerial::print(long n,int base)
+{
+  char s[24];
+  if (base == HEX) snprintf(s,sizeof(s),"%lx",n);
+  else snprintf(s,sizeof(s),"%ld",n);
+  return write(s);
+}
+
+size_t HardwareSerial::print(unsigned long n,int base)
+{
+  char s[24];
+  if (base == HEX) snprintf(s,sizeof(s),"%lx",n);
+  else snprintf(s,sizeof(s),"%lu",n);
+  return write(s);
+}
@@ -0,0 +1,183 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+//
+// host build hardware model. everything the firmware sees through the
+// Arduino API and target.h comes from here: virtual time, pin levels,
+// ADC readings derived from the simulated EV/mains/relay, interrupts and
+// the serial port. tests set the inputs, run setup()/loop() and check
+// the outputs
+//
+#include <string>
+#include "Arduino.h"
+#include "pindefs.h"
+
+#define HOST_EEPROM_SIZE 1024
+
+// virtual time taken by each call (adcUs defaults to HOST_ADC_US).
+// analogRead() isn't a divisor of the 1ms pilot period, so PILOT_LOOP_CNT consecutive reads walk across the
+// whole PWM cycle like they do on real hardware
+#define HOST_ADC_US 217
+#define HOST_PIN_US 1
+
+// CGMI: the opto output is HIGH (no voltage) for this long around each
+// mains zero crossing
+#define HOST_ZC_PULSE_US 1000
+
+// the GFI CT trips after this many self test pulses, and the GFI pin
+// drops again this long after the pulses stop
+#define HOST_GFI_TRIP_EDGES 5
+#define HOST_GFI_CLEAR_US 20000UL
+
+// pilot high side ADC reading per EV state, and the low side at -12V
+#define HOST_PILOT_A 4050
+#define HOST_PILOT_B 3740
+#define HOST_PILOT_C 3400
+#define HOST_PILOT_D 3000
+#define HOST_PILOT_N12 100
+
+typedef void (*HostTimerFunc)();
+enum { HOST_TIMER_RELAY,HOST_TIMER_GFI,HOST_TIMER_CNT };
+
+class HostSim {
+  struct Irq {
+    voidFuncPtr isr;
+    uint8_t mode;
+    uint8_t level;
+    uint8_t pending;
+  } m_Irq[HOST_PIN_CNT];
+  struct Timer {
+    uint64_t dueUs;
+    HostTimerFunc fn;
+  } m_Timer[HOST_TIMER_CNT];
+  uint8_t m_IrqOff;
+  uint8_t m_InIsr;
+  uint64_t m_WdtResetUs;
+  uint32_t m_WdtMs;
+  uint16_t m_GfiTestEdges;
+  uint64_t m_GfiTestLastUs;
+  uint32_t m_Rand;
+  uint8_t m_Polling; // only pins read since the last millis()
+  // nextEvent() as of the last Advance(). 0 = something changed since,
+  // Advance() has to poll the pins
+  uint64_t m_NextUs;
+  // MainsHigh(nowUs), good until the next mains edge at m_MainsUs.
+  // 0 = recalculate
+  uint64_t m_MainsUs;
+  uint8_t m_MainsHigh;
+
+  uint64_t nextMainsEdge(uint64_t t);
+  void mainsNow() {
+    if (nowUs >= m_MainsUs) {
+      m_MainsHigh = MainsHigh(nowUs);
+      m_MainsUs = nextMainsEdge(nowUs);
+    }
+  }
+  uint64_t nextEvent();
+  void pollIrqs();
+  void dispatch();
+  uint16_t noise(uint16_t v);
+public:
+  //
+  // inputs - set by the test
+  //
+  char evState;         // 'A'..'D': what the EV presents on the pilot
+  uint8_t evDiode;      // 0 = EV diode shorted
+  uint16_t pilotAdc;    // !0 = high side of the pilot reads this, not evState
+  uint32_t evMa;        // current the EV draws in state C/D w/ power on
+  uint8_t acLive;       // mains present
+  uint16_t acHz;
+  uint8_t gndOk;        // 0 = open ground
+  uint8_t relayWelded;  // relay contacts stuck closed
+  uint8_t relayStuckOpen; // relay never closes
+  uint8_t gfiLeak;      // ground fault current present
+  uint8_t gfiTestCt;    // 0 = the self test winding doesn't trip the GFI
+  uint16_t ppAdc;       // proximity pilot reading
+  uint16_t adcNoise;    // +/- counts of noise on every ADC reading
+  uint16_t adcUs;       // virtual time each analogRead() takes
+  // !NULL = CURRENT_PIN reads this at nowUs, whatever the EV and relay do,
+  // e.g. a benchmark's waveform
+  uint16_t (*currentAdc)(uint64_t us);
+  uint8_t tempSensor;   // MCP9808 present
+  int16_t tempC10;      // ambient temperature in 0.1C
+
+  //
+  // state
+  //
+  uint64_t nowUs;
+  uint8_t pinOut[HOST_PIN_CNT];
+  uint8_t pilotPwm;     // pilot is driving PWM at pilotDutyUs/1000
+  uint16_t pilotDutyUs;
+  uint32_t wdtBites;    // watchdog timeouts
+  uint8_t eeprom[HOST_EEPROM_SIZE];
+  std::string rx;       // bytes waiting to be read from RAPI_SERIAL_PORT
+  std::string tx;       // bytes written to RAPI_SERIAL_PORT
+  uint8_t echo;         // also copy tx to stdout
+  // called from Advance() once virtual time passes deadlineUs, so a test
+  // can bail out of firmware code that never returns
+  uint64_t deadlineUs;
+  void (*onDeadline)();
+
+  HostSim() { Reset(); }
+  // power on: default inputs, outputs low, time 0, blank EEPROM
+  void Reset();
+  // moves virtual time forward, firing any timer/pin interrupts
+  // that come due on the way
+  void Advance(uint32_t us);
+  // call after changing inputs that drive interrupt pins
+  void InputsChanged() { Touch(); m_NextUs = 0; m_MainsUs = 0; Advance(0); }
+  // millis(). a loop that does nothing but read pins and millis() can't
+  // see anything new until the next ms or pin change, so skip to there
+  uint32_t Millis();
+  // anything but a pin read or millis() ends a poll loop
+  void Touch() { m_Polling = 0; }
+
+  uint8_t Level(uint32_t pin);
+  uint16_t Adc(uint32_t pin);
+  uint8_t RelayDriven() {
+    return pinOut[HOST_PIN_CHARGING] || pinOut[HOST_PIN_CHARGING2] ||
+      pinOut[HOST_PIN_CHARGINGAC];
+  }
+  uint8_t RelayClosed() {
+    return !relayStuckOpen && (relayWelded || RelayDriven());
+  }
+  uint8_t MainsHigh(uint64_t t);
+
+  void Write(uint32_t pin,uint8_t val);
+  void Attach(uint32_t pin,voidFuncPtr isr,uint8_t mode);
+  void IrqEnable(uint8_t on);
+  void TimerStart(uint8_t id,uint32_t us,HostTimerFunc fn);
+  HostTimerFunc TimerCancel(uint8_t id);
+  uint8_t TimerBusy(uint8_t id) { return m_Timer[id].fn != NULL; }
+
+  void WdtEnable(uint32_t ms) { m_WdtMs = ms; m_WdtResetUs = nowUs; }
+  void WdtReset() { m_WdtResetUs = nowUs; }
+  uint32_t WdtMs() { return m_WdtMs; } // 0 = disabled
+
+  void EepromRead(uintptr_t ofs,void *buf,uint8_t len);
+  void EepromWrite(uintptr_t ofs,const void *buf,uint8_t len);
+};
+
+extern HostSim g_Sim;
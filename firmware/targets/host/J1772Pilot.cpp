@@ -0,0 +1,65 @@
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+void J1772Pilot::Init()
+{
+  pinMode(PILOT_REG,OUTPUT);
+  SetState(PILOT_STATE_P12); // turns the pilot on 12V steady state
+}
+
+
+// no PWM pilot signal - steady state
+// PILOT_STATE_P12 = steady +12V (EVSE_STATE_A - VEHICLE NOT CONNECTED)
+// PILOT_STATE_N12 = steady -12V (EVSE_STATE_F - FAULT) 
+void J1772Pilot::SetState(PILOT_STATE state)
+{
+  g_Sim.pilotPwm = 0;
+  digitalWrite(PILOT_REG,(state == PILOT_STATE_P12) ? HIGH : LOW);
+
+  m_State = state;
+}
+
+//
+// set EVSE current capacity in Amperes
+// same duty cycles as SAMD: compare/48 = us high per 1ms
+//
+int J1772Pilot::SetPWM(int amps)
+{
+  uint32_t compare;
+  if ((amps >= 6) && (amps <= 51)) {
+    compare = (uint32_t)amps * 800u;
+  } else if ((amps > 51) && (amps <= 80)) {
+    compare = 30720u + ((uint32_t)amps * 192u);
+  }
+  else {
+    return 1;
+  }
+
+  g_Sim.pilotDutyUs = compare / 48;
+  g_Sim.pilotPwm = 1;
+
+  m_State = PILOT_STATE_PWM;
+
+  return 0;
+}
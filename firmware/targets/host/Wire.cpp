@@ -0,0 +1,65 @@
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+TwoWire Wire;
+
+size_t TwoWire::write(uint8_t c)
+{
+  if (m_TxAddr == MCP9808_ADDRESS) m_Reg = c;
+  return 1;
+}
+
+size_t TwoWire::write(const char *s)
+{
+  size_t n = 0;
+  while (*s) n += write((uint8_t)*(s++));
+  return n;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr,uint8_t cnt)
+{
+  m_RxCnt = 0;
+  m_RxPos = 0;
+  if ((addr != MCP9808_ADDRESS) || (cnt != 2) || !g_Sim.tempSensor) return 0;
+
+  uint16_t val;
+  switch (m_Reg) {
+  case MCP9808_REG_MANUF_ID:
+    val = 0x0054;
+    break;
+  case MCP9808_REG_DEVICE_ID:
+    val = 0x0400;
+    break;
+  case MCP9808_REG_AMBIENT_TEMP:
+    // 13-bit two's complement, 1/16 C
+    val = (uint16_t)(((int32_t)g_Sim.tempC10 * 16) / 10) & 0x1fff;
+    break;
+  default:
+    val = 0;
+  }
+  m_RxBuf[0] = val >> 8;
+  m_RxBuf[1] = val & 0xff;
+  m_RxCnt = 2;
+  return 2;
+}
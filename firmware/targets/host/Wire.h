@@ -0,0 +1,51 @@
+// -*- C++ -*-
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// I2C bus of the host build. the only device on it is a simulated MCP9808
+// reporting HostSim::tempC10; reads from any other address come back empty
+class TwoWire {
+  uint8_t m_TxAddr;
+  uint8_t m_Reg;
+  uint8_t m_RxBuf[2];
+  uint8_t m_RxCnt;
+  uint8_t m_RxPos;
+public:
+  TwoWire() : m_TxAddr(0),m_Reg(0),m_RxCnt(0),m_RxPos(0) {}
+  void begin() {}
+  void begin(uint8_t addr) { (void)addr; }
+  void onReceive(void (*fn)(int)) { (void)fn; }
+  void beginTransmission(uint8_t addr) { m_TxAddr = addr; }
+  size_t write(uint8_t c);
+  size_t write(const char *s);
+  uint8_t endTransmission() { return 0; }
+  uint8_t requestFrom(uint8_t addr,uint8_t cnt);
+  int available() { return m_RxCnt - m_RxPos; }
+  int read() { return (m_RxPos < m_RxCnt) ? m_RxBuf[m_RxPos++] : -1; }
+};
+
+extern TwoWire Wire;
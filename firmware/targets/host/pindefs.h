@@ -0,0 +1,80 @@
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+// host build pins - plain indices into HostSim's pin table. the pin set is
+// the SAMD one (OpenEVSE NXT), so the same features are built
+enum {
+  HOST_PIN_GFI,
+  HOST_PIN_GFITEST,
+  HOST_PIN_PILOT,
+  HOST_PIN_CURRENT,
+  HOST_PIN_PILOT_SENSE,
+  HOST_PIN_PP,
+  HOST_PIN_ACLINE1,
+  HOST_PIN_ACLINE2,
+  HOST_PIN_CHARGING,
+  HOST_PIN_CHARGING2,
+  HOST_PIN_CHARGINGAC,
+  HOST_PIN_MENNEKES_A,
+  HOST_PIN_MENNEKES_B,
+  HOST_PIN_CNT
+};
+
+#define GFI_REG HOST_PIN_GFI
+#define GFITEST_REG HOST_PIN_GFITEST
+
+#define PILOT_REG HOST_PIN_PILOT
+
+// analog pins
+#define CURRENT_PIN     HOST_PIN_CURRENT
+#define PILOT_SENSE_PIN HOST_PIN_PILOT_SENSE
+#define PP_PIN          HOST_PIN_PP
+
+#define ACLINE1_REG HOST_PIN_ACLINE1 // WELD_DETECT
+#define ACLINE2_REG HOST_PIN_ACLINE2 // GMI_LINE
+
+#define CHARGING_REG   HOST_PIN_CHARGING
+#define CHARGING2_REG  HOST_PIN_CHARGING2
+#define CHARGINGAC_REG HOST_PIN_CHARGINGAC
+
+#define MENNEKES_LOCK_PINA_REG HOST_PIN_MENNEKES_A
+#define MENNEKES_LOCK_PINB_REG HOST_PIN_MENNEKES_B
+
+#ifdef RELAY_ZC_SWITCH
+#define GMI_ADC_PIN ACLINE2_REG
+#endif
+
+// dummies - unused
+#define PILOT_IDX 0
+#define CHARGING_IDX 0
+#define CHARGING2_IDX 0
+#define CHARGINGAC_IDX 0
+#define ACLINE1_IDX 0
+#define ACLINE2_IDX 0
+
+#define GFI_IDX 0
+#define GFITEST_IDX 0
+
+#define MENNEKES_LOCK_PINA_IDX 0
+#define MENNEKES_LOCK_PINB_IDX 0
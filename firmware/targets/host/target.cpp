@@ -0,0 +1,125 @@
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include "open_evse.h"
+
+THRESH_DATA J1772EVSEController::m_ThreshData = {
+  PILOT_THRESH_AB,PILOT_THRESH_BC,PILOT_THRESH_CD,PILOT_THRESH_D,PILOT_THRESH_DS
+};
+
+void getMcuId(uint8_t *mcuid)
+{
+  for (uint8_t i=0;i < MCU_ID_LEN;i++) {
+    mcuid[i] = 0xa0 + i;
+  }
+}
+
+void DigitalPin::init(uint32_t pinnum,int idxjunk,PinMode mode)
+{
+  (void)idxjunk;
+  _pinNum = pinnum;
+  pinMode(_pinNum,(mode == INP) ? INPUT : ((mode == INP_PU) ? INPUT_PULLUP : OUTPUT));
+}
+
+HOST_TARGET_STATE g_HostTarget;
+
+#ifdef ZC_TRACKER
+// same as the m328p CGMI pin change handler: ACLINE2 is HIGH while the
+// mains voltage is below the opto threshold, so the crossing is the middle
+// of the HIGH pulse
+static void zcIsr()
+{
+  uint32_t us = micros();
+  if (digitalRead(ACLINE2_REG)) {
+    g_HostTarget.zcRiseUs = us;
+  }
+  else if (g_HostTarget.zcRiseUs) {
+    g_ZcTracker.Crossing(g_HostTarget.zcRiseUs + (us - g_HostTarget.zcRiseUs) / 2);
+  }
+}
+
+void zcTrackerBegin()
+{
+  g_HostTarget.zcRiseUs = 0;
+  attachInterrupt(digitalPinToInterrupt(ACLINE2_REG),zcIsr,CHANGE);
+}
+
+void relayTimerStart(uint32_t us,RelayTimerFunc fn)
+{
+  g_Sim.TimerStart(HOST_TIMER_RELAY,us,fn);
+}
+
+RelayTimerFunc relayTimerCancel()
+{
+  return g_Sim.TimerCancel(HOST_TIMER_RELAY);
+}
+#endif // ZC_TRACKER
+
+#ifdef GFI_TEST_TIMER
+
+static void gfiPulseIsr()
+{
+  g_HostTarget.gfiPulseLevel = !g_HostTarget.gfiPulseLevel;
+  g_HostTarget.gfiPulsePin->write(g_HostTarget.gfiPulseLevel);
+  if (--g_HostTarget.gfiPulseEdges) {
+    g_Sim.TimerStart(HOST_TIMER_GFI,g_HostTarget.gfiPulseHalfUs,gfiPulseIsr);
+  }
+}
+
+void gfiPulseStart(DigitalPin *pin,uint16_t halfus,uint16_t cycles)
+{
+  gfiPulseStop();
+  if (!cycles) return;
+  g_HostTarget.gfiPulsePin = pin;
+  g_HostTarget.gfiPulseHalfUs = halfus;
+  g_HostTarget.gfiPulseEdges = cycles * 2 - 1;
+  g_HostTarget.gfiPulseLevel = 1;
+  pin->write(1);
+  g_Sim.TimerStart(HOST_TIMER_GFI,halfus,gfiPulseIsr);
+}
+
+void gfiPulseStop()
+{
+  g_Sim.TimerCancel(HOST_TIMER_GFI);
+  g_HostTarget.gfiPulseEdges = 0;
+  if (g_HostTarget.gfiPulsePin) g_HostTarget.gfiPulsePin->write(0);
+}
+
+uint8_t gfiPulseBusy()
+{
+  return g_HostTarget.gfiPulseEdges ? 1 : 0;
+}
+#endif // GFI_TEST_TIMER
+
+#ifdef IDLE_SLEEP
+void idleSleep()
+{
+  g_Sim.Advance(1000 - (g_Sim.nowUs % 1000));
+}
+#endif // IDLE_SLEEP
+
+void initTarget()
+{
+  g_hasCGMI = true;
+
+  Wire.begin();
+}
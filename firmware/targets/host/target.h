@@ -0,0 +1,188 @@
+/*
+ * Open EVSE Firmware
+ *
+ * Copyright (c) 2013-2021 Sam C. Lin <lincomatic@gmail.com>
+ *
+ * This file is part of Open EVSE.
+
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#pragma once
+
+#include "HostSim.h"
+
+// enable $GI
+#define MCU_ID_LEN 16
+
+// same ADC and pilot scaling as SAMD, so the thresholds and calibration
+// defaults carry over
+#define ADC_RESOLUTION_BITS 12
+#define ADC_MAX 4095
+#define ADC_HALF 2048
+
+// pilot phigh/plow ADC thresholds for m_ThreshData
+#define PILOT_THRESH_AB 3948 // state A -> B
+#define PILOT_THRESH_BC 3539 // state B -> C
+#define PILOT_THRESH_CD 3258 // state C -> D
+#define PILOT_THRESH_D  0    // state D
+#define PILOT_THRESH_DS 492  // diode short
+
+#define DEFAULT_CURRENT_SCALE_FACTOR    37
+#define DEFAULT_AMMETER_CURRENT_OFFSET -135
+
+
+// for J1772.ReadPilot()
+// 15 = ~3ms w/ HOST_ADC_US
+#define PILOT_LOOP_CNT 15
+
+
+#define GetVerStr(s) strcpy(s,VERSION)
+
+#ifdef WATCHDOG
+// HostSim counts a bite whenever WATCHDOG_TIMEOUT_SEC of virtual time go by
+// w/o a reset
+inline void wdt_enable(int sec) { g_Sim.WdtEnable(sec * 1000UL); }
+inline void wdt_disable() { g_Sim.WdtEnable(0); }
+inline void wdt_reset() { g_Sim.WdtReset(); }
+
+#define WDT_RESET() wdt_reset()
+#define WDT_ENABLE() wdt_enable(2)
+#define WDT_ENABLE_1S() wdt_enable(1)
+#define WDT_DISABLE() wdt_disable()
+#else
+#define WDT_RESET()
+#define WDT_ENABLE()
+#define WDT_ENABLE_1S()
+#define WDT_DISABLE()
+#define wdt_reset()
+#define wdt_enable(sec)
+#define wdt_disable()
+#endif // WATCHDOG
+
+class DigitalPin {
+  uint32_t _pinNum;
+
+public:
+  enum PinMode { INP,INP_PU,OUT };
+
+  DigitalPin() {}
+  DigitalPin(uint32_t pinnum,int idxjunk,PinMode mode) {
+    init(pinnum,idxjunk,mode);
+  }
+
+  void init(uint32_t pinnum,int idxjunk,PinMode mode);
+  void mode(PinMode mode);
+
+  uint8_t read() {
+    return digitalRead(_pinNum) ? 1 : 0;
+  }
+  void write(uint32_t state) {
+    digitalWrite(_pinNum,state ? HIGH : LOW);
+  }
+};
+
+#if defined(AMMETER_BACKGROUND) || defined(PILOT_ADC_TRIGGER)
+#error AMMETER_BACKGROUND and PILOT_ADC_TRIGGER are not simulated on the host
+#endif
+
+class AdcPin {
+  uint32_t _pinNum;
+public:
+
+  AdcPin() {}
+  AdcPin(uint32_t pinnum) {
+    init(pinnum);
+  }
+
+  void init(uint32_t pinnum) {
+    _pinNum = pinnum;
+    analogReadResolution(ADC_RESOLUTION_BITS);
+  }
+
+  uint32_t read() {
+    return analogRead(_pinNum);
+  }
+};
+
+#ifdef ZC_TRACKER
+// feed g_ZcTracker from a CHANGE interrupt on the simulated GMI line
+void zcTrackerBegin();
+
+// one shot virtual time timer to switch the relay at a predicted zero
+// crossing, like the SAMD TC4 one. fn runs in (simulated) ISR context
+#define RELAY_TIMER
+typedef void (*RelayTimerFunc)();
+void relayTimerStart(uint32_t us,RelayTimerFunc fn);
+RelayTimerFunc relayTimerCancel();
+#elif defined(RELAY_ZC_SWITCH)
+#error RELAY_ZC_SWITCH needs ZC_TRACKER on the host
+#endif // ZC_TRACKER
+
+#ifdef GFI_TEST_TIMER
+// GFI self test pulse train: cycles square wave periods of 2*halfus,
+// starting HIGH, written to pin from virtual time timer events
+void gfiPulseStart(DigitalPin *pin,uint16_t halfus,uint16_t cycles);
+void gfiPulseStop(); // safe to call from gfi_isr
+uint8_t gfiPulseBusy();
+#endif // GFI_TEST_TIMER
+
+// the target layer's ISR state. in one place so tests can save and
+// restore it along w/ the firmware globals
+struct HOST_TARGET_STATE {
+#ifdef ZC_TRACKER
+  uint32_t zcRiseUs; // start of the current CGMI pulse, 0 = none yet
+#endif
+#ifdef GFI_TEST_TIMER
+  DigitalPin *gfiPulsePin;
+  uint16_t gfiPulseHalfUs;
+  uint16_t gfiPulseEdges; // left to write
+  uint8_t gfiPulseLevel;
+#endif
+};
+extern HOST_TARGET_STATE g_HostTarget;
+
+#ifdef IDLE_SLEEP
+// skip virtual time ahead to the next ms tick
+void idleSleep();
+#endif // IDLE_SLEEP
+
+void getMcuId(uint8_t *mcuid);
+
+inline uint8_t eeprom_read_byte(const uint8_t *ofs) {
+  return g_Sim.eeprom[(uintptr_t)ofs % HOST_EEPROM_SIZE];
+}
+inline uint16_t eeprom_read_word(const uint16_t *ofs) {
+  uint16_t ret;
+  g_Sim.EepromRead((uintptr_t)ofs,&ret,sizeof(ret));
+  return ret;
+}
+inline uint32_t eeprom_read_dword(const uint32_t *ofs) {
+  uint32_t ret;
+  g_Sim.EepromRead((uintptr_t)ofs,&ret,sizeof(ret));
+  return ret;
+}
+inline void eeprom_write_byte(uint8_t *ofs,uint8_t val) {
+  g_Sim.EepromWrite((uintptr_t)ofs,&val,sizeof(val));
+}
+inline void eeprom_write_word(uint16_t *ofs,uint16_t val) {
+  g_Sim.EepromWrite((uintptr_t)ofs,&val,sizeof(val));
+}
+inline void eeprom_write_dword(uint32_t *ofs,uint32_t val) {
+  g_Sim.EepromWrite((uintptr_t)ofs,&val,sizeof(val));
+}
+
+
+void initTarget();
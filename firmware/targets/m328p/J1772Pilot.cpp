@@ -23,6 +23,151 @@
 
 #define TOP ((F_CPU / 2000000) * 1000) // for 1KHz (=1000us period)
 
+#ifdef PILOT_ADC_TRIGGER
+// In phase & frequency correct mode Timer1 counts up to TOP and back down,
+// and the pilot is high while TCNT1 < OCR1x.  So BOTTOM (TOV1) is always the
+// middle of the high plateau, and TOP (ICF1, since ICR1 = TOP) is always the
+// middle of the low plateau, whatever the duty cycle.  The ADC is
+// auto-triggered alternately from each, so we get exactly one sample of each
+// plateau per 1KHz period, and ReadPilot() doesn't have to hunt for them.
+//
+// n.b. an auto trigger fires only on a rising edge of its flag, so the ISR
+// clears TOV1/ICF1 before arming the other source.
+//
+// With AMMETER_BACKGROUND, the ISR also starts a conversion of CURRENT_PIN
+// by hand after each plateau sample, and feeds it to s_AmmeterAccum (see
+// AdcSampler.h), so readAmmeter() doesn't block.  That's one current sample
+// per plateau trigger, every AMMETER_TICK_US.  It's done ~110us later, long
+// before the next trigger, and the ISR switches ADMUX back to the pilot.
+#define PS_ADTS_BOTTOM (_BV(ADTS2) | _BV(ADTS1)) // Timer1 overflow
+#define PS_ADTS_TOP (_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0)) // Timer1 capture
+#define PS_HIGH_VALID 0x01
+#define PS_LOW_VALID 0x02
+
+static uint8_t s_psAdmux;
+static volatile uint16_t s_psHigh;
+static volatile uint16_t s_psLow;
+static volatile uint8_t s_psValid;
+
+#ifdef AMMETER_BACKGROUND
+#include "AdcSampler.h"
+
+#define AMS_ZERO_DEBOUNCE_TICKS ((CURRENT_ZERO_DEBOUNCE_INTERVAL * 1000UL) / AMMETER_TICK_US)
+#define AMS_TIMEOUT_TICKS ((CURRENT_SAMPLE_INTERVAL * 1000UL) / AMMETER_TICK_US)
+#define AMS_MAX_SKIP_TICKS (1000UL / AMMETER_TICK_US) // 1ms, ~5% of a cycle
+
+static uint8_t s_amsAdmux;
+static volatile uint8_t s_amsOnCurrent; // the conversion in flight is ours
+static uint32_t s_amsTickUs; // micros() of the last tick counted
+// touched only by the ISR, or by the foreground w/ interrupts off
+static AmmeterAccum s_AmmeterAccum;
+#endif // AMMETER_BACKGROUND
+
+ISR(ADC_vect)
+{
+  uint16_t val = ADC;
+#ifdef AMMETER_BACKGROUND
+  if (s_amsOnCurrent) {
+    s_amsOnCurrent = 0;
+    ADMUX = s_psAdmux;
+    s_AmmeterAccum.Sample(val);
+    return;
+  }
+#endif // AMMETER_BACKGROUND
+  TIFR1 = _BV(TOV1) | _BV(ICF1);
+  if (ADCSRB == PS_ADTS_BOTTOM) {
+    s_psHigh = val;
+    s_psValid |= PS_HIGH_VALID;
+    ADCSRB = PS_ADTS_TOP;
+  }
+  else {
+    s_psLow = val;
+    s_psValid |= PS_LOW_VALID;
+    ADCSRB = PS_ADTS_BOTTOM;
+  }
+#ifdef AMMETER_BACKGROUND
+  s_amsTickUs += AMMETER_TICK_US;
+  s_AmmeterAccum.Tick(1);
+  ADMUX = s_amsAdmux;
+  s_amsOnCurrent = 1;
+  ADCSRA |= _BV(ADSC);
+#endif // AMMETER_BACKGROUND
+}
+
+static void pilotSamplerStart()
+{
+  AutoCriticalSection asc;
+  s_psAdmux = (DEFAULT << 6) | (PILOT_SENSE_PIN & 0x07);
+  s_psValid = 0;
+#ifdef AMMETER_BACKGROUND
+  s_amsAdmux = (DEFAULT << 6) | (CURRENT_PIN & 0x07);
+  s_AmmeterAccum.Init(ADC_HALF,AMS_ZERO_DEBOUNCE_TICKS,AMS_TIMEOUT_TICKS,
+                      AMS_MAX_SKIP_TICKS);
+  s_amsTickUs = micros();
+#endif // AMMETER_BACKGROUND
+  ADMUX = s_psAdmux;
+  TIFR1 = _BV(TOV1) | _BV(ICF1);
+  ADCSRB = PS_ADTS_BOTTOM;
+  ADCSRA |= _BV(ADATE) | _BV(ADIE);
+}
+
+// returns the ADCSRA to hand back to pilotSamplerResume()
+uint8_t pilotSamplerPause()
+{
+  uint8_t adcsra = ADCSRA;
+  // n.b. don't write back ADIF, or we'd clear it
+  ADCSRA = adcsra & ~(_BV(ADATE) | _BV(ADIE) | _BV(ADIF));
+  // let a conversion we triggered finish; its result is dropped
+  while (ADCSRA & _BV(ADSC));
+  return adcsra;
+}
+
+void pilotSamplerResume(uint8_t adcsra)
+{
+  if (adcsra & _BV(ADATE)) {
+    ADMUX = s_psAdmux;
+    TIFR1 = _BV(TOV1) | _BV(ICF1);
+#ifdef AMMETER_BACKGROUND
+    // a current conversion which was in flight was dropped by
+    // pilotSamplerPause(), and the triggers missed while paused are
+    // counted from the time of the last one, like the SAMD sampler
+    s_amsOnCurrent = 0;
+    // n.b. s_amsTickUs starts out up to a tick off Timer1's phase
+    long us = (long)(micros() - s_amsTickUs);
+    uint32_t ticks = (us > 0) ? (uint32_t)us / AMMETER_TICK_US : 0;
+    s_amsTickUs += ticks * AMMETER_TICK_US;
+    s_AmmeterAccum.Skip((ticks > 0xffff) ? 0xffff : (uint16_t)ticks);
+#endif // AMMETER_BACKGROUND
+    // writing ADIF discards the caller's conversion complete flag
+    ADCSRA = (adcsra & ~_BV(ADSC)) | _BV(ADIF);
+  }
+}
+
+uint8_t J1772Pilot::ReadPlateaus(uint16_t *plow,uint16_t *phigh)
+{
+  AutoCriticalSection asc;
+  if (s_psValid != (PS_HIGH_VALID|PS_LOW_VALID)) return 0;
+  *plow = s_psLow;
+  *phigh = s_psHigh;
+  return 1;
+}
+
+#ifdef AMMETER_BACKGROUND
+void ammeterSamplerSetWindow(uint16_t ticks)
+{
+  if (ticks != s_AmmeterAccum.GetWindow()) {
+    AutoCriticalSection asc;
+    s_AmmeterAccum.SetWindow(ticks);
+  }
+}
+
+uint8_t ammeterSamplerRead(uint32_t *meansq)
+{
+  return s_AmmeterAccum.Read(meansq);
+}
+#endif // AMMETER_BACKGROUND
+#endif // PILOT_ADC_TRIGGER
+
 void J1772Pilot::Init()
 {
 #ifdef PAFC_PWM
@@ -44,6 +189,10 @@ void J1772Pilot::Init()
 #endif
 
   SetState(PILOT_STATE_P12); // turns the pilot on 12V steady state
+
+#ifdef PILOT_ADC_TRIGGER
+  pilotSamplerStart();
+#endif
 }
 
 
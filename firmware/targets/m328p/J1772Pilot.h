@@ -38,4 +38,30 @@ public:
     return m_State; 
   }
   int SetPWM(int amps); // 12V 1KHz PWM
+#ifdef PILOT_ADC_TRIGGER
+  // latest high/low plateau samples taken in the background
+  // returns 0 if the sampler hasn't captured both yet
+  uint8_t ReadPlateaus(uint16_t *plow,uint16_t *phigh);
+#endif // PILOT_ADC_TRIGGER
 };
+
+#ifdef PILOT_ADC_TRIGGER
+// AdcPin::read() borrows the ADC from the pilot sampler
+uint8_t pilotSamplerPause();
+void pilotSamplerResume(uint8_t adcsra);
+
+#ifdef AMMETER_BACKGROUND
+// the pilot sampler also samples CURRENT_PIN once per plateau trigger, and
+// accumulates the sum of squares per full AC cycle, like the SAMD sampler
+#define AMMETER_TICK_US 500
+#define AMMETER_SAMPLE_HZ (1000000UL / AMMETER_TICK_US) // tick rate
+// ticks > 0: integrate over fixed windows of ticks (a whole number of
+//   mains cycles) instead of between zero crossings
+// ticks = 0: back to zero-crossing windows
+void ammeterSamplerSetWindow(uint16_t ticks);
+// *meansq = mean of squares (ADC counts, centered on ADC_HALF) of the most
+// recent full cycle, or 0 if not oscillating.
+// returns 1 if a new cycle completed since the last call, else 0
+uint8_t ammeterSamplerRead(uint32_t *meansq);
+#endif // AMMETER_BACKGROUND
+#endif // PILOT_ADC_TRIGGER
@@ -14,6 +14,10 @@ void getMcuId(uint8_t *mcuid)
 }
 #endif // MCU_ID_LEN
 
+#ifdef IDLE_SLEEP
+#include <avr/sleep.h>
+#endif
+
 
 void wdt_init(void) __attribute__((naked,used)) __attribute__((section(".init3")));
 void wdt_init(void)
@@ -24,8 +28,9 @@ void wdt_init(void)
   return;
 }
 
-//                                               A/B B/C C/D D DS
-THRESH_DATA J1772EVSEController::m_ThreshData = {875,780,690,0,260};
+THRESH_DATA J1772EVSEController::m_ThreshData = {
+  PILOT_THRESH_AB,PILOT_THRESH_BC,PILOT_THRESH_CD,PILOT_THRESH_D,PILOT_THRESH_DS
+};
 
 
 void DigitalPin::init(volatile uint8_t* _reg,uint8_t idx,PinMode _mode)
@@ -80,6 +85,9 @@ uint16_t AdcPin::read()
 {
   uint8_t low, high;
   
+#ifdef PILOT_ADC_TRIGGER
+  uint8_t adcsra = pilotSamplerPause();
+#endif
   
 #if defined(ADCSRB) && defined(MUX5)
   // the MUX5 bit of ADCSRB selects whether we're reading from channels
@@ -116,11 +124,123 @@ uint16_t AdcPin::read()
   high = 0;
 #endif
   
+#ifdef PILOT_ADC_TRIGGER
+  pilotSamplerResume(adcsra);
+#endif
+
   // combine the two bytes
   return (high << 8) | low;
 }
 
 
+#ifdef ZC_TRACKER
+static uint8_t s_zcCgmi;
+static uint8_t s_zcLastPind;
+static uint32_t s_zcRiseUs;
+
+// ACLINE1/2 are PD3/PD4 = PCINT19/20, so the PCMSK2 bits match the PIND bits
+ISR(PCINT2_vect)
+{
+  uint32_t us = micros();
+  uint8_t pind = PIND;
+  uint8_t rising = pind & ~s_zcLastPind;
+  uint8_t falling = s_zcLastPind & ~pind;
+  s_zcLastPind = pind;
+
+  if (s_zcCgmi) {
+    // pinAC2 HIGH = AC voltage below the opto threshold = near zero
+    // crossing. the crossing is the middle of the HIGH pulse
+    if (rising & _BV(ACLINE2_IDX)) {
+      s_zcRiseUs = us;
+    }
+    else if ((falling & _BV(ACLINE2_IDX)) && s_zcRiseUs) {
+      g_ZcTracker.Crossing(s_zcRiseUs + (us - s_zcRiseUs) / 2);
+    }
+  }
+  else if (rising & (_BV(ACLINE1_IDX)|_BV(ACLINE2_IDX))) {
+    // complementary diode half wave channels - a rising edge on either
+    // one starts its half cycle. only toggles while the relay is closed
+    g_ZcTracker.Crossing(us);
+  }
+}
+
+void zcTrackerBegin()
+{
+  s_zcCgmi = g_hasCGMI;
+  s_zcLastPind = PIND;
+  PCMSK2 |= s_zcCgmi ? _BV(ACLINE2_IDX) : (_BV(ACLINE1_IDX)|_BV(ACLINE2_IDX));
+  PCIFR = _BV(PCIF2);
+  PCICR |= _BV(PCIE2);
+}
+#endif // ZC_TRACKER
+
+#ifdef GFI_TEST_TIMER
+#if ((GFI_PULSE_ON_US * (F_CPU / 1000000UL)) / 1024UL) > 256
+#error GFI_PULSE_ON_US too long for Timer2
+#endif
+
+static DigitalPin *s_gfiPulsePin;
+static volatile uint16_t s_gfiPulseEdges;
+
+// Timer2 compare match = end of each half cycle
+ISR(TIMER2_COMPA_vect)
+{
+  s_gfiPulsePin->toggle();
+  if (!--s_gfiPulseEdges) {
+    TCCR2B = 0;
+    TIMSK2 &= ~_BV(OCIE2A);
+  }
+}
+
+void gfiPulseStart(DigitalPin *pin,uint16_t halfus,uint16_t cycles)
+{
+  gfiPulseStop();
+  s_gfiPulsePin = pin;
+  // starts HIGH, so an odd edge count leaves it LOW
+  s_gfiPulseEdges = cycles*2 - 1;
+  pin->write(1);
+
+  // CTC mode, clk/1024 = 64us ticks @ 16MHz
+  TCCR2A = _BV(WGM21);
+  TCNT2 = 0;
+  OCR2A = (uint8_t)((((uint32_t)halfus * (F_CPU / 1000000UL)) / 1024UL) - 1);
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 = _BV(OCIE2A);
+  TCCR2B = _BV(CS22)|_BV(CS21)|_BV(CS20);
+}
+
+void gfiPulseStop()
+{
+  AutoCriticalSection acs;
+  TCCR2B = 0;
+  TIMSK2 &= ~_BV(OCIE2A);
+  TIFR2 = _BV(OCF2A);
+  s_gfiPulseEdges = 0;
+  if (s_gfiPulsePin) s_gfiPulsePin->write(0);
+}
+
+uint8_t gfiPulseBusy()
+{
+  AutoCriticalSection acs;
+  return s_gfiPulseEdges != 0;
+}
+#endif // GFI_TEST_TIMER
+
+#ifdef IDLE_SLEEP
+void idleSleep()
+{
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  sleep_enable();
+  // the instruction after sei always executes, so an interrupt pending here
+  // is taken after sleep_cpu() and wakes us instead of being missed
+  sei();
+  sleep_cpu();
+  sleep_disable();
+}
+#endif // IDLE_SLEEP
+
+
 // platform-specific init
 void initTarget()
 {
@@ -36,6 +36,13 @@
 #define ADC_MAX 1023
 #define ADC_HALF 512
 
+// pilot phigh/plow ADC thresholds for m_ThreshData
+#define PILOT_THRESH_AB 875 // state A -> B
+#define PILOT_THRESH_BC 780 // state B -> C
+#define PILOT_THRESH_CD 690 // state C -> D
+#define PILOT_THRESH_D  0   // state D
+#define PILOT_THRESH_DS 260 // diode short
+
 // for J1772.ReadPilot()
 // 1x = 114us 20x = 2.3ms 100x = 11.3ms
 #define PILOT_LOOP_CNT 100
@@ -149,6 +156,15 @@ example
 
 void getMcuId(uint8_t *mcuid);
 
+#ifdef ZC_TRACKER
+#if !defined(ACLINE1_REG) || !defined(ACLINE2_REG)
+#error ZC_TRACKER requires ACLINE1 and ACLINE2
+#endif
+// feed g_ZcTracker from the PCINT2 pin change interrupt on the ACLINE pins.
+// call after initTarget() has set g_hasCGMI
+void zcTrackerBegin();
+#endif // ZC_TRACKER
+
 #if WATCHDOG_TIMEOUT_SEC != 2
 #error "unsupported WATCHDOG_TIMEOUT_SEC value"
 #endif
@@ -201,12 +217,30 @@ public:
     write(state);
   }  
 
+  // writing 1 to PINx toggles PORTx - a single store, so it can't clobber
+  // other bits of the port
+  void toggle() { *pin() = bit; }
+
   volatile uint8_t* pin() { return reg; }
   volatile uint8_t* ddr() { return reg+1; }
   volatile uint8_t* port() { return reg+2; }
 
 };
 
+#ifdef GFI_TEST_TIMER
+// GFI self test pulse train: cycles square wave periods of 2*halfus,
+// starting HIGH, toggled on pin from Timer2 compare interrupts
+void gfiPulseStart(DigitalPin *pin,uint16_t halfus,uint16_t cycles);
+void gfiPulseStop(); // safe to call from gfi_isr
+uint8_t gfiPulseBusy();
+#endif // GFI_TEST_TIMER
+
+#ifdef IDLE_SLEEP
+// sleep until the next interrupt. SLEEP_MODE_IDLE only stops the CPU clock,
+// so Timer0 (millis), Timer1 (pilot), Timer2, UART and ADC keep running
+void idleSleep();
+#endif // IDLE_SLEEP
+
 
 //
 // begin AdcPin class
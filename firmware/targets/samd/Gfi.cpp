@@ -30,7 +30,7 @@ void gfi_isr()
 }
 
 
-void Gfi::Init(uint8_t v6)
+void Gfi::Init(uint8_t /*v6*/)
 {
   pin.init(GFI_REG,GFI_IDX,DigitalPin::INP);
   // GFI triggers on rising edge
@@ -55,6 +55,10 @@ void Gfi::Reset()
 #ifdef GFI_SELFTEST
   testInProgress = 0;
   testSuccess = 0;
+#ifdef GFI_TEST_TIMER
+  gfiPulseStop();
+  testPhase = GST_IDLE;
+#endif // GFI_TEST_TIMER
 #endif // GFI_SELFTEST
 
   if (pin.read()) m_GfiFault = 1; // if interrupt pin is high, set fault
@@ -62,6 +66,85 @@ void Gfi::Reset()
 }
 
 #ifdef GFI_SELFTEST
+#ifdef GFI_TEST_TIMER
+void Gfi::SelfTestStart()
+{
+  gfiPulseStop();
+  testInProgress = 0;
+  testSuccess = 0;
+  testPhase = GST_CLEAR_PRE;
+  testPhaseStartMs = millis();
+}
+
+// same sequence as the blocking SelfTest(), but the pulse train comes from
+// a timer and each call only checks where it's at.
+// returns GFI_TEST_BUSY, or the SelfTest() result
+uint8_t Gfi::SelfTestPoll()
+{
+#ifdef BYPASS_GFI
+  testPhase = GST_IDLE;
+  return 0;
+#endif
+  unsigned long curms = millis();
+
+  switch(testPhase) {
+  case GST_CLEAR_PRE:
+    // wait for GFI pin to clear
+    if (!pin.read()) {
+      testInProgress = 1;
+      testPhase = GST_PULSE;
+      gfiPulseStart(&pinTest,GFI_PULSE_ON_US,200);
+    }
+    else if ((curms - testPhaseStartMs) >= GFI_TEST_CLEAR_PRE_MS) {
+      testPhase = GST_IDLE;
+      return 2;
+    }
+    break;
+  case GST_PULSE:
+    // gfi_isr() stops the pulse train early via SetTestSuccess()
+    if (!gfiPulseBusy()) {
+      testPhase = GST_CLEAR_POST;
+      testPhaseStartMs = curms;
+    }
+    break;
+  case GST_CLEAR_POST:
+    // wait for GFI pin to clear
+    if (!pin.read()) {
+      m_GfiFault = 0;
+      testInProgress = 0;
+      testPhase = GST_IDLE;
+      return !testSuccess;
+    }
+    else if ((curms - testPhaseStartMs) >= GFI_TEST_CLEAR_POST_MS) {
+      testInProgress = 0;
+      testPhase = GST_IDLE;
+      return 3;
+    }
+    break;
+  default:
+    return 1;
+  }
+
+  return GFI_TEST_BUSY;
+}
+
+void Gfi::SelfTestAbort()
+{
+  gfiPulseStop();
+  testInProgress = 0;
+  testPhase = GST_IDLE;
+}
+
+uint8_t Gfi::SelfTest()
+{
+  uint8_t rc;
+  SelfTestStart();
+  while ((rc = SelfTestPoll()) == GFI_TEST_BUSY) {
+    WDT_RESET();
+  }
+  return rc;
+}
+#else // !GFI_TEST_TIMER
 
 uint8_t Gfi::SelfTest()
 {
@@ -119,5 +202,6 @@ uint8_t Gfi::SelfTest()
 
   return !testSuccess;
 }
+#endif // GFI_TEST_TIMER
 #endif // GFI_SELFTEST
 #endif // GFI
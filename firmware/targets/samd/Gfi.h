@@ -22,12 +22,21 @@
  */
 #pragma once
 
+#ifdef GFI_TEST_TIMER
+#define GFI_TEST_BUSY 255 // SelfTestPoll(): test still running
+#endif // GFI_TEST_TIMER
+
 class Gfi {
   DigitalPin pin;
   uint8_t m_GfiFault;
 #ifdef GFI_SELFTEST
   volatile uint8_t testSuccess;
   uint8_t testInProgress;
+#ifdef GFI_TEST_TIMER
+  enum { GST_IDLE, GST_CLEAR_PRE, GST_PULSE, GST_CLEAR_POST };
+  uint8_t testPhase;
+  unsigned long testPhaseStartMs;
+#endif // GFI_TEST_TIMER
 #endif // GFI_SELFTEST
 public:
 #ifdef GFI_SELFTEST
@@ -42,7 +51,17 @@ public:
   uint8_t Fault() { return m_GfiFault; }
 #ifdef GFI_SELFTEST
   uint8_t SelfTest();
+#ifdef GFI_TEST_TIMER
+  // non-blocking SelfTest(): SelfTestStart(), then call SelfTestPoll()
+  // until it returns something other than GFI_TEST_BUSY
+  void SelfTestStart();
+  uint8_t SelfTestPoll();
+  void SelfTestAbort();
+  uint8_t SelfTestActive() { return testPhase != GST_IDLE; }
+  void SetTestSuccess() { testSuccess = 1; gfiPulseStop(); }
+#else
   void SetTestSuccess() { testSuccess = 1; }
+#endif // GFI_TEST_TIMER
   uint8_t SelfTestSuccess() { return testSuccess; }
   uint8_t SelfTestInProgress() { return testInProgress; }
 #endif
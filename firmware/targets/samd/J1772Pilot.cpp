@@ -80,6 +80,9 @@ void J1772Pilot::SetState(PILOT_STATE state)
   digitalWrite(PILOT_REG,(state == PILOT_STATE_P12) ? HIGH : LOW);
 
   m_State = state;
+#ifdef PILOT_ADC_TRIGGER
+  pilotSamplerRestart();
+#endif
   //  g_serial->printf("pstate: %s\n",(state == PILOT_STATE_P12) ? "P12":"N12");
 }
 
@@ -117,6 +120,9 @@ int J1772Pilot::SetPWM(int amps)
   pwmSetCompareCounts(compare);
 
   m_State = PILOT_STATE_PWM;
+#ifdef PILOT_ADC_TRIGGER
+  pilotSamplerRestart();
+#endif
 
   //  g_serial->printf("pwm cnt: %d\n",cnt);
   return 0;
@@ -37,4 +37,11 @@ public:
     return m_State; 
   }
   int SetPWM(int amps); // 12V 1KHz PWM
+#ifdef PILOT_ADC_TRIGGER
+  // min/max of the latest window of pilot samples taken in the background
+  // returns 0 if the sampler hasn't completed one since the pilot changed
+  uint8_t ReadPlateaus(uint16_t *plow,uint16_t *phigh) {
+    return pilotSamplerRead(plow,phigh);
+  }
+#endif // PILOT_ADC_TRIGGER
 };
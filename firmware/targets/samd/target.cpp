@@ -1,9 +1,11 @@
 #include "open_evse.h"
+#include <wiring_private.h>
 
 ExternalEEPROM g_eeprom;
 
-//                                               A/B  B/C  C/D  D DS
-THRESH_DATA J1772EVSEController::m_ThreshData = {3948,3539,3258,0,492};
+THRESH_DATA J1772EVSEController::m_ThreshData = {
+  PILOT_THRESH_AB,PILOT_THRESH_BC,PILOT_THRESH_CD,PILOT_THRESH_D,PILOT_THRESH_DS
+};
 
 #ifdef MCU_ID_LEN
 // mcuid *must* be of size MCU_ID_LEN
@@ -34,7 +36,354 @@ void getMcuId(uint8_t *mcuid)
 #endif // MCU_ID_LEN
 
 
-#ifdef RELAY_ZC_SWITCH
+#if defined(RELAY_ZC_SWITCH) || defined(AMMETER_BACKGROUND)
+// Wait for ADC register synchronization across clock domains (SAMD21 requires
+// this after CTRLA.ENABLE, INPUTCTRL and before SWTRIG writes).
+static inline void syncADC()
+{
+  while (ADC->STATUS.bit.SYNCBUSY == 1)
+    ;
+}
+#endif // RELAY_ZC_SWITCH || AMMETER_BACKGROUND
+
+
+#ifdef AMMETER_BACKGROUND
+// --- background sampler on CURRENT_PIN and the pilot -------------------------
+//
+// TC3 fires every AMMETER_TICK_US.  Each tick collects the conversion started
+// on the previous tick and starts the next one, so the ISR never waits on the
+// ADC.  Current samples go to s_AmmeterAccum, which does the sum of squares
+// per zero-crossing or cycle-locked window (see AdcSampler.h).
+//
+// With PILOT_ADC_TRIGGER, the ticks are grouped into SMP_FRAME_TICKS frames:
+// the mux is on PILOT_SENSE_PIN for the first half of each frame, and on
+// CURRENT_PIN for the second half.  The pilot samples go to s_PilotAccum,
+// which publishes the min and max of every PILOT_WINDOW_SAMPLES for
+// J1772Pilot::ReadPlateaus(), so ReadPilot() doesn't do any conversions of
+// its own.  TC3 and the pilot PWM (TCC0) both run off GCLK0, and the 1ms PWM
+// period isn't a multiple of the 360us frame, so the pilot samples walk
+// across it in 20us steps.  A window lands one sample on every step, which
+// catches even the 40us low plateau of a 96% duty cycle.
+//
+// analogRead() enables/disables the ADC and rewrites MUXPOS on every call, so
+// foreground conversions pause the sampler.  An in-flight conversion is
+// aborted, and the ADC is set up again (with the first conversion discarded)
+// when the sampler resumes.  The ticks which elapse while paused are still
+// counted, and a window which lost more than AMS_MAX_SKIP_TICKS of them is
+// thrown away (see AmmeterAccum::Skip()).  With the pilot on the sampler, the
+// only foreground conversions left are the occasional PP, GMI and POST reads,
+// and ReadPilot()'s own loop right after the pilot changes.
+//
+// The core's analogRead() setup is far too slow for a 60us tick (up to
+// ~420us per conversion), so the sampler runs the ADC at GCLK0/32 with a
+// short sampling time while it owns it, and puts the core's settings back
+// when paused.
+//
+// n.b. EVSYS/DMAC triggering with INPUTSCAN (AIN0 = CURRENT_PIN through
+// AIN2 = pilot) would save the ISR (~17k/sec), but it converts back to back
+// without the discard after each mux switch, wastes a third of the
+// conversions on AIN1, and the windowing would still have to run over the
+// DMA buffer in an ISR or the foreground.
+//
+// n.b. there's no ADC window monitor (WINCTRL) watch on the pilot any more.
+// it compares every result, and half of the conversions are CURRENT_PIN, so
+// it would have to be switched on and off w/ a sync wait on every mux
+// change.  ReadPilot() already does no conversions of its own, and a pilot
+// change is in the next window (~9ms), well inside the state debounce
+// (DEBOUNCE_CNT_x Update()s), so catching it sooner wouldn't change the
+// state any sooner.
+
+#include "AdcSampler.h"
+
+#if ((AMMETER_TICK_US * (F_CPU / 1000000UL)) % 64)
+#error AMMETER_TICK_US must be a whole number of TC3 counts
+#endif
+#define AMS_TICK_COUNTS ((AMMETER_TICK_US * (F_CPU / 1000000UL)) / 64) // TC3 counts per tick
+#define AMS_ZERO_DEBOUNCE_TICKS ((CURRENT_ZERO_DEBOUNCE_INTERVAL * 1000UL) / AMMETER_TICK_US)
+#define AMS_TIMEOUT_TICKS ((CURRENT_SAMPLE_INTERVAL * 1000UL) / AMMETER_TICK_US)
+#define AMS_MAX_SKIP_TICKS (1000UL / AMMETER_TICK_US) // 1ms, ~5% of a cycle
+#define AMS_SAMPLEN 5 // ADC sampling time (SAMPLEN+1)/2 ADC clocks
+
+static uint32_t s_amsCurrentChannel;
+static uint8_t s_amsResync;  // ADC must be set up again before next conversion
+static uint8_t s_amsPending; // a conversion we started is in flight
+static uint8_t s_amsKind;    // SMP_xxx of the conversion in flight
+static uint8_t s_amsMux;     // SMP_PILOT/SMP_CURRENT
+static uint32_t s_amsTickUs; // micros() of the last tick counted
+// core analogRead() settings, put back by ammeterSamplerPause()
+static uint8_t s_amsCorePrescaler;
+static uint8_t s_amsCoreSampctrl;
+
+// touched only by the ISR, or by the foreground with the ISR masked
+static AmmeterAccum s_AmmeterAccum;
+
+#ifdef PILOT_ADC_TRIGGER
+static uint32_t s_amsPilotChannel;
+static uint8_t s_amsSlot; // conversion slot in the SMP_FRAME_TICKS frame
+static PilotAccum s_PilotAccum;
+#endif // PILOT_ADC_TRIGGER
+
+// collect the pending conversion, if it's done
+static inline void amsCollect()
+{
+  if (s_amsPending && ADC->INTFLAG.bit.RESRDY) {
+    uint16_t sample = (uint16_t)ADC->RESULT.reg; // reading RESULT clears RESRDY
+    s_amsPending = 0;
+    if (s_amsKind == SMP_CURRENT) s_AmmeterAccum.Sample(sample);
+#ifdef PILOT_ADC_TRIGGER
+    else if (s_amsKind == SMP_PILOT) s_PilotAccum.Sample(sample);
+#endif
+  }
+}
+
+// take the ADC back from analogRead()
+static void amsTakeAdc()
+{
+  syncADC();
+  s_amsCorePrescaler = ADC->CTRLB.bit.PRESCALER;
+  s_amsCoreSampctrl = ADC->SAMPCTRL.reg;
+  ADC->CTRLB.bit.PRESCALER = ADC_CTRLB_PRESCALER_DIV32_Val;
+  syncADC();
+  ADC->SAMPCTRL.reg = AMS_SAMPLEN;
+  syncADC();
+  ADC->CTRLA.bit.ENABLE = 0x01;
+}
+
+void TC3_Handler()
+{
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+
+  s_amsTickUs += AMMETER_TICK_US;
+  amsCollect();
+  s_AmmeterAccum.Tick(1);
+  if (s_amsPending) return; // conversion overran the tick; collect it next time
+
+#ifdef PILOT_ADC_TRIGGER
+  if (++s_amsSlot >= SMP_FRAME_TICKS) s_amsSlot = 0;
+  uint8_t mux = smpSlotMux(s_amsSlot);
+  uint8_t kind = smpSlotKind(s_amsSlot);
+#else
+  uint8_t mux = SMP_CURRENT;
+  uint8_t kind = SMP_CURRENT;
+#endif // PILOT_ADC_TRIGGER
+  if (s_amsResync || (mux != s_amsMux)) {
+    syncADC();
+#ifdef PILOT_ADC_TRIGGER
+    ADC->INPUTCTRL.bit.MUXPOS = (mux == SMP_PILOT) ? s_amsPilotChannel : s_amsCurrentChannel;
+#else
+    ADC->INPUTCTRL.bit.MUXPOS = s_amsCurrentChannel;
+#endif
+    s_amsMux = mux;
+    kind = SMP_DISCARD; // S/H still holds the old channel
+  }
+  if (s_amsResync) {
+    amsTakeAdc();
+    s_amsResync = 0;
+  }
+  syncADC();
+  ADC->SWTRIG.bit.START = 1;
+  s_amsKind = kind;
+  s_amsPending = 1;
+}
+
+void ammeterSamplerBegin(uint32_t currentpin,uint32_t pilotpin)
+{
+  pinPeripheral(currentpin, PIO_ANALOG);
+  s_amsCurrentChannel = g_APinDescription[currentpin].ulADCChannelNumber;
+  s_AmmeterAccum.Init(ADC_HALF,AMS_ZERO_DEBOUNCE_TICKS,AMS_TIMEOUT_TICKS,
+                      AMS_MAX_SKIP_TICKS);
+#ifdef PILOT_ADC_TRIGGER
+  pinPeripheral(pilotpin, PIO_ANALOG);
+  s_amsPilotChannel = g_APinDescription[pilotpin].ulADCChannelNumber;
+  s_PilotAccum.Init(PILOT_WINDOW_SAMPLES);
+#endif
+  s_amsResync = 1;
+
+  PM->APBCMASK.reg |= PM_APBCMASK_TC3;
+  GCLK->CLKCTRL.reg = (uint16_t)(GCLK_CLKCTRL_CLKEN |
+                                 GCLK_CLKCTRL_GEN_GCLK0 |
+                                 GCLK_CLKCTRL_ID_TCC2_TC3);
+  while (GCLK->STATUS.bit.SYNCBUSY) {
+  }
+
+  TC3->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 |
+                           TC_CTRLA_WAVEGEN_MFRQ |
+                           TC_CTRLA_PRESCALER_DIV64;
+  TC3->COUNT16.CC[0].reg = AMS_TICK_COUNTS - 1;
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+
+  TC3->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+  NVIC_SetPriority(TC3_IRQn, 3); // below GFI
+  NVIC_EnableIRQ(TC3_IRQn);
+
+  TC3->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  s_amsTickUs = micros();
+}
+
+// hand the ADC to the foreground
+void ammeterSamplerPause()
+{
+  NVIC_DisableIRQ(TC3_IRQn);
+  amsCollect();
+  if (!s_amsResync) {
+    // abort the in-flight conversion, if any, rather than wait for it, and
+    // leave the ADC disabled w/ the core's settings, as analogRead() expects
+    syncADC();
+    ADC->CTRLA.bit.ENABLE = 0x00;
+    syncADC();
+    ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+    ADC->CTRLB.bit.PRESCALER = s_amsCorePrescaler;
+    syncADC();
+    ADC->SAMPCTRL.reg = s_amsCoreSampctrl;
+    syncADC();
+    s_amsPending = 0;
+    s_amsResync = 1;
+  }
+}
+
+void ammeterSamplerResume()
+{
+  // count the ticks we missed from the time of the last one counted, so
+  // partial ticks carry over into the next pause instead of being dropped.
+  // TC3 kept running, and the OVF it latched while we were paused is one of
+  // them - clear it, or the ISR would count it a second time on enable
+  uint32_t ticks = (micros() - s_amsTickUs) / AMMETER_TICK_US;
+  s_amsTickUs += ticks * AMMETER_TICK_US;
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  NVIC_ClearPendingIRQ(TC3_IRQn);
+  s_AmmeterAccum.Skip((ticks > 0xffff) ? 0xffff : (uint16_t)ticks);
+  NVIC_EnableIRQ(TC3_IRQn);
+}
+
+void ammeterSamplerSetWindow(uint16_t ticks)
+{
+  if (ticks != s_AmmeterAccum.GetWindow()) {
+    NVIC_DisableIRQ(TC3_IRQn);
+    s_AmmeterAccum.SetWindow(ticks);
+    NVIC_EnableIRQ(TC3_IRQn);
+  }
+}
+
+uint8_t ammeterSamplerRead(uint32_t *meansq)
+{
+  return s_AmmeterAccum.Read(meansq);
+}
+
+#ifdef PILOT_ADC_TRIGGER
+void pilotSamplerRestart()
+{
+  NVIC_DisableIRQ(TC3_IRQn);
+  s_PilotAccum.Restart();
+  if (s_amsKind == SMP_PILOT) s_amsKind = SMP_DISCARD; // it's the old pilot
+  NVIC_EnableIRQ(TC3_IRQn);
+}
+
+uint8_t pilotSamplerRead(uint16_t *plow,uint16_t *phigh)
+{
+  NVIC_DisableIRQ(TC3_IRQn);
+  uint8_t rc = s_PilotAccum.Read(plow,phigh);
+  NVIC_EnableIRQ(TC3_IRQn);
+  return rc;
+}
+#endif // PILOT_ADC_TRIGGER
+#endif // AMMETER_BACKGROUND
+
+
+#ifdef ZC_TRACKER
+static volatile RelayTimerFunc s_RelayTimerFn;
+
+// GMI is the AC voltage waveform centered on ADC_HALF, so the digital input
+// threshold stands in for the sign change measureAcFreq() looks for: every
+// edge, rising or falling, is a crossing. the ACLINE2 pull-up moves the
+// threshold off center, which makes the half periods alternate long/short,
+// but the PLL averages that out
+static void zcIsr()
+{
+  g_ZcTracker.Crossing(micros());
+}
+
+void zcTrackerBegin()
+{
+  attachInterrupt(digitalPinToInterrupt(GMI_ADC_PIN),zcIsr,CHANGE);
+
+  // TC4 counts up at F_CPU/64 = 750kHz, MC0 interrupt = relay switch time
+  PM->APBCMASK.reg |= PM_APBCMASK_TC4;
+  GCLK->CLKCTRL.reg = (uint16_t)(GCLK_CLKCTRL_CLKEN |
+                                 GCLK_CLKCTRL_GEN_GCLK0 |
+                                 GCLK_CLKCTRL_ID_TC4_TC5);
+  while (GCLK->STATUS.bit.SYNCBUSY) {
+  }
+
+  TC4->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC4->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC4->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 |
+                           TC_CTRLA_WAVEGEN_NFRQ |
+                           TC_CTRLA_PRESCALER_DIV64;
+  while (TC4->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC4->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+  NVIC_SetPriority(TC4_IRQn, 0); // same as GFI, so neither preempts the other
+  NVIC_EnableIRQ(TC4_IRQn);
+}
+
+void relayTimerStart(uint32_t us,RelayTimerFunc fn)
+{
+  uint32_t ticks = (us * 3UL) / 4UL; // 750kHz
+  if (ticks < 1) ticks = 1;
+  else if (ticks > 0xffff) ticks = 0xffff;
+
+  // keep gfi_isr out until we're armed, so its chargingOff(1) can't be
+  // undone by a switch it didn't see
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  TC4->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC4->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC4->COUNT16.COUNT.reg = 0;
+  TC4->COUNT16.CC[0].reg = ticks;
+  while (TC4->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  NVIC_ClearPendingIRQ(TC4_IRQn);
+  s_RelayTimerFn = fn;
+  TC4->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC4->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  __set_PRIMASK(primask);
+}
+
+// safe to call from gfi_isr
+RelayTimerFunc relayTimerCancel()
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  TC4->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC4->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  NVIC_ClearPendingIRQ(TC4_IRQn);
+  RelayTimerFunc fn = s_RelayTimerFn;
+  s_RelayTimerFn = NULL;
+  __set_PRIMASK(primask);
+  return fn;
+}
+
+void TC4_Handler()
+{
+  TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  TC4->COUNT16.CTRLA.bit.ENABLE = 0;
+  RelayTimerFunc fn = s_RelayTimerFn;
+  s_RelayTimerFn = NULL;
+  if (fn) fn();
+}
+#elif defined(RELAY_ZC_SWITCH)
 // --- GMI zero-cross ADC on PA09 / AIN[17] -----------------------------------
 //
 // The AC voltage zero-cross ("GMI") line is on PA09.  analogRead() cannot read
@@ -63,16 +412,11 @@ void getMcuId(uint8_t *mcuid)
 
 #define GMI_ADC_MUXPOS 0x11u // AIN[17] = PA09
 
-// Wait for ADC register synchronization across clock domains (SAMD21 requires
-// this after CTRLA.ENABLE, INPUTCTRL and before SWTRIG writes).
-static inline void gmiSyncADC()
-{
-  while (ADC->STATUS.bit.SYNCBUSY == 1)
-    ;
-}
-
 void gmiAdcBegin()
 {
+#ifdef AMMETER_BACKGROUND
+  ammeterSamplerPause();
+#endif
   EPortType port = (EPortType)g_APinDescription[GMI_ADC_PIN].ulPort;
   uint32_t   pin  = g_APinDescription[GMI_ADC_PIN].ulPin; // PA09 -> 9
 
@@ -85,12 +429,12 @@ void gmiAdcBegin()
   PORT->Group[port].PINCFG[pin].reg = PORT_PINCFG_PMUXEN;
 
   // Select AIN[17] as the positive input.  MUXNEG stays at GND (core default).
-  gmiSyncADC();
+  syncADC();
   ADC->INPUTCTRL.bit.MUXPOS = GMI_ADC_MUXPOS;
 
-  gmiSyncADC();
+  syncADC();
   ADC->CTRLA.bit.ENABLE = 0x01; // enable ADC
-  gmiSyncADC();
+  syncADC();
 
   // The first conversion after a MUXPOS change is not valid (SAMD21 datasheet);
   // trigger one and discard it.
@@ -102,7 +446,7 @@ void gmiAdcBegin()
 
 uint16_t gmiAdcRead()
 {
-  gmiSyncADC();
+  syncADC();
   ADC->SWTRIG.bit.START = 1;
   while (ADC->INTFLAG.bit.RESRDY == 0)
     ;
@@ -111,16 +455,126 @@ uint16_t gmiAdcRead()
 
 void gmiAdcEnd()
 {
-  gmiSyncADC();
+  syncADC();
   ADC->CTRLA.bit.ENABLE = 0x00; // disable ADC (leave it as analogRead() expects)
-  gmiSyncADC();
+  syncADC();
 
   // Restore PA09 to the digital ACLINE2 ground-monitor input with pull-up.
   // pinMode() rewrites PINCFG (clearing PMUXEN, setting INEN|PULLEN), does
   // DIRCLR, and drives OUT high for the pull-up — exactly DigitalPin INP_PU.
   pinMode(GMI_ADC_PIN, INPUT_PULLUP);
+
+#ifdef AMMETER_BACKGROUND
+  ammeterSamplerResume();
+#endif
 }
-#endif // RELAY_ZC_SWITCH
+#endif // ZC_TRACKER
+
+#ifdef GFI_TEST_TIMER
+static DigitalPin *s_gfiPulsePin;
+static volatile uint16_t s_gfiPulseEdges;
+
+void gfiPulseStart(DigitalPin *pin,uint16_t halfus,uint16_t cycles)
+{
+  // TC5 counts up at F_CPU/64 = 750kHz and wraps at CC0 every half cycle
+  PM->APBCMASK.reg |= PM_APBCMASK_TC5;
+  GCLK->CLKCTRL.reg = (uint16_t)(GCLK_CLKCTRL_CLKEN |
+                                 GCLK_CLKCTRL_GEN_GCLK0 |
+                                 GCLK_CLKCTRL_ID_TC4_TC5);
+  while (GCLK->STATUS.bit.SYNCBUSY) {
+  }
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  TC5->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC5->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC5->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 |
+                           TC_CTRLA_WAVEGEN_MFRQ |
+                           TC_CTRLA_PRESCALER_DIV64;
+  while (TC5->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC5->COUNT16.COUNT.reg = 0;
+  TC5->COUNT16.CC[0].reg = (((uint32_t)halfus * (F_CPU / 1000000UL)) / 64UL) - 1;
+  while (TC5->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  TC5->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+  NVIC_ClearPendingIRQ(TC5_IRQn);
+  NVIC_SetPriority(TC5_IRQn, 0); // same as GFI, so neither preempts the other
+  NVIC_EnableIRQ(TC5_IRQn);
+
+  s_gfiPulsePin = pin;
+  // starts HIGH, so an odd edge count leaves it LOW
+  s_gfiPulseEdges = cycles*2 - 1;
+  pin->write(1);
+  TC5->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC5->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  __set_PRIMASK(primask);
+}
+
+// safe to call from gfi_isr
+void gfiPulseStop()
+{
+  if (!s_gfiPulsePin) return; // TC5 never clocked
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  TC5->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC5->COUNT16.STATUS.bit.SYNCBUSY) {
+  }
+  TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  NVIC_ClearPendingIRQ(TC5_IRQn);
+  s_gfiPulseEdges = 0;
+  s_gfiPulsePin->write(0);
+  __set_PRIMASK(primask);
+}
+
+uint8_t gfiPulseBusy()
+{
+  return s_gfiPulseEdges != 0;
+}
+
+void TC5_Handler()
+{
+  TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  uint16_t edges = s_gfiPulseEdges - 1;
+  s_gfiPulseEdges = edges;
+  s_gfiPulsePin->write(edges & 1);
+  if (!edges) {
+    TC5->COUNT16.CTRLA.bit.ENABLE = 0;
+  }
+}
+#endif // GFI_TEST_TIMER
+
+#ifdef IDLE_SLEEP
+void idleSleep()
+{
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+  PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
+#ifdef AMMETER_BACKGROUND
+  // TC3 wakes us every AMMETER_TICK_US, ~17k/sec, and a scheduler pass
+  // after each one would eat most of what the sleep saves. WFI w/ PRIMASK
+  // set still wakes on a pending interrupt, but leaves it pending, so we
+  // can see what woke us: if it's only the sampler tick, let it run and go
+  // back to sleep. anything else (SysTick, serial, GFI, ZC) returns.
+  // one that comes in between the check and __enable_irq() is serviced
+  // but doesn't end the sleep, so its task waits for the next SysTick
+  for (;;) {
+    __disable_irq();
+    __DSB();
+    __WFI();
+    uint8_t tickonly = !(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) &&
+      ((NVIC->ISPR[0] & NVIC->ISER[0]) == (1UL << TC3_IRQn));
+    __enable_irq(); // pending handlers run here
+    if (!tickonly) break;
+  }
+#else
+  __DSB();
+  __WFI();
+#endif // AMMETER_BACKGROUND
+}
+#endif // IDLE_SLEEP
 
 
 void DigitalPin::init(uint32_t pinnum,int idxjunk,PinMode mode)
@@ -153,6 +607,10 @@ void initTarget()
     while(1);
   }
 
+#ifdef AMMETER_BACKGROUND
+  ammeterSamplerBegin(CURRENT_PIN,PILOT_SENSE_PIN);
+#endif
+
   //n.b. set BOD via fuses, not this code, as fuses may lock out BOD from being
   // manipulated in code, anyway
   // default factory fuse setting is 1.78V BOD enabled
@@ -8,6 +8,13 @@
 #define ADC_MAX 4095
 #define ADC_HALF 2048
 
+// pilot phigh/plow ADC thresholds for m_ThreshData
+#define PILOT_THRESH_AB 3948 // state A -> B
+#define PILOT_THRESH_BC 3539 // state B -> C
+#define PILOT_THRESH_CD 3258 // state C -> D
+#define PILOT_THRESH_D  0    // state D
+#define PILOT_THRESH_DS 492  // diode short
+
 #define DEFAULT_CURRENT_SCALE_FACTOR    37
 #define DEFAULT_AMMETER_CURRENT_OFFSET -135
 
@@ -75,6 +82,40 @@ void init(uint32_t pinnum,int idxjunk,PinMode mode);
   }
 };
 
+#ifdef AMMETER_BACKGROUND
+// CURRENT_PIN (and the pilot, w/ PILOT_ADC_TRIGGER) is sampled continuously
+// from a TC3 interrupt every AMMETER_TICK_US, and the sum of squares is
+// accumulated per full AC cycle (zero crossing to zero crossing), so
+// readAmmeter() and ReadPilot() never block.
+// The ADC is shared with analogRead(): foreground conversions must be
+// bracketed by ammeterSamplerPause()/ammeterSamplerResume()
+// (AdcPin::read() and gmiAdcBegin()/gmiAdcEnd() already do this).
+#define AMMETER_TICK_US 60
+#define AMMETER_SAMPLE_HZ (1000000UL / AMMETER_TICK_US) // tick rate
+// pilot samples per ReadPlateaus() window: 25 frames, ~9ms
+#define PILOT_WINDOW_SAMPLES 50
+void ammeterSamplerBegin(uint32_t currentpin,uint32_t pilotpin);
+void ammeterSamplerPause();
+void ammeterSamplerResume();
+// ticks > 0: integrate over fixed windows of ticks (a whole number of
+//   mains cycles) instead of between zero crossings
+// ticks = 0: back to zero-crossing windows
+void ammeterSamplerSetWindow(uint16_t ticks);
+// *meansq = mean of squares (ADC counts, centered on ADC_HALF) of the most
+// recent full cycle, or 0 if not oscillating.
+// returns 1 if a new cycle completed since the last call, else 0
+uint8_t ammeterSamplerRead(uint32_t *meansq);
+
+#ifdef PILOT_ADC_TRIGGER
+// J1772Pilot calls this whenever it changes the pilot, so that a window
+// never mixes the old pilot with the new one
+void pilotSamplerRestart();
+// min/max of the latest complete window of pilot samples
+// returns 0 if no window has completed since pilotSamplerRestart()
+uint8_t pilotSamplerRead(uint16_t *plow,uint16_t *phigh);
+#endif // PILOT_ADC_TRIGGER
+#endif // AMMETER_BACKGROUND
+
 class AdcPin {
   uint32_t _pinNum;
 public:
@@ -96,11 +137,30 @@ public:
     // Safe here only because every AdcPin instance uses A0..A5 (>= A0):
     // PILOT_SENSE_PIN, CURRENT_PIN, PP_PIN.  The GMI zero-cross line on PA09
     // (pin 3) cannot use analogRead() at all — see gmiAdc*() below.
+#ifdef AMMETER_BACKGROUND
+    ammeterSamplerPause();
+    uint32_t val = analogRead(_pinNum);
+    ammeterSamplerResume();
+    return val;
+#else
     return analogRead(_pinNum);
+#endif // AMMETER_BACKGROUND
   }
 };
 
-#ifdef RELAY_ZC_SWITCH
+#ifdef ZC_TRACKER
+// feed g_ZcTracker from an EIC interrupt on both edges of the GMI line
+// (PA09), which stays a digital input for ReadACPins()
+void zcTrackerBegin();
+
+// one shot TC4 timer to switch the relay at a predicted zero crossing.
+// fn runs in ISR context. relayTimerCancel() returns the fn that was
+// still pending, or NULL
+#define RELAY_TIMER
+typedef void (*RelayTimerFunc)();
+void relayTimerStart(uint32_t us,RelayTimerFunc fn);
+RelayTimerFunc relayTimerCancel();
+#elif defined(RELAY_ZC_SWITCH)
 // Read the AC zero-cross signal on the GMI line (PA09 / AIN[17]) via a direct
 // SAMD21 ADC register access — analogRead() cannot reach it (see target.cpp).
 // gmiAdcBegin()/gmiAdcEnd() bracket a sampling burst: they switch PA09 from its
@@ -109,7 +169,23 @@ public:
 void gmiAdcBegin();
 uint16_t gmiAdcRead();
 void gmiAdcEnd();
-#endif // RELAY_ZC_SWITCH
+#endif // ZC_TRACKER
+
+#ifdef GFI_TEST_TIMER
+// GFI self test pulse train: cycles square wave periods of 2*halfus,
+// starting HIGH, written to pin from TC5 interrupts
+void gfiPulseStart(DigitalPin *pin,uint16_t halfus,uint16_t cycles);
+void gfiPulseStop(); // safe to call from gfi_isr
+uint8_t gfiPulseBusy();
+#endif // GFI_TEST_TIMER
+
+#ifdef IDLE_SLEEP
+// WFI in IDLE0 - only the CPU clock stops, so SysTick, TCC/TC, SERCOM,
+// ADC and EIC keep running and any of their interrupts wake it.
+// w/ AMMETER_BACKGROUND, the sampler's TC3 ticks are serviced w/o
+// returning, so it sleeps until the next SysTick or other interrupt
+void idleSleep();
+#endif // IDLE_SLEEP
 
 void getMcuId(uint8_t *mcuid);
 
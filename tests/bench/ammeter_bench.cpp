@@ -0,0 +1,369 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// accuracy and throughput of the ways the ammeter can be read, on the same
+// generated current waveforms (s_Shapes: clean and off nominal sines,
+// harmonics, DC offset, noise, phase jumps), quantised to 10 and 12 bits:
+//
+//  zc        the blocking readAmmeter() zero-crossing loop (host build,
+//            analogRead() takes adcUs of virtual time)
+//  lock      the blocking AMMETER_CYCLE_LOCK loop: AMMETER_LOCK_CYCLES at
+//            AMMETER_LOCK_SAMPLE_HZ, from m_AcFreqX100
+//  bg_m328p  AMMETER_BACKGROUND on m328p: AdcSampler.h's AmmeterAccum fed one
+//            sample per 500us pilot trigger, in zc and locked windows
+//  bg_samd   AMMETER_BACKGROUND on SAMD: one sample in 3 of each 6 tick
+//            frame of 60us, in zc and locked windows
+//
+// per case it prints one key=value line:
+//  err_rms_pct  rms of the readings' errors vs the true rms of the AC
+//               current (w/o the DC offset and noise), in %
+//  err_max_pct  worst reading
+//  zc_misses    readings that timed out to 0, or are off by more than
+//               ZC_MISS_PCT, i.e. a window which wasn't whole cycles
+//               because a crossing was missed or a false one was taken
+//  samples      current samples consumed per reading
+//  blocked_us   virtual time readAmmeter() spent per reading, i.e. time
+//               the main loop was held up (0 for the background sampler)
+//  ns_per_call  host time per readAmmeter() call (zc/lock, including the
+//               simulation), or per AmmeterAccum Tick()/Sample()/Read()
+//               (bg). only good for comparing runs on the same machine
+//
+// and a "math" line each for ulong_sqrt() and MovingAverage(), and an
+// "ema" line per check that MovingAverage() starts over w/ the reading
+// after chargingOn()/chargingOff()
+//
+// exits non-zero if any case gets no readings, or its err_rms_pct is over
+// its shape's tolerance, or an ema check fails. a phase jump can cost the zero-crossing loop a
+// whole reading, so those only catch gross breakage
+//
+// usage: ammeter_bench [seconds of signal per case]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "open_evse.h"
+#include "AdcSampler.h"
+#include "AmmeterMath.h"
+
+#define BG_LOCK_CYCLES 3 // AMMETER_LOCK_CYCLES w/ AMMETER_BACKGROUND
+#define ZC_MISS_PCT 10
+
+struct AmmeterBench {
+  static uint8_t Read() { return g_EvseController.readAmmeter(); }
+  static uint32_t MovingAverage(uint32_t samp) { return g_EvseController.MovingAverage(samp); }
+  static void ChargingOn() { g_EvseController.chargingOn(); }
+  static void ChargingOff() { g_EvseController.chargingOff(1); }
+  static unsigned long Reading() { return g_EvseController.m_AmmeterReading; }
+  static void SetAcFreqX100(uint16_t f) { g_EvseController.m_AcFreqX100 = f; }
+};
+
+static uint32_t s_Rand = 1;
+static uint32_t rnd()
+{
+  s_Rand = s_Rand * 1103515245UL + 12345UL;
+  return s_Rand >> 8;
+}
+static double rndUnit() { return (rnd() & 0xffff) / 65536.0; }
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Shape {
+  const char *name;
+  double hzscale;  // x the nominal mains frequency
+  double h3,h5;    // 3rd/5th harmonic, fraction of the fundamental
+  double dc;       // DC offset, 12-bit counts
+  double noise;    // +/- 12-bit counts, uniform
+  double jumpms;   // the phase jumps by jumprad every jumpms. 0 = never
+  double jumprad;
+  double tolpct;   // max err_rms_pct allowed
+};
+
+static const Shape s_Shapes[] = {
+  { "sine",1,0,0,0,0,0,0,3 },
+  { "off_nominal",0.997,0,0,0,0,0,0,3 },
+  { "harmonics",1,0.15,0.08,0,0,0,0,3 },
+  { "dc_offset",1,0,0,20,0,0,0,3 },
+  { "noise",1,0,0,0,8,0,0,3 },
+  { "phase_jump",1,0,0,0,0,200,M_PI/2,20 },
+  { "mixed",0.997,0.15,0.08,20,8,200,M_PI/2,20 },
+};
+
+// the current waveform, in 12-bit counts around 0
+static struct {
+  const Shape *shape;
+  double hz;
+  double amp;   // peak of the fundamental
+  double phase;
+  uint8_t bits; // ADC resolution
+  unsigned reads; // # analogRead(CURRENT_PIN)
+} s_Wave;
+
+static void waveStart(const Shape &shape,double hz,double amp,uint8_t bits)
+{
+  s_Wave.shape = &shape;
+  s_Wave.hz = hz * shape.hzscale;
+  s_Wave.amp = amp;
+  s_Wave.phase = rndUnit() * 2 * M_PI;
+  s_Wave.bits = bits;
+}
+
+static double waveAt(double us)
+{
+  const Shape &s = *s_Wave.shape;
+  double ph = 2 * M_PI * s_Wave.hz * us / 1e6 + s_Wave.phase;
+  if (s.jumpms) ph += s.jumprad * floor(us / (s.jumpms * 1000));
+  double v = s_Wave.amp * (sin(ph) + s.h3 * sin(3 * ph) + s.h5 * sin(5 * ph));
+  v += s.dc;
+  if (s.noise) v += s.noise * (2 * rndUnit() - 1);
+  return v;
+}
+
+// rms of the AC current, in 12-bit counts
+static double waveRms()
+{
+  const Shape &s = *s_Wave.shape;
+  return s_Wave.amp * sqrt((1 + s.h3 * s.h3 + s.h5 * s.h5) / 2);
+}
+
+// v in 12-bit counts around 0 -> ADC reading at bits of resolution
+static uint16_t quantise(double v,uint8_t bits)
+{
+  double half = (double)(1 << (bits - 1));
+  double a = half + v / (1 << (12 - bits));
+  long max = (1L << bits) - 1;
+  return (a < 0) ? 0 : ((a > max) ? max : (uint16_t)(a + 0.5));
+}
+
+// the host ADC is 12 bits, so a 10-bit reading is scaled up
+static uint16_t hostCurrentAdc(uint64_t us)
+{
+  s_Wave.reads++;
+  return quantise(waveAt((double)us),s_Wave.bits) << (12 - s_Wave.bits);
+}
+
+struct Result {
+  unsigned readings;
+  unsigned zcmisses;
+  double sumsqerr;  // sum of squared relative errors
+  double maxerr;    // relative
+  double samples;
+  double blockedus;
+  double ns;
+  unsigned calls;
+
+  Result() : readings(0),zcmisses(0),sumsqerr(0),maxerr(0),samples(0),blockedus(0),ns(0),calls(0) {}
+  void Add(double reading,double truth) {
+    double err = fabs(reading - truth) / truth;
+    sumsqerr += err * err;
+    if (err > maxerr) maxerr = err;
+    if (!reading || (err * 100 > ZC_MISS_PCT)) zcmisses++;
+    readings++;
+  }
+};
+
+static int s_Fails;
+
+static void report(const char *method,const char *mode,double hz,double amp,
+                   const Result &r)
+{
+  const Shape &s = *s_Wave.shape;
+  double errrms = r.readings ? 100 * sqrt(r.sumsqerr / r.readings) : 0;
+  int ok = r.readings && (errrms <= s.tolpct);
+  if (!ok) s_Fails++;
+  printf("ammeter method=%s mode=%s wave=%s bits=%u hz=%g amp=%g readings=%u err_rms_pct=%.3f err_max_pct=%.3f zc_misses=%u samples=%.1f blocked_us=%.0f ns_per_call=%.0f %s\n",
+         method,mode,s.name,s_Wave.bits,hz,amp,r.readings,errrms,100 * r.maxerr,
+         r.zcmisses,r.readings ? r.samples / r.readings : 0,
+         r.readings ? r.blockedus / r.readings : 0,
+         r.calls ? r.ns / r.calls : 0,ok ? "OK" : "FAIL");
+}
+
+// the blocking readAmmeter() on the host build, called with a random gap
+// in between, like the main loop doing other things
+static void blockingCase(const char *mode,const Shape &shape,double hz,
+                         double amp,uint8_t bits,double secs)
+{
+  waveStart(shape,hz,amp,bits);
+  // m_AcFreqX100 is what measureAcFreq() would have measured
+  AmmeterBench::SetAcFreqX100((mode[0] == 'l') ? (uint16_t)(s_Wave.hz * 100 + 0.5) : 0);
+
+  double truth = waveRms();
+  Result r;
+  uint64_t end = g_Sim.nowUs + (uint64_t)(secs * 1e6);
+  while (g_Sim.nowUs < end) {
+    g_Sim.Advance(rnd() % 20000);
+    unsigned reads = s_Wave.reads;
+    uint64_t us = g_Sim.nowUs;
+    uint64_t ns = nowNs();
+    AmmeterBench::Read();
+    r.ns += nowNs() - ns;
+    r.calls++;
+    r.blockedus += g_Sim.nowUs - us;
+    r.samples += s_Wave.reads - reads;
+    r.Add(AmmeterBench::Reading(),truth);
+  }
+  report(mode[0] == 'l' ? "lock" : "zc",mode,hz,amp,r);
+}
+
+// AmmeterAccum w/ the same windowing parameters as the target's ISR
+// tickus: tick period
+// frame: 1 = a current sample every tick (m328p), else SMP_FRAME_TICKS slots
+// the samples are made up front, so ns_per_call is just the accumulator
+static void backgroundCase(const char *method,const char *mode,
+                           const Shape &shape,double hz,double amp,
+                           uint8_t bits,double secs,uint16_t tickus,
+                           uint8_t frame)
+{
+  waveStart(shape,hz,amp,bits);
+
+  AmmeterAccum acc;
+  acc.Init(1 << (bits - 1),
+           (CURRENT_ZERO_DEBOUNCE_INTERVAL * 1000UL) / tickus,
+           (CURRENT_SAMPLE_INTERVAL * 1000UL) / tickus,
+           1000UL / tickus);
+  if (mode[0] == 'l') {
+    // same rounding as ammeterLockSamples()
+    uint32_t hzx100 = (uint32_t)(s_Wave.hz * 100 + 0.5);
+    acc.SetWindow((uint16_t)(((uint32_t)BG_LOCK_CYCLES * (1000000UL / tickus) * 100UL + hzx100/2) / hzx100));
+  }
+
+  uint32_t ticks = (uint32_t)(secs * 1e6 / tickus);
+  std::vector<uint16_t> in(ticks);
+  std::vector<uint8_t> kind(ticks);
+  for (uint32_t t=0;t < ticks;t++) {
+    kind[t] = (frame == 1) ? SMP_CURRENT : smpSlotKind(t % frame);
+    // sampled ~1.5us after the tick
+    in[t] = quantise(waveAt((double)t * tickus + 1.5),bits);
+  }
+  std::vector<uint32_t> out(ticks); // meansq published at each tick, or ~0
+
+  uint32_t meansq;
+  acc.Read(&meansq); // skip the initial 0
+  uint64_t ns = nowNs();
+  for (uint32_t t=0;t < ticks;t++) {
+    acc.Tick(1);
+    if (kind[t] == SMP_CURRENT) acc.Sample(in[t]);
+    out[t] = acc.Read(&meansq) ? meansq : 0xffffffffUL;
+  }
+  ns = nowNs() - ns;
+
+  double truth = waveRms() / (1 << (12 - bits));
+  Result r;
+  r.ns = ns;
+  r.calls = ticks;
+  unsigned samples = 0;
+  // the first zero-crossing window starts at the 1st crossing
+  uint32_t first = (uint32_t)(2 * 1e6 / s_Wave.hz / tickus);
+  for (uint32_t t=0;t < ticks;t++) {
+    if (kind[t] == SMP_CURRENT) samples++;
+    if (out[t] != 0xffffffffUL) {
+      if (t >= first) {
+        r.samples += samples;
+        r.Add(ulong_sqrt(out[t]),truth);
+      }
+      samples = 0;
+    }
+  }
+  report(method,mode,hz,amp,r);
+}
+
+// ns per call of the ammeter math, over the mean squares readAmmeter()
+// can see (up to 2048^2) and the readings MovingAverage() gets
+static void mathBench()
+{
+  const uint32_t n = 1000000;
+  std::vector<uint32_t> in(n);
+  for (uint32_t i=0;i < n;i++) in[i] = rnd() % (2048UL * 2048UL);
+  volatile uint32_t sink = 0;
+
+  uint64_t ns = nowNs();
+  for (uint32_t i=0;i < n;i++) sink += ulong_sqrt(in[i]);
+  ns = nowNs() - ns;
+  printf("math func=ulong_sqrt calls=%u ns_per_call=%.2f\n",n,(double)ns / n);
+
+  ns = nowNs();
+  for (uint32_t i=0;i < n;i++) sink += AmmeterBench::MovingAverage(in[i] >> 11);
+  ns = nowNs() - ns;
+  printf("math func=MovingAverage calls=%u ns_per_call=%.2f\n",n,(double)ns / n);
+  (void)sink;
+}
+
+// the first reading after chargingOn()/chargingOff() has to come out of
+// MovingAverage() as is, not averaged w/ the last session's
+static void emaResetCheck()
+{
+  struct { const char *after; void (*fn)(); uint32_t prev,first; } cases[] = {
+    { "chargingOn",AmmeterBench::ChargingOn,1000,300 },
+    { "chargingOff",AmmeterBench::ChargingOff,300,0 },
+    { "chargingOn",AmmeterBench::ChargingOn,0,1000 },
+  };
+  for (unsigned c=0;c < sizeof(cases)/sizeof(cases[0]);c++) {
+    for (uint16_t i=0;i < 1000;i++) AmmeterBench::MovingAverage(cases[c].prev);
+    cases[c].fn();
+    uint32_t first = AmmeterBench::MovingAverage(cases[c].first);
+    // and it carries on averaging from there
+    uint32_t second = AmmeterBench::MovingAverage(cases[c].first);
+    int ok = (first == cases[c].first) && (second == cases[c].first);
+    if (!ok) s_Fails++;
+    printf("ema after=%s prev=%u reading=%u first=%u second=%u %s\n",
+           cases[c].after,cases[c].prev,cases[c].first,first,second,ok ? "OK" : "FAIL");
+  }
+  AmmeterBench::ChargingOff();
+}
+
+int main(int argc,char **argv)
+{
+  double secs = (argc > 1) ? atof(argv[1]) : 2;
+
+  g_Sim.Reset();
+  g_Sim.currentAdc = hostCurrentAdc;
+  // m328p analogRead(): 13 ADC clocks at 125kHz + overhead
+  g_Sim.adcUs = 112;
+
+  // ~6A and ~32A at the default calibration
+  static const double amps[] = { 220,1200 };
+  static const double hzs[] = { 50,60 };
+  static const uint8_t bits[] = { 10,12 };
+  for (unsigned s=0;s < sizeof(s_Shapes)/sizeof(s_Shapes[0]);s++) {
+    const Shape &shape = s_Shapes[s];
+    for (unsigned b=0;b < sizeof(bits);b++) {
+      for (unsigned h=0;h < sizeof(hzs)/sizeof(hzs[0]);h++) {
+        for (unsigned a=0;a < sizeof(amps)/sizeof(amps[0]);a++) {
+          blockingCase("zc",shape,hzs[h],amps[a],bits[b],secs);
+          blockingCase("locked",shape,hzs[h],amps[a],bits[b],secs);
+          backgroundCase("bg_m328p","zc",shape,hzs[h],amps[a],bits[b],secs,500,1);
+          backgroundCase("bg_m328p","locked",shape,hzs[h],amps[a],bits[b],secs,500,1);
+          backgroundCase("bg_samd","zc",shape,hzs[h],amps[a],bits[b],secs,60,SMP_FRAME_TICKS);
+          backgroundCase("bg_samd","locked",shape,hzs[h],amps[a],bits[b],secs,60,SMP_FRAME_TICKS);
+        }
+      }
+    }
+  }
+  mathBench();
+  emaResetCheck();
+
+  printf("ammeter_bench: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// B->C latency vs false B->C transitions of DEBOUNCE_SAMPLES, per
+// DEBOUNCE_CNT_C, through the whole firmware (setup()/loop()) in virtual
+// time:
+//
+//  latency  the EV goes from B to C at a random time. latency_ms = input
+//           change to GetState() == C
+//  false    the EV stays in B, and the high side of the pilot glitches to
+//           the C level for glitch_ms at random times, ~1/sec. false =
+//           times the EVSE went to C anyway
+//
+// both are started from g_Sim.onDeadline, so they can land anywhere,
+// including in the middle of an Update() pass
+//
+// period_ms is the measured EVSE Update() period, which is what a reading
+// costs: 55ms on the host (no AMMETER_BACKGROUND), 20ms w/ it. latency
+// and glitch lengths scale w/ it, so they're also printed in readings.
+//
+// passes = Update() passes from the input change to GetState() == C,
+// which has to be DEBOUNCE_CNT_C, or one more if the change came after
+// that pass read the pilot. so a count of 1 goes to C on the first reading
+//
+// prints one key=value line per case, and exits non-zero if the EVSE
+// failed to go to C, took more or fewer passes than that, or went to C on
+// glitches too short to span DEBOUNCE_CNT_C readings
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "open_evse.h"
+
+void setup();
+void loop();
+
+// runs per case
+#define LATENCY_TRIALS 20
+#define FALSE_SECS 100
+
+// input change scheduled from g_Sim.onDeadline
+static uint64_t s_AtUs,s_EndUs;
+static uint16_t s_AtRuns; // Update() passes done when it fired
+
+static int s_Fails;
+static uint32_t s_Rnd = 1;
+
+static uint32_t rnd()
+{
+  s_Rnd = s_Rnd * 1103515245UL + 12345UL;
+  return (s_Rnd >> 8) & 0xffffff;
+}
+
+static void runFor(uint32_t ms)
+{
+  uint64_t end = g_Sim.nowUs + ms * 1000ULL;
+  while (g_Sim.nowUs < end) loop();
+}
+
+// returns 0 if the EVSE didn't get there in ms
+static int until(uint8_t state,uint32_t ms)
+{
+  uint64_t end = g_Sim.nowUs + ms * 1000ULL;
+  while ((g_EvseController.GetState() != state) && (g_Sim.nowUs < end)) loop();
+  return g_EvseController.GetState() == state;
+}
+
+static void setEv(char state,uint32_t ma)
+{
+  g_Sim.evState = state;
+  g_Sim.evMa = ma;
+  g_Sim.InputsChanged();
+}
+
+static void stuck()
+{
+  printf("debounce stuck in state %u\n",g_EvseController.GetState());
+  exit(1);
+}
+
+// no InputsChanged() here, we're inside Advance(). the pilot and the
+// ammeter are only ever read through analogRead()
+static void evToC()
+{
+  s_AtRuns = g_Scheduler.GetStats(0)->runs;
+  g_Sim.evState = 'C';
+  g_Sim.evMa = 16000;
+}
+
+static void glitchEnd()
+{
+  g_Sim.pilotAdc = 0;
+}
+
+static void glitchStart()
+{
+  g_Sim.pilotAdc = HOST_PILOT_C;
+  g_Sim.deadlineUs = s_EndUs;
+  g_Sim.onDeadline = glitchEnd;
+}
+
+static void at(uint64_t us,void (*fn)())
+{
+  s_AtUs = us;
+  g_Sim.deadlineUs = us;
+  g_Sim.onDeadline = fn;
+}
+
+static void boot()
+{
+  g_Sim.rx += "$SB\r"; // BOOTLOCK: the WiFi module unlocks us
+  setup();
+  if (!until(EVSE_STATE_A,3000)) stuck();
+  setEv('B',0);
+  if (!until(EVSE_STATE_B,3000)) stuck();
+}
+
+// measured Update() period, ms
+static double updatePeriodMs()
+{
+  uint16_t runs = g_Scheduler.GetStats(0)->runs;
+  uint64_t us = g_Sim.nowUs;
+  runFor(5000);
+  return (g_Sim.nowUs - us) / 1000.0 / (uint16_t)(g_Scheduler.GetStats(0)->runs - runs);
+}
+
+static void latencyCase(uint8_t cnt,double periodms)
+{
+  uint32_t sum = 0,maxms = 0,minms = 0xffffffff;
+  uint8_t missed = 0;
+  uint16_t minpasses = 0xffff,maxpasses = 0;
+  for (uint8_t i=0;i < LATENCY_TRIALS;i++) {
+    at(g_Sim.nowUs + 200000 + rnd() % 100000,evToC);
+    if (until(EVSE_STATE_C,3300)) {
+      uint32_t ms = (uint32_t)((g_Sim.nowUs - s_AtUs) / 1000);
+      sum += ms;
+      if (ms > maxms) maxms = ms;
+      if (ms < minms) minms = ms;
+      uint16_t passes = g_Scheduler.GetStats(0)->runs - s_AtRuns;
+      if (passes > maxpasses) maxpasses = passes;
+      if (passes < minpasses) minpasses = passes;
+    }
+    else missed++;
+    setEv('B',0);
+    if (!until(EVSE_STATE_B,3000)) stuck();
+  }
+  // the pass the change lands in may already have read the pilot, so
+  // cnt readings of C take cnt or cnt+1 passes
+  int ok = !missed && (minpasses >= cnt) && (maxpasses <= cnt + 1);
+  if (!ok) s_Fails++;
+  uint8_t got = LATENCY_TRIALS - missed;
+  printf("debounce case=latency cnt=%u period_ms=%.1f trials=%u missed=%u latency_ms=%u/%u/%u latency_readings=%.1f passes=%u-%u %s\n",
+         cnt,periodms,LATENCY_TRIALS,missed,got ? minms : 0,got ? sum / got : 0,
+         got ? maxms : 0,got ? (sum / got) / periodms : 0,
+         got ? minpasses : 0,maxpasses,ok ? "OK" : "FAIL");
+}
+
+static void falseCase(uint8_t cnt,uint32_t glitchms,double periodms)
+{
+  uint64_t end = g_Sim.nowUs + FALSE_SECS * 1000000ULL;
+  uint32_t glitches = 0,falsec = 0;
+  while (g_Sim.nowUs < end) {
+    at(g_Sim.nowUs + 500000 + rnd() % 1000000,glitchStart);
+    s_EndUs = s_AtUs + glitchms * 1000ULL;
+    glitches++;
+    uint8_t wentc = 0;
+    // until the glitch is over. the last pass may still be confirming a
+    // reading from it
+    while (g_Sim.pilotAdc || (g_Sim.nowUs < s_EndUs)) {
+      loop();
+      if (g_EvseController.GetState() == EVSE_STATE_C) wentc = 1;
+    }
+    if (wentc) {
+      falsec++;
+      if (!until(EVSE_STATE_B,3000)) stuck();
+    }
+  }
+  // a glitch can cover at most glitchms/periodms + 1 readings. it's only a
+  // failure if that's too few to confirm C
+  uint32_t maxreadings = (uint32_t)(glitchms / periodms) + 1;
+  int ok = (maxreadings >= cnt) || !falsec;
+  if (!ok) s_Fails++;
+  printf("debounce case=false cnt=%u period_ms=%.1f glitch_ms=%u glitch_readings=%.1f glitches=%u false=%u false_pct=%.1f %s\n",
+         cnt,periodms,glitchms,glitchms / periodms,glitches,falsec,
+         glitches ? 100.0 * falsec / glitches : 0.0,ok ? "OK" : "FAIL");
+}
+
+int main()
+{
+  g_Sim.Reset();
+  boot();
+  double periodms = updatePeriodMs();
+
+  // glitches from a fraction of a reading up to ~5 readings
+  static const uint32_t glitchms[] = { 5,50,100,150,250 };
+  static const uint8_t cnts[] = { 1,2,3,4,6 };
+  uint8_t defcnt = g_EvseController.GetDebounceCnt(debounceIdx(EVSE_STATE_C));
+  for (unsigned c=0;c < sizeof(cnts)/sizeof(cnts[0]);c++) {
+    g_EvseController.SetDebounceCnt(debounceIdx(EVSE_STATE_C),cnts[c]);
+    latencyCase(cnts[c],periodms);
+    for (unsigned g=0;g < sizeof(glitchms)/sizeof(glitchms[0]);g++) {
+      falseCase(cnts[c],glitchms[g],periodms);
+    }
+  }
+  g_EvseController.SetDebounceCnt(debounceIdx(EVSE_STATE_C),defcnt);
+
+  printf("debounce_bench: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// RAPI dispatch latency, EvseRapiProcessor::dispatch() alone, for every
+// command in rapi_cmds.h and a few unknown ones. built twice:
+// dispatch_bench w/ RAPI_CMD_TABLE (PROGMEM lookup + handler pointer), and
+// dispatch_bench_switch w/o it (switch generated from the same list), on
+// its own copy of the firmware
+//
+// timed w/ tokenCnt = 0, which is below every command's minimum, so each
+// call does the whole lookup and arity check and then $NKs w/o running a
+// handler. ns_per_dispatch is host ns, for comparing the two builds on the
+// same machine
+//
+// also checks, untimed, that every command NKs one token over its max, and
+// that every getter w/ no arguments reaches its handler
+//
+// exits non-zero if any of those fail
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "open_evse.h"
+
+void setup();
+void loop();
+
+#define DISPATCH_RUNS 1000000
+
+#ifdef RAPI_CMD_TABLE
+#define BUILD "table"
+#else
+#define BUILD "switch"
+#endif
+
+struct Cmd {
+  const char *cmd;
+  uint8_t min,max;
+};
+
+static const Cmd s_Cmds[] = {
+#define RAPI_CMD(fam,ch,min,max) { #fam #ch,min,max },
+#include "rapi_cmds.h"
+#undef RAPI_CMD
+};
+#define CMD_CNT (sizeof(s_Cmds)/sizeof(s_Cmds[0]))
+
+// unknown char, family, both, and too short
+static const char *s_Unknown[] = { "GQ","FQ","X0","XX","G" };
+#define UNKNOWN_CNT (sizeof(s_Unknown)/sizeof(s_Unknown[0]))
+
+static int s_Fails;
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct DispatchBench {
+  static int Dispatch(const char *cmd,int8_t tokencnt) {
+    static char s[3];
+    strcpy(s,cmd);
+    for (int8_t i=0;i < ESRAPI_MAX_ARGS;i++) g_ESRP.tokens[i] = s;
+    g_ESRP.tokenCnt = tokencnt;
+    int rc = g_ESRP.dispatch();
+    g_ESRP.reset();
+    g_Sim.tx.clear();
+    return rc;
+  }
+  static double NsPer(const char *cmd) {
+    Dispatch(cmd,0);
+    uint64_t ns = nowNs();
+    for (uint32_t i=0;i < DISPATCH_RUNS;i++) g_ESRP.dispatch();
+    return (double)(nowNs() - ns) / DISPATCH_RUNS;
+  }
+};
+
+static void boot()
+{
+  g_Sim.rx += "$SB\r"; // BOOTLOCK: the WiFi module unlocks us
+  setup();
+  uint64_t end = g_Sim.nowUs + 3000000ULL;
+  while ((g_EvseController.GetState() != EVSE_STATE_A) && (g_Sim.nowUs < end)) loop();
+  if (g_EvseController.GetState() != EVSE_STATE_A) {
+    printf("dispatch stuck in state %u\n",g_EvseController.GetState());
+    exit(1);
+  }
+}
+
+int main()
+{
+  g_Sim.Reset();
+  boot();
+
+  double sum = 0,maxns = 0;
+  for (unsigned c=0;c < CMD_CNT;c++) {
+    const Cmd &cmd = s_Cmds[c];
+    int nk0 = DispatchBench::Dispatch(cmd.cmd,0) == -1;
+    int nkover = (cmd.max == RAPIC_ANY) ||
+      (DispatchBench::Dispatch(cmd.cmd,cmd.max + 1) == -1);
+    // getters w/o arguments have no side effects to speak of
+    int getok = (cmd.cmd[0] != 'G') || (cmd.min != 1) ||
+      (DispatchBench::Dispatch(cmd.cmd,1) == 0);
+    double ns = DispatchBench::NsPer(cmd.cmd);
+    sum += ns;
+    if (ns > maxns) maxns = ns;
+    int ok = nk0 && nkover && getok;
+    if (!ok) s_Fails++;
+    char max[4];
+    if (cmd.max == RAPIC_ANY) strcpy(max,"any");
+    else sprintf(max,"%u",cmd.max);
+    printf("dispatch build=%s cmd=%s tokens=%u-%s ns_per_dispatch=%.2f nk_under=%u nk_over=%u %s\n",
+           BUILD,cmd.cmd,cmd.min,max,ns,nk0,nkover,ok ? "OK" : "FAIL");
+  }
+
+  double unksum = 0;
+  for (unsigned u=0;u < UNKNOWN_CNT;u++) {
+    int nk = DispatchBench::Dispatch(s_Unknown[u],1) == -1;
+    double ns = DispatchBench::NsPer(s_Unknown[u]);
+    unksum += ns;
+    if (!nk) s_Fails++;
+    printf("dispatch build=%s cmd=%s unknown ns_per_dispatch=%.2f %s\n",
+           BUILD,s_Unknown[u],ns,nk ? "OK" : "FAIL");
+  }
+
+  printf("dispatch build=%s cmds=%u ns_avg=%.2f ns_max=%.2f unknown_ns_avg=%.2f\n",
+         BUILD,(unsigned)CMD_CNT,sum / CMD_CNT,maxns,unksum / UNKNOWN_CNT);
+
+  printf("dispatch_bench: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// loss-free capacity and cost of the ISR_EVENT_QUEUE ring (EventQueue.h):
+//
+//  burst    n events posted back to back, then drained. the ring has to
+//           hold EVQ_SIZE-1 of them in order w/ their timestamps, and drop
+//           the rest
+//  rate     events posted at a steady rate in virtual time, and drained
+//           every Update() period, like GFI edges while a fault persists.
+//           dropped = lost events, max_backlog = most events waiting at a
+//           drain, latency_us = worst post to drain time
+//  cost     host ns per Put() and per Get(), for comparing runs on the
+//           same machine
+//  gfi_race the whole firmware (setup()/loop()) in virtual time, w/o the
+//           GFI self test. the EV goes from B to C, and a ground fault
+//           starts from g_Sim.onDeadline at the n-th simulated hardware
+//           access after that, so gfi_isr can fire anywhere in an Update()
+//           pass, including between its GFI check and chargingOn() closing
+//           the relay. swept over every n up to calls_to_close (+25%).
+//           closed_on_trip = trials where the relay was driven closed
+//           after a loop() while the GFI was tripped, i.e. chargingOn()
+//           ran after gfi_isr and before drainEvents()
+//
+// prints one key=value line per case, and exits non-zero if the ring
+// lost or reordered an event it had room for, or the relay was closed on
+// a tripped GFI
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "open_evse.h"
+
+void setup();
+void loop();
+
+static int s_Fails;
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the firmware's own ring, emptied first
+static EventQueue &emptyQueue()
+{
+  ISR_EVENT ev;
+  while (g_EventQueue.Get(&ev));
+  return g_EventQueue;
+}
+
+static void burstCase(uint8_t n)
+{
+  EventQueue &q = emptyQueue();
+  uint8_t posted = 0;
+  for (uint8_t i=0;i < n;i++) {
+    g_Sim.Advance(10);
+    // the id doubles as a sequence number
+    posted += q.Put(i);
+  }
+  ISR_EVENT ev;
+  uint8_t got = 0;
+  uint8_t inorder = 1;
+  uint32_t lastus = 0;
+  while (q.Get(&ev)) {
+    if ((ev.id != got) || (got && (ev.us <= lastus))) inorder = 0;
+    lastus = ev.us;
+    got++;
+  }
+  uint8_t expect = (n < EVQ_SIZE) ? n : (EVQ_SIZE - 1);
+  int ok = (posted == expect) && (got == expect) && inorder;
+  if (!ok) s_Fails++;
+  printf("eventq case=burst size=%u events=%u kept=%u dropped=%u in_order=%u %s\n",
+         EVQ_SIZE,n,got,n - posted,inorder,ok ? "OK" : "FAIL");
+}
+
+static void rateCase(uint32_t hz,uint32_t drainms,uint32_t secs)
+{
+  EventQueue &q = emptyQueue();
+  uint64_t end = g_Sim.nowUs + secs * 1000000ULL;
+  uint64_t nextput = g_Sim.nowUs;
+  uint64_t nextdrain = g_Sim.nowUs + drainms * 1000;
+  uint32_t posted = 0,dropped = 0,drained = 0;
+  uint8_t backlog = 0,maxbacklog = 0;
+  uint32_t maxlatency = 0;
+  while (g_Sim.nowUs < end) {
+    uint64_t next = (nextput < nextdrain) ? nextput : nextdrain;
+    if (next > g_Sim.nowUs) g_Sim.Advance((uint32_t)(next - g_Sim.nowUs));
+    if (g_Sim.nowUs >= nextput) {
+      if (q.Put(EVT_GFI)) {
+        posted++;
+        backlog++;
+        if (backlog > maxbacklog) maxbacklog = backlog;
+      }
+      else dropped++;
+      nextput += 1000000UL / hz;
+    }
+    if (g_Sim.nowUs >= nextdrain) {
+      ISR_EVENT ev;
+      uint32_t now = micros();
+      while (q.Get(&ev)) {
+        if (now - ev.us > maxlatency) maxlatency = now - ev.us;
+        drained++;
+        backlog--;
+      }
+      nextdrain += drainms * 1000;
+    }
+  }
+  // the ring only has to be loss free while a drain period's worth of
+  // events fits
+  uint32_t perdrain = (hz * drainms + 999) / 1000;
+  int ok = (perdrain >= EVQ_SIZE) || !dropped;
+  if (!ok) s_Fails++;
+  printf("eventq case=rate size=%u hz=%u drain_ms=%u posted=%u dropped=%u max_backlog=%u latency_us=%u %s\n",
+         EVQ_SIZE,hz,drainms,posted,dropped,maxbacklog,maxlatency,ok ? "OK" : "FAIL");
+}
+
+static void costCase()
+{
+  const uint32_t n = 1000000;
+  EventQueue &q = emptyQueue();
+  ISR_EVENT ev;
+  uint64_t putns = 0,getns = 0;
+  for (uint32_t i=0;i < n;i += EVQ_SIZE - 1) {
+    uint64_t ns = nowNs();
+    for (uint8_t j=0;j < EVQ_SIZE - 1;j++) q.Put(EVT_GFI);
+    uint64_t ns1 = nowNs();
+    while (q.Get(&ev));
+    getns += nowNs() - ns1;
+    putns += ns1 - ns;
+  }
+  // Put() includes the host micros()
+  printf("eventq case=cost calls=%u put_ns=%.2f get_ns=%.2f\n",n,
+         (double)putns / n,(double)getns / n);
+}
+
+// gfi_race: counts Advance() calls, i.e. every millis(), micros(), pin
+// and ADC access, and starts the leak at call s_LeakAt
+static uint32_t s_Calls,s_LeakAt;
+
+static void countCalls()
+{
+  if (++s_Calls == s_LeakAt) {
+    g_Sim.gfiLeak = 1;
+    g_Sim.InputsChanged(); // gfi_isr runs now, inside whatever loop() is doing
+  }
+  g_Sim.deadlineUs = 0; // again on the next Advance()
+}
+
+// returns 0 if the EVSE didn't get there in ms
+static int until(uint8_t state,uint32_t ms)
+{
+  uint64_t end = g_Sim.nowUs + ms * 1000ULL;
+  while ((g_EvseController.GetState() != state) && (g_Sim.nowUs < end)) loop();
+  return g_EvseController.GetState() == state;
+}
+
+static void setEv(char state,uint32_t ma,uint8_t leak)
+{
+  g_Sim.evState = state;
+  g_Sim.evMa = ma;
+  g_Sim.gfiLeak = leak;
+  g_Sim.InputsChanged();
+}
+
+static void stuck()
+{
+  printf("eventq stuck in state %u\n",g_EvseController.GetState());
+  exit(1);
+}
+
+// EV B->C w/ the leak starting at call leakat (0 = never). returns the
+// calls it took to close the relay, 0 if it didn't, and sets *closedontrip
+// if the relay was driven closed w/ the GFI tripped after any loop()
+static uint32_t raceTrial(uint32_t leakat,uint8_t *closedontrip)
+{
+  setEv('B',0,0);
+  if (!until(EVSE_STATE_B,3000)) stuck();
+  s_Calls = 0;
+  s_LeakAt = leakat;
+  setEv('C',16000,0);
+  g_Sim.deadlineUs = 0;
+  g_Sim.onDeadline = countCalls;
+  uint32_t closedat = 0;
+  *closedontrip = 0;
+  uint64_t end = g_Sim.nowUs + 1000000ULL;
+  while (g_Sim.nowUs < end) {
+    loop();
+    if (g_Sim.RelayDriven()) {
+      if (!closedat) closedat = s_Calls;
+      if (g_Sim.gfiLeak) *closedontrip = 1;
+    }
+    if (!leakat && closedat) break;
+  }
+  g_Sim.onDeadline = NULL;
+  g_Sim.deadlineUs = UINT64_MAX;
+  // unplugging clears the fault
+  setEv('A',0,0);
+  if (!until(EVSE_STATE_A,3000)) stuck();
+  return closedat;
+}
+
+static void gfiRaceCase()
+{
+  g_Sim.rx += "$SB\r"; // BOOTLOCK: the WiFi module unlocks us
+  setup();
+  if (!until(EVSE_STATE_A,3000)) stuck();
+  // w/ the self test, the relay is closed by the Update() that sees it
+  // pass, which reads the GFI pin just before
+  g_EvseController.EnableGfiSelfTest(0);
+
+  uint8_t closed;
+  uint32_t calls = raceTrial(0,&closed);
+  if (!calls) stuck();
+  uint32_t trials = 0,closedontrip = 0;
+  // past the first relay close, w/ some slack for calls varying by trial
+  for (uint32_t leakat=1;leakat <= calls + calls / 4;leakat++) {
+    raceTrial(leakat,&closed);
+    trials++;
+    closedontrip += closed;
+  }
+  int ok = !closedontrip;
+  if (!ok) s_Fails++;
+  printf("eventq case=gfi_race calls_to_close=%u trials=%u closed_on_trip=%u %s\n",
+         calls,trials,closedontrip,ok ? "OK" : "FAIL");
+}
+
+int main()
+{
+  g_Sim.Reset();
+
+  for (uint8_t n=1;n <= EVQ_SIZE + 2;n++) {
+    burstCase(n);
+  }
+
+  // drained every EVSE Update() period: 20ms, or 55ms w/ the blocking
+  // ammeter (TASK_SCHEDULER). events from 10/s up to one per mains half
+  // cycle (120/240)
+  static const uint32_t drainms[] = { 20,55 };
+  static const uint32_t hzs[] = { 10,60,120,240 };
+  for (unsigned d=0;d < sizeof(drainms)/sizeof(drainms[0]);d++) {
+    for (unsigned h=0;h < sizeof(hzs)/sizeof(hzs[0]);h++) {
+      rateCase(hzs[h],drainms[d],10);
+    }
+  }
+
+  costCase();
+  gfiRaceCase();
+
+  printf("eventq_bench: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
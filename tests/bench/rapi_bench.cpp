@@ -0,0 +1,384 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// cost of a RAPI command, from the command in the serial RX buffer to the
+// response in the TX buffer (EvseRapiProcessor::doCmd()), while charging.
+// built twice: rapi_bench w/ RAPI_STREAM, and rapi_bench_sprintf w/o it,
+// on its own copy of the firmware. per command:
+//
+//  resp         the response, which has to end in the XOR checksum of the
+//               chars before it
+//  ns_per_cmd   host ns per doCmd(), for comparing the two builds on the
+//               same machine
+//  stack_bytes  peak stack doCmd() used, measured by running it on a
+//               painted stack (ucontext) and looking for the deepest
+//               overwritten byte. host (x86-64) frames, so only the
+//               difference between the builds carries over to a target
+//
+// then the same w/ RAPI_BINARY framing ($FF M 1): $GS $GG $GP $GU have to
+// return their RAPI_xx_DATA payload, w/ the values the controller has,
+// $GX a RAPI_SNAPSHOT_DATA, and int32 args have to reach the handler as
+// is ($GN 3, $SD 2 -1). every frame has to decode and carry a good CRC
+//
+// rapi_bench_sprintf write <file> saves the responses, and rapi_bench
+// check <file> fails unless its own are byte for byte the same
+//
+// exits non-zero if a response is missing, has a bad checksum/CRC, or a
+// binary payload is wrong
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#include <ucontext.h>
+#include "open_evse.h"
+
+void setup();
+void loop();
+
+#define CMD_RUNS 20000
+#define STACK_SIZE 65536
+
+#ifdef RAPI_STREAM
+#define BUILD "stream"
+#else
+#define BUILD "sprintf"
+#endif
+
+// the stream writers format $GS $GG $GP $GU $GX. $GV's text is the same
+// in both builds, only response() frames it differently, and $GQ gets $NK
+// from the dispatcher
+static const char *s_Cmds[] = {
+  "GS","GG","GP","GU","GX","GS :A5","GV","GQ"
+};
+#define CMD_CNT (sizeof(s_Cmds)/sizeof(s_Cmds[0]))
+
+static int s_Fails;
+
+static uint64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void runFor(uint32_t ms)
+{
+  uint64_t end = g_Sim.nowUs + ms * 1000ULL;
+  while (g_Sim.nowUs < end) loop();
+}
+
+static void until(uint8_t state)
+{
+  uint64_t end = g_Sim.nowUs + 3000000ULL;
+  while ((g_EvseController.GetState() != state) && (g_Sim.nowUs < end)) loop();
+  if (g_EvseController.GetState() != state) {
+    printf("rapi stuck in state %u\n",g_EvseController.GetState());
+    exit(1);
+  }
+}
+
+static void charge()
+{
+  g_Sim.rx += "$SB\r"; // BOOTLOCK: the WiFi module unlocks us
+  setup();
+  until(EVSE_STATE_A);
+  g_Sim.evState = 'B';
+  g_Sim.InputsChanged();
+  until(EVSE_STATE_B);
+  g_Sim.evState = 'C';
+  g_Sim.evMa = 16000;
+  g_Sim.InputsChanged();
+  until(EVSE_STATE_C);
+  runFor(3000);
+}
+
+static const char *s_Cmd;
+
+static void doCmd()
+{
+  g_Sim.tx.clear();
+  g_Sim.rx += '$';
+  g_Sim.rx += s_Cmd;
+  g_Sim.rx += '\r';
+  // RAPI_PIPELINE may take a call to receive it and another to run it
+  for (uint8_t i=0;(i < 3) && g_Sim.tx.empty();i++) g_ESRP.doCmd();
+}
+
+// checksum is the XOR of everything before the ^
+static int chkOk(const std::string &resp)
+{
+  size_t pos = resp.rfind('^');
+  if ((pos == std::string::npos) || (pos + 3 != resp.size())) return 0;
+  uint8_t chk = 0;
+  for (size_t i=0;i < pos;i++) chk ^= (uint8_t)resp[i];
+  return strtoul(resp.substr(pos + 1,2).c_str(),NULL,16) == chk;
+}
+
+// the last ASCII response in the TX buffer
+static std::string txResp()
+{
+  std::string resp = g_Sim.tx;
+  if (!resp.empty() && (resp[resp.size()-1] == '\r')) resp.erase(resp.size()-1);
+  return resp;
+}
+
+#ifdef RAPI_BINARY
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(const std::string &b)
+{
+  uint16_t crc = 0xffff;
+  for (size_t i=0;i < b.size();i++) {
+    crc ^= (uint16_t)(uint8_t)b[i] << 8;
+    for (uint8_t j=0;j < 8;j++) crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+  }
+  return crc;
+}
+
+// w/ the terminating 00
+static std::string cobsEncode(const std::string &raw)
+{
+  std::string enc;
+  size_t code = 0;
+  enc += '\0';
+  for (size_t i=0;i < raw.size();i++) {
+    if (raw[i]) enc += raw[i];
+    else {
+      enc[code] = (char)(enc.size() - code);
+      code = enc.size();
+      enc += '\0';
+    }
+  }
+  enc[code] = (char)(enc.size() - code);
+  enc += '\0';
+  return enc;
+}
+
+// first frame in enc, 0 if there's none
+static int cobsDecode(const std::string &enc,std::string &raw)
+{
+  raw.clear();
+  size_t i = 0;
+  while ((i < enc.size()) && enc[i]) {
+    uint8_t code = (uint8_t)enc[i++];
+    for (uint8_t j=1;j < code;j++) {
+      if ((i >= enc.size()) || !enc[i]) return 0;
+      raw += enc[i++];
+    }
+    if ((code < 0xff) && (i < enc.size()) && enc[i]) raw += '\0';
+  }
+  return i < enc.size();
+}
+
+static std::string argInt(int32_t v)
+{
+  std::string a(1,'i');
+  for (uint8_t i=0;i < 4;i++) a += (char)(v >> (i*8));
+  return a;
+}
+
+static std::string argStr(const char *str)
+{
+  return std::string(1,'s') + (char)strlen(str) + str;
+}
+
+static std::string hex(const std::string &b)
+{
+  std::string h;
+  char s[3];
+  for (size_t i=0;i < b.size();i++) {
+    sprintf(s,"%02x",(uint8_t)b[i]);
+    h += s;
+  }
+  return h;
+}
+
+static std::string s_Frame;
+
+static void doBinCmd()
+{
+  g_Sim.tx.clear();
+  g_Sim.rx += s_Frame;
+  for (uint8_t i=0;(i < 3) && g_Sim.tx.empty();i++) g_ESRP.doCmd();
+}
+
+// $<cmd> w/ args as a binary frame, seq id 5a. checks the response frame
+// and returns its status and payload. status 0xff = no good frame
+static uint8_t binCmd(const char *cmd,const std::string &args,std::string &payload)
+{
+  uint8_t c = cmd[1];
+  std::string raw(1,(char)0x5a);
+  raw += (char)((strchr("FSGT",cmd[0]) - "FSGT") << 6 |
+		((c <= '9') ? (c - '0') : (c - 'A' + 10)));
+  raw += args;
+  uint16_t crc = crc16(raw);
+  raw += (char)(crc & 0xff);
+  raw += (char)(crc >> 8);
+  s_Frame = cobsEncode(raw);
+  doBinCmd();
+
+  std::string resp;
+  payload.clear();
+  if (!cobsDecode(g_Sim.tx,resp) || (resp.size() < 4) || ((uint8_t)resp[0] != 0x5a)) return 0xff;
+  crc = crc16(resp.substr(0,resp.size()-2));
+  if (((uint8_t)resp[resp.size()-2] != (crc & 0xff)) ||
+      ((uint8_t)resp[resp.size()-1] != (crc >> 8))) return 0xff;
+  payload = resp.substr(2,resp.size()-4);
+  return (uint8_t)resp[1];
+}
+
+// wantlen = -1: payload has to be want. otherwise only its length is checked
+static void binCheck(const char *cmd,const std::string &args,uint8_t wantst,
+		     const std::string &want,int wantlen,std::string &resps)
+{
+  std::string payload;
+  uint8_t st = binCmd(cmd,args,payload);
+  int ok = (st == wantst) &&
+    ((wantlen < 0) ? (payload == want) : (payload.size() == (size_t)wantlen));
+  if (!ok) s_Fails++;
+  resps += std::string(cmd) + " " + hex(args) + " " + hex(payload) + "\n";
+  printf("rapi build=%s mode=bin cmd=%s args=%s status=%u payload=%s %s\n",
+	 BUILD,cmd,hex(args).c_str(),st,hex(payload).c_str(),ok ? "OK" : "FAIL");
+}
+
+template<typename T> static std::string bytes(const T &t)
+{
+  return std::string((const char *)&t,sizeof(t));
+}
+
+static void binary(std::string &resps)
+{
+  s_Cmd = "FF M 1";
+  doCmd();
+  if (!chkOk(txResp())) s_Fails++;
+
+  RAPI_GS_DATA gs;
+  gs.evseState = g_EvseController.GetState();
+  gs.elapsedSec = (uint32_t)g_EvseController.GetElapsedChargeTime();
+  gs.pilotState = g_EvseController.GetPilotState();
+  gs.vFlags = g_EvseController.GetVFlags();
+  binCheck("GS","",RAPIB_OK,bytes(gs),-1,resps);
+
+  RAPI_GG_DATA gg;
+  gg.chargingCurrent = g_EvseController.GetChargingCurrent();
+  gg.voltage = (int32_t)g_EvseController.GetVoltage();
+  binCheck("GG","",RAPIB_OK,bytes(gg),-1,resps);
+
+  RAPI_GP_DATA gp;
+  gp.ds3231Temp = g_TempMonitor.m_DS3231_temperature;
+  gp.mcp9808Temp = g_TempMonitor.m_MCP9808_temperature;
+  gp.tmp007Temp = g_TempMonitor.m_TMP007_temperature;
+  binCheck("GP","",RAPIB_OK,bytes(gp),-1,resps);
+
+  RAPI_GU_DATA gu;
+  gu.sessionWs = g_EnergyMeter.GetSessionWs();
+  gu.totWh = g_EnergyMeter.GetTotkWh();
+  binCheck("GU","",RAPIB_OK,bytes(gu),-1,resps);
+
+  binCheck("GX","",RAPIB_OK,"",sizeof(RAPI_SNAPSHOT_DATA),resps);
+
+  char cnt[8];
+  sprintf(cnt,"%d",(int)g_EvseController.GetDebounceCnt(debounceIdx(EVSE_STATE_C)));
+  binCheck("GN",argInt(EVSE_STATE_C),RAPIB_OK,cnt,-1,resps);
+  binCheck("SD",argInt(EVSE_STATE_B) + argInt(-1),RAPIB_NK,"",-1,resps);
+
+  // binary $GS vs the ASCII one above
+  std::string payload;
+  binCmd("GS","",payload);
+  uint64_t ns = nowNs();
+  for (uint32_t i=0;i < CMD_RUNS;i++) doBinCmd();
+  ns = nowNs() - ns;
+  printf("rapi build=%s mode=bin cmd=GS ns_per_cmd=%.1f\n",BUILD,(double)ns / CMD_RUNS);
+
+  binCheck("FF",argStr("M") + argInt(0),RAPIB_OK,"",-1,resps);
+  s_Cmd = "GV";
+  doCmd();
+  if (!chkOk(txResp())) s_Fails++;
+}
+#endif // RAPI_BINARY
+
+static ucontext_t s_Main,s_Ctx;
+static uint8_t s_Stack[STACK_SIZE];
+
+static void nop() {}
+
+// bytes of s_Stack fn touched
+static uint32_t stackUsed(void (*fn)())
+{
+  memset(s_Stack,0xa5,sizeof(s_Stack));
+  getcontext(&s_Ctx);
+  s_Ctx.uc_stack.ss_sp = s_Stack;
+  s_Ctx.uc_stack.ss_size = sizeof(s_Stack);
+  s_Ctx.uc_link = &s_Main;
+  makecontext(&s_Ctx,fn,0);
+  swapcontext(&s_Main,&s_Ctx);
+  uint32_t i = 0;
+  while ((i < sizeof(s_Stack)) && (s_Stack[i] == 0xa5)) i++;
+  return sizeof(s_Stack) - i;
+}
+
+int main(int argc,char **argv)
+{
+  g_Sim.Reset();
+  charge();
+
+  std::string resps;
+  uint32_t stack0 = stackUsed(nop);
+  for (unsigned c=0;c < CMD_CNT;c++) {
+    s_Cmd = s_Cmds[c];
+    doCmd();
+    std::string resp = txResp();
+    resps += resp + "\n";
+
+    uint64_t ns = nowNs();
+    for (uint32_t i=0;i < CMD_RUNS;i++) doCmd();
+    ns = nowNs() - ns;
+
+    uint32_t stack = stackUsed(doCmd) - stack0;
+    int ok = chkOk(resp);
+    if (!ok) s_Fails++;
+    printf("rapi build=%s cmd=%s resp=\"%s\" ns_per_cmd=%.1f stack_bytes=%u %s\n",
+           BUILD,s_Cmd,resp.c_str(),(double)ns / CMD_RUNS,stack,ok ? "OK" : "FAIL");
+  }
+#ifdef RAPI_BINARY
+  binary(resps);
+#endif
+
+  if ((argc == 3) && !strcmp(argv[1],"write")) {
+    FILE *fp = fopen(argv[2],"w");
+    if (!fp || (fputs(resps.c_str(),fp) < 0)) s_Fails++;
+    if (fp) fclose(fp);
+  }
+  else if ((argc == 3) && !strcmp(argv[1],"check")) {
+    std::string want;
+    FILE *fp = fopen(argv[2],"r");
+    if (fp) {
+      char line[256];
+      while (fgets(line,sizeof(line),fp)) want += line;
+      fclose(fp);
+    }
+    int same = fp && (want == resps);
+    if (!same) s_Fails++;
+    printf("rapi build=%s same_as=%s %s\n",BUILD,argv[2],same ? "OK" : "FAIL");
+  }
+
+  printf("rapi_bench: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
@@ -0,0 +1,538 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// fuzzes the EVSE state machine on the host build. every input starts from
+// the same booted, idle EVSE (state A, POST done) and is a list of ops that
+// change the simulated EV/mains/relay/GFI inputs, feed RAPI bytes and step
+// J1772EVSEController::Update() in virtual time. the invariants in
+// doc/process.md are checked after every pass.
+//
+// op byte: bits 7-5 op, bits 4-0 p
+//  0 STEP   (p>>3)+1 steps of s_StepMs[p&7] each, a pass every 20ms
+//  1 EV     pilot state 'A'+(p&3), diode shorted if p&4. drops ADC
+//  2 INPUT  toggle s_Inputs[p&7]
+//  3 ADC    pilot high side reads (p<<7)|(next byte&0x7f)
+//  4 LOAD   EV draws p*2A
+//  5 TEMP   ambient p*4C
+//  6 RAPI   the next p+1 bytes go to the serial port as is
+//  7 CMD    s_Cmds[p] goes to the serial port
+//
+// built w/ -DOPENEVSE_FUZZ=ON (clang), it's a libFuzzer target:
+//  rapi_fuzz -jobs=8 -workers=8 corpus
+// otherwise it's a standalone driver w/ the same ops:
+//  rapi_fuzz [-runs=n] [-seed=n] [-shard=i/n] [-maxlen=n] [-trace] [file|dir]...
+// replays the files, then runs n random inputs - half mutated from the
+// files - from seed+i. -shard=i/n replays every n'th file from the i'th.
+// -minimize=file shrinks a failing input to file.min
+//
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "open_evse.h"
+
+void setup();
+
+static const uint16_t s_StepMs[8] = { 1,5,20,55,100,250,1000,5000 };
+
+static uint8_t *const s_Inputs[8] = {
+  &g_Sim.acLive,&g_Sim.gndOk,&g_Sim.relayWelded,&g_Sim.relayStuckOpen,
+  &g_Sim.gfiLeak,&g_Sim.gfiTestCt,&g_Sim.tempSensor,&g_Sim.evDiode
+};
+
+static const char *const s_Cmds[32] = {
+  "$FD\r","$FE\r","$FS\r","$FR\r","$S4 1\r","$S4 0\r","$SC 6\r","$SC 80\r",
+  "$SC 16 V\r","$SL 1\r","$SL 2\r","$SL A\r","$FF D 0\r","$FF G 0\r",
+  "$FF R 0\r","$FF F 0\r","$FF T 1\r","$FF V 0\r","$FF Z 0\r","$FF O 1\r",
+  "$S3 1\r","$SH 1\r","$SD 1 1\r","$SD 2 60\r","$SY 1 6\r","$SY\r",
+  "$FC\r","$SA 0 0\r","$S2 1\r","$GS\r","$GG\r","$FO 300 350\r"
+};
+
+//
+// the firmware has no power on reset for its globals, so the harness
+// saves and restores them. everything Update()/RapiDoCmd() keep state in,
+// except statics private to a function or file: what RapiSendEvseState()
+// last sent and the LCD refresh timers. those carry over from input to
+// input, so files are replayed and minimized in a child forked from a
+// clean boot, and a random input that fails is rechecked there too
+//
+struct SAVED_OBJ {
+  void *p;
+  size_t len;
+};
+#define SAVE(o) { (void *)&o,sizeof(o) }
+static const SAVED_OBJ s_Objs[] = {
+  SAVE(g_EvseController),
+  SAVE(g_ESRP),
+  SAVE(g_EventQueue),
+  SAVE(g_ZcTracker),
+  SAVE(g_LatencyStats),
+  SAVE(g_EnergyMeter),
+  SAVE(g_OBD),
+  SAVE(g_ACCController),
+  SAVE(g_TempMonitor),
+  SAVE(g_Scheduler),
+  SAVE(g_hasCGMI),
+  SAVE(Wire),
+  SAVE(g_HostTarget),
+};
+#define OBJ_CNT (sizeof(s_Objs)/sizeof(s_Objs[0]))
+
+struct SNAPSHOT {
+  std::vector<uint8_t> objs;
+  HostSim sim;
+  void Save() {
+    objs.clear();
+    for (unsigned i=0;i < OBJ_CNT;i++) {
+      const uint8_t *p = (const uint8_t *)s_Objs[i].p;
+      objs.insert(objs.end(),p,p + s_Objs[i].len);
+    }
+    sim = g_Sim;
+  }
+  void Restore() {
+    const uint8_t *p = objs.data();
+    for (unsigned i=0;i < OBJ_CNT;i++) {
+      memcpy(s_Objs[i].p,p,s_Objs[i].len);
+      p += s_Objs[i].len;
+    }
+    g_Sim = sim;
+  }
+};
+
+static SNAPSHOT s_PowerOn; // constructed globals, before setup()
+static SNAPSHOT s_Ready;   // booted and idle in state A
+static uint32_t s_WdtBites;
+static const char *s_Fail;
+static unsigned long long s_Updates; // passes, so Update() calls
+static uint8_t s_Trace; // print each pass
+
+static void fail(const char *msg)
+{
+  if (!s_Fail) s_Fail = msg;
+}
+
+// power cycle: back to the constructed globals w/ the simulated inputs and
+// EEPROM kept, then setup(). boot lock is turned off in EEPROM so setup()
+// returns right away and POST runs from Update() like the rest of the ops
+static void powerOn()
+{
+  HostSim sim = g_Sim;
+  s_PowerOn.Restore();
+  g_Sim = sim;
+  g_Sim.rx.clear();
+  g_Sim.tx.clear();
+  g_Sim.pilotPwm = 0;
+  memset(g_Sim.pinOut,0,sizeof(g_Sim.pinOut));
+  g_Sim.IrqEnable(1);
+  g_Sim.TimerCancel(HOST_TIMER_RELAY);
+  g_Sim.TimerCancel(HOST_TIMER_GFI);
+  g_Sim.WdtEnable(0);
+
+  uint16_t flags = eeprom_read_word((uint16_t *)EOFS_FLAGS);
+  if (flags == 0xffff) flags = ECF_DEFAULT;
+  eeprom_write_word((uint16_t *)EOFS_FLAGS,flags | ECF_BOOT_LOCK_DISABLED);
+
+  setup();
+  s_WdtBites = g_Sim.wdtBites;
+}
+
+static void checkWdt()
+{
+  if (g_Sim.wdtBites == s_WdtBites) return;
+  // Reboot() lets the 1 sec watchdog bite. anything else is a hang
+  if (g_Sim.WdtMs() == 1000) powerOn();
+  else fail("watchdog timeout");
+  s_WdtBites = g_Sim.wdtBites;
+}
+
+static void checkInvariants()
+{
+  J1772EVSEController &evse = g_EvseController;
+  if (evse.RelayIsClosed()) {
+    if (evse.InFaultState() && !evse.FaultShutdownPending()) fail("relay closed in fault state");
+    if (evse.PostIsRunning()) fail("relay closed during POST");
+    if (evse.GfiSelfTestActive()) fail("relay closed during GFI self test");
+  }
+  // faults leave the lock for later, and stuck relay keeps the pilot as is
+  if (evse.AuthLockIsOn() && !evse.InFaultState() && g_Sim.pilotPwm) fail("pilot PWM while auth locked");
+  if ((evse.GetState() == EVSE_STATE_DISABLED) &&
+      (g_Sim.pilotPwm || g_Sim.pinOut[HOST_PIN_PILOT])) fail("pilot not N12 in DISABLED");
+}
+
+// one pass of the EVSE/RAPI/temperature tasks loop() would run
+static void pass()
+{
+  g_EvseController.Update();
+  if (Serial.available()) RapiDoCmd();
+#ifdef TEMPERATURE_MONITORING
+  g_TempMonitor.Read();
+#endif
+  checkWdt();
+  if (s_Trace) {
+    printf("t=%llu state %d relay %d pilot %s duty %u rx \"%s\" tx %s",
+           (unsigned long long)(g_Sim.nowUs / 1000),g_EvseController.GetState(),
+           g_EvseController.RelayIsClosed(),
+           g_Sim.pilotPwm ? "PWM" : (g_Sim.pinOut[HOST_PIN_PILOT] ? "P12" : "N12"),
+           g_Sim.pilotDutyUs,g_Sim.rx.c_str(),g_Sim.tx.c_str());
+    if (g_Sim.tx.empty() || (g_Sim.tx.back() != '\n')) printf("\n");
+  }
+  g_Sim.tx.clear();
+  s_Updates++;
+  checkInvariants();
+}
+
+// ms of virtual time, w/ a pass at least every PASS_MS like loop() runs
+// the EVSE task. the debounce counts Update() calls, so fewer passes
+// would never see the EV change state
+#define PASS_MS 20
+static void step(uint32_t ms)
+{
+  for (uint32_t t=0;(t < ms) && !s_Fail;t += PASS_MS) {
+    g_Sim.Advance((((ms - t) < PASS_MS) ? (ms - t) : PASS_MS) * 1000UL);
+    checkWdt();
+    g_Sim.WdtReset();
+    pass();
+  }
+}
+
+static void init()
+{
+  static uint8_t done;
+  if (done) return;
+  done = 1;
+
+  s_PowerOn.Save();
+  powerOn();
+  for (int i=0;(i < 10000) && g_EvseController.PostIsRunning();i++) step(1);
+  for (int i=0;(i < 100) && (g_EvseController.GetState() != EVSE_STATE_A);i++) step(55);
+  if (g_EvseController.GetState() != EVSE_STATE_A) {
+    fprintf(stderr,"rapi_fuzz: boot failed, state %d\n",g_EvseController.GetState());
+    abort();
+  }
+  s_Ready.Save();
+}
+
+// returns NULL or the invariant that failed
+static const char *runInput(const uint8_t *data,size_t size)
+{
+  init();
+  s_Ready.Restore();
+  s_WdtBites = g_Sim.wdtBites;
+  s_Fail = NULL;
+
+  const uint8_t *end = data + size;
+  while ((data < end) && !s_Fail) {
+    uint8_t op = *data >> 5;
+    uint8_t p = *data++ & 0x1f;
+    switch(op) {
+    case 0:
+      for (int n=(p >> 3)+1;n && !s_Fail;n--) step(s_StepMs[p & 7]);
+      break;
+    case 1:
+      g_Sim.evState = 'A' + (p & 3);
+      g_Sim.evDiode = (p & 4) ? 0 : 1;
+      g_Sim.pilotAdc = 0;
+      break;
+    case 2:
+      *s_Inputs[p & 7] ^= 1;
+      break;
+    case 3:
+      if (data < end) g_Sim.pilotAdc = (p << 7) | (*data++ & 0x7f);
+      break;
+    case 4:
+      g_Sim.evMa = p * 2000UL;
+      break;
+    case 5:
+      g_Sim.tempC10 = p * 40;
+      break;
+    case 6:
+      for (int n=p+1;n && (data < end);n--) g_Sim.rx += (char)*data++;
+      break;
+    default:
+      g_Sim.rx += s_Cmds[p];
+    }
+    g_Sim.InputsChanged();
+  }
+  return s_Fail;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data,size_t size)
+{
+  const char *msg = runInput(data,size);
+  if (msg) {
+    fprintf(stderr,"rapi_fuzz: %s (state %d, t=%llums)\n",msg,
+            g_EvseController.GetState(),(unsigned long long)(g_Sim.nowUs / 1000));
+    abort();
+  }
+  return 0;
+}
+
+#ifndef OPENEVSE_LIBFUZZER
+typedef std::vector<uint8_t> FUZZ_INPUT;
+
+static uint32_t s_Rand;
+static uint32_t xrand()
+{
+  s_Rand ^= s_Rand << 13;
+  s_Rand ^= s_Rand >> 17;
+  s_Rand ^= s_Rand << 5;
+  return s_Rand;
+}
+
+static int readFile(const char *fn,FUZZ_INPUT &in)
+{
+  FILE *fp = fopen(fn,"rb");
+  if (!fp) return -1;
+  in.clear();
+  int c;
+  while ((c = fgetc(fp)) != EOF) in.push_back(c);
+  fclose(fp);
+  return 0;
+}
+
+static void addPath(const char *path,std::vector<std::string> &files)
+{
+  DIR *dir = opendir(path);
+  if (!dir) {
+    files.push_back(path);
+    return;
+  }
+  std::vector<std::string> names;
+  struct dirent *de;
+  while ((de = readdir(dir)) != NULL) {
+    if (de->d_name[0] != '.') names.push_back(std::string(path) + "/" + de->d_name);
+  }
+  closedir(dir);
+  std::sort(names.begin(),names.end());
+  files.insert(files.end(),names.begin(),names.end());
+}
+
+// input being run, saved to crash-signal if the firmware crashes
+static const FUZZ_INPUT *s_Cur;
+
+static void onSignal(int sig)
+{
+  int fd = s_Cur ? open("crash-signal",O_WRONLY|O_CREAT|O_TRUNC,0644) : -1;
+  if (fd >= 0) {
+    if (write(fd,s_Cur->data(),s_Cur->size()) < 0) {}
+    close(fd);
+    static const char msg[] = "rapi_fuzz: crashed, input saved to crash-signal\n";
+    if (write(2,msg,sizeof(msg)-1) < 0) {}
+  }
+  signal(sig,SIG_DFL);
+  raise(sig);
+}
+
+static int runOne(const char *name,const FUZZ_INPUT &in)
+{
+  s_Cur = &in;
+  const char *msg = runInput(in.data(),in.size());
+  s_Cur = NULL;
+  if (!msg) return 0;
+  printf("%s: %s (state %d, t=%llums)\n",name,msg,g_EvseController.GetState(),
+         (unsigned long long)(g_Sim.nowUs / 1000));
+  return 1;
+}
+
+// runs in in a child, so crashes can be minimized too. returns "" if
+// it passes, else the invariant that failed or the signal
+static std::string tryInput(const FUZZ_INPUT &in)
+{
+  int fd[2];
+  if (pipe(fd)) {
+    perror("pipe");
+    exit(2);
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (!pid) {
+    close(fd[0]);
+    s_Cur = NULL; // the parent has the input
+    unsigned long long updates0 = s_Updates;
+    const char *msg = runInput(in.data(),in.size());
+    // the Update() count, then the message
+    unsigned long long updates = s_Updates - updates0;
+    if (write(fd[1],&updates,sizeof(updates)) < 0) {}
+    if (msg && (write(fd[1],msg,strlen(msg)) < 0)) {}
+    fflush(stdout);
+    _exit(0);
+  }
+  close(fd[1]);
+  std::string msg;
+  char buf[64];
+  ssize_t n;
+  while ((n = read(fd[0],buf,sizeof(buf))) > 0) msg.append(buf,n);
+  close(fd[0]);
+  if (msg.size() >= sizeof(unsigned long long)) {
+    unsigned long long updates;
+    memcpy(&updates,msg.data(),sizeof(updates));
+    s_Updates += updates;
+    msg.erase(0,sizeof(updates));
+  }
+  int status;
+  waitpid(pid,&status,0);
+  if (WIFSIGNALED(status)) msg = std::string("signal ") + strsignal(WTERMSIG(status));
+  return msg;
+}
+
+// drops runs of bytes, halving the run length down to 1, while the
+// input keeps failing the same way
+static void minimize(const char *fn)
+{
+  FUZZ_INPUT in;
+  if (readFile(fn,in)) {
+    perror(fn);
+    exit(2);
+  }
+  init();
+  std::string msg = tryInput(in);
+  if (msg.empty()) {
+    printf("%s: doesn't fail\n",fn);
+    exit(1);
+  }
+  for (size_t len=in.size() / 2;len;len /= 2) {
+    for (size_t i=in.size();i-- > 0;) {
+      if (i + len > in.size()) continue;
+      FUZZ_INPUT t = in;
+      t.erase(t.begin() + i,t.begin() + i + len);
+      if (tryInput(t) == msg) in = t;
+    }
+  }
+  std::string out = std::string(fn) + ".min";
+  FILE *fp = fopen(out.c_str(),"wb");
+  if (!fp || (fwrite(in.data(),1,in.size(),fp) != in.size())) {
+    perror(out.c_str());
+    exit(2);
+  }
+  fclose(fp);
+  printf("%s: %u bytes, %s\n",out.c_str(),(unsigned)in.size(),msg.c_str());
+  exit(0);
+}
+
+int main(int argc,char *argv[])
+{
+  unsigned long runs = 0;
+  unsigned long seed = 1;
+  unsigned shard = 0,shards = 1;
+  unsigned maxlen = 256;
+  uint8_t trace = 0;
+  std::vector<std::string> files;
+
+  for (int i=1;i < argc;i++) {
+    const char *a = argv[i];
+    if (!strncmp(a,"-runs=",6)) runs = strtoul(a+6,NULL,0);
+    else if (!strncmp(a,"-seed=",6)) seed = strtoul(a+6,NULL,0);
+    else if (!strncmp(a,"-maxlen=",8)) maxlen = strtoul(a+8,NULL,0);
+    else if (!strncmp(a,"-shard=",7)) {
+      if ((sscanf(a+7,"%u/%u",&shard,&shards) != 2) || (shard >= shards)) {
+        fprintf(stderr,"bad %s\n",a);
+        return 2;
+      }
+    }
+    else if (!strncmp(a,"-minimize=",10)) minimize(a+10);
+    else if (!strcmp(a,"-trace")) trace = 1;
+    else if (a[0] == '-') {
+      fprintf(stderr,"usage: %s [-runs=n] [-seed=n] [-shard=i/n] [-maxlen=n] [-minimize=file] [-trace] [file|dir]...\n",argv[0]);
+      return 2;
+    }
+    else addPath(a,files);
+  }
+
+  signal(SIGSEGV,onSignal);
+  signal(SIGFPE,onSignal);
+  signal(SIGBUS,onSignal);
+  signal(SIGABRT,onSignal);
+
+  struct timespec t0,t1;
+  clock_gettime(CLOCK_MONOTONIC,&t0);
+  init();
+  s_Trace = trace;
+  unsigned long long updates0 = s_Updates;
+  unsigned long inputs = 0;
+  int rc = 0;
+
+  std::vector<FUZZ_INPUT> corpus;
+  for (size_t i=0;i < files.size();i++) {
+    FUZZ_INPUT in;
+    if (readFile(files[i].c_str(),in)) {
+      perror(files[i].c_str());
+      return 2;
+    }
+    corpus.push_back(in);
+    if ((i % shards) != shard) continue;
+    std::string msg = tryInput(in);
+    if (!msg.empty()) {
+      printf("%s: %s\n",files[i].c_str(),msg.c_str());
+      rc = 1;
+    }
+    inputs++;
+  }
+
+  s_Rand = (uint32_t)(seed + shard) * 2654435761u | 1;
+  for (unsigned long r=0;!rc && (r < runs);r++) {
+    FUZZ_INPUT in;
+    if (!corpus.empty() && (xrand() & 1)) {
+      in = corpus[xrand() % corpus.size()];
+      for (int n=xrand() % 8 + 1;n;n--) {
+        uint32_t x = xrand();
+        size_t pos = in.empty() ? 0 : (x >> 8) % in.size();
+        switch(x & 3) {
+        case 0: if (!in.empty()) in[pos] ^= 1 << ((x >> 4) & 7); break;
+        case 1: if (!in.empty()) in.erase(in.begin() + pos); break;
+        default: in.insert(in.begin() + pos,(uint8_t)(x >> 24));
+        }
+      }
+      if (in.size() > maxlen) in.resize(maxlen);
+    }
+    else {
+      for (unsigned n=xrand() % maxlen + 1;n;n--) in.push_back(xrand());
+    }
+    if (runOne("random",in)) {
+      rc = 1;
+      char fn[64];
+      snprintf(fn,sizeof(fn),"crash-%lu-%u-%lu",seed,shard,r);
+      FILE *fp = fopen(fn,"wb");
+      if (fp) {
+        fwrite(in.data(),1,in.size(),fp);
+        fclose(fp);
+        printf("saved %s\n",fn);
+      }
+      std::string msg = tryInput(in);
+      printf("%s from a clean boot: %s\n",fn,
+             msg.empty() ? "passes, depends on state left by earlier inputs" : msg.c_str());
+    }
+    inputs++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC,&t1);
+  double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+  unsigned long long updates = s_Updates - updates0;
+  printf("rapi_fuzz: shard %u/%u inputs %lu updates %llu sec %.3f updates/s %.0f %s\n",
+         shard,shards,inputs,updates,sec,sec ? updates / sec : 0,rc ? "FAIL" : "OK");
+  return rc;
+}
+#endif // !OPENEVSE_LIBFUZZER
@@ -0,0 +1,145 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// exhaustive sweep of the PILOT_HYSTERESIS classifier (PilotBand.h) over
+// every ADC code and every previous state, w/ the m328p and SAMD
+// thresholds (CMakeLists.txt reads them from their target.h). every
+// reading has to match:
+//
+//  - w/ no previous state, the plain threshold compare Update() does
+//    w/o PILOT_HYSTERESIS
+//  - w/ a previous state, a walk from that state which only crosses a
+//    boundary once the reading is PILOT_HYST past it
+//
+// and per previous state the bands have to be monotonic in the code, and
+// a reading in the previous state's own plain band has to stay there.
+// the targets agree if both pass, and both go A, B, C, D (and the same
+// hysteresis runs) from the top code down for every previous state
+//
+// prints a result and a band line per target, and exits non-zero if
+// anything failed
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "PilotBand.h"
+
+#define PREV_CNT 5 // A-D, and unknown
+static const uint8_t s_Prev[PREV_CNT] = { 0,1,2,3,0xff };
+
+struct Target {
+  const char *name;
+  uint16_t adcmax;
+  uint16_t ab,bc,cd;
+  uint16_t hyst;
+};
+
+// PILOT_HYST in open_evse.h
+#define HYST(adcmax) ((adcmax)/128)
+
+static const Target s_Targets[] = {
+  { "m328p",m328p_ADC_MAX,m328p_PILOT_THRESH_AB,m328p_PILOT_THRESH_BC,
+    m328p_PILOT_THRESH_CD,HYST(m328p_ADC_MAX) },
+  { "samd",samd_ADC_MAX,samd_PILOT_THRESH_AB,samd_PILOT_THRESH_BC,
+    samd_PILOT_THRESH_CD,HYST(samd_ADC_MAX) },
+};
+
+static int s_Fails;
+
+static uint8_t plainBand(const Target &t,uint16_t code)
+{
+  if (code >= t.ab) return 0;
+  if (code >= t.bc) return 1;
+  if (code >= t.cd) return 2;
+  return 3;
+}
+
+static uint8_t walkBand(const Target &t,uint16_t code,uint8_t prev)
+{
+  if (prev > 3) return plainBand(t,code);
+  const uint16_t thresh[3] = { t.ab,t.bc,t.cd };
+  uint8_t band = prev;
+  while ((band < 3) && (code < thresh[band] - t.hyst)) band++;
+  while ((band > 0) && (code >= thresh[band-1] + t.hyst)) band--;
+  return band;
+}
+
+// returns the band sequence from the top code down, w/ the code each band
+// starts at, per previous state
+static std::string sweep(const Target &t)
+{
+  const uint16_t tbl[3][3] = PILOT_BAND_TABLE(t.ab,t.bc,t.cd,t.hyst);
+  unsigned mismatches = 0,nonmonotonic = 0,unstable = 0;
+  std::string sig;
+  for (uint8_t p=0;p < PREV_CNT;p++) {
+    uint8_t prev = s_Prev[p];
+    uint8_t last = 0;
+    sig += (prev > 3) ? '?' : (char)('A' + prev);
+    sig += ':';
+    for (int code=t.adcmax;code >= 0;code--) {
+      uint8_t band = pilotBandOf(tbl,(uint16_t)code,prev);
+      if (band != walkBand(t,code,prev)) mismatches++;
+      if ((code < t.adcmax) && (band < last)) nonmonotonic++;
+      if ((prev <= 3) && (plainBand(t,code) == prev) && (band != prev)) unstable++;
+      if ((code == t.adcmax) || (band != last)) {
+        char s[16];
+        // where the band starts, relative to the boundary it crossed
+        if (code == t.adcmax) sprintf(s,"%c",'A' + band);
+        else {
+          const uint16_t thresh[3] = { t.ab,t.bc,t.cd };
+          sprintf(s,"%c%+d",'A' + band,(int)(code + 1) - (int)thresh[band-1]);
+        }
+        sig += s;
+        sig += ' ';
+      }
+      last = band;
+    }
+    sig += "| ";
+  }
+  // hysteresis runs are in units of hyst, so the targets can be compared
+  std::string norm;
+  for (size_t i=0;i < sig.size();i++) {
+    if (((sig[i] == '+') || (sig[i] == '-')) && (i + 1 < sig.size())) {
+      int v = atoi(sig.c_str() + i);
+      norm += (v == 0) ? "0" : ((v == t.hyst) ? "+h" : ((v == -t.hyst) ? "-h" : "?"));
+      while ((i + 1 < sig.size()) && (sig[i+1] >= '0') && (sig[i+1] <= '9')) i++;
+    }
+    else norm += sig[i];
+  }
+  int ok = !mismatches && !nonmonotonic && !unstable;
+  if (!ok) s_Fails++;
+  printf("pilotband target=%s adc_max=%u ab=%u bc=%u cd=%u hyst=%u codes=%u prev_states=%u mismatches=%u nonmonotonic=%u unstable=%u %s\n",
+         t.name,t.adcmax,t.ab,t.bc,t.cd,t.hyst,t.adcmax + 1,PREV_CNT,
+         mismatches,nonmonotonic,unstable,ok ? "OK" : "FAIL");
+  printf("pilotband target=%s bands=%s\n",t.name,norm.c_str());
+  return norm;
+}
+
+int main()
+{
+  std::string sig0 = sweep(s_Targets[0]);
+  std::string sig1 = sweep(s_Targets[1]);
+  int agree = (sig0 == sig1);
+  if (!agree) s_Fails++;
+  printf("pilotband targets_agree=%u %s\n",agree,agree ? "OK" : "FAIL");
+
+  printf("pilotband: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// the RAPI_STREAM number formatters (RapiFmt.h) vs the sprintf() formats
+// they replace:
+//
+//  dec   rapiFmtDec() vs %ld
+//  udec  rapiFmtUDec() vs %lu
+//  hex   rapiFmtHex() vs %0<width>x and %0<width>X, width 1-8
+//
+// on every value near a digit boundary (10^n, 16^n, +/-1) and the int32
+// and uint32 limits, then RAPI_FMT_RANDOM random values. the returned
+// length has to match too
+//
+// prints one result line per formatter, and exits non-zero if any output
+// differed
+//
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "RapiFmt.h"
+
+#define RAPI_FMT_RANDOM 1000000
+
+static int s_Fails;
+static uint32_t s_Rnd = 1;
+
+static uint32_t rnd()
+{
+  s_Rnd = s_Rnd * 1103515245UL + 12345UL;
+  return s_Rnd;
+}
+
+static std::vector<uint32_t> values()
+{
+  std::vector<uint32_t> v;
+  for (uint64_t p=1;p <= 0xffffffffULL;p *= 10) {
+    v.push_back((uint32_t)p - 1);
+    v.push_back((uint32_t)p);
+    v.push_back((uint32_t)p + 1);
+  }
+  for (uint64_t p=1;p <= 0xffffffffULL;p *= 16) {
+    v.push_back((uint32_t)p - 1);
+    v.push_back((uint32_t)p);
+    v.push_back((uint32_t)p + 1);
+  }
+  // int32 limits and their neighbours
+  v.push_back(0x7ffffffe);
+  v.push_back(0x7fffffff);
+  v.push_back(0x80000000);
+  v.push_back(0x80000001);
+  v.push_back(0xfffffffe);
+  v.push_back(0xffffffff);
+  // mixed random magnitudes, so short numbers are as common as long ones
+  for (uint32_t i=0;i < RAPI_FMT_RANDOM;i++) {
+    v.push_back(rnd() >> (rnd() % 32));
+  }
+  return v;
+}
+
+static void report(const char *name,unsigned cnt,unsigned mismatches,
+                   const char *first)
+{
+  int ok = !mismatches;
+  if (!ok) s_Fails++;
+  printf("rapifmt fmt=%s values=%u mismatches=%u%s%s %s\n",name,cnt,
+         mismatches,ok ? "" : " first=",ok ? "" : first,ok ? "OK" : "FAIL");
+}
+
+int main()
+{
+  std::vector<uint32_t> v = values();
+  char want[32],got[32],first[80];
+  unsigned mismatches;
+
+  mismatches = 0;
+  for (size_t i=0;i < v.size();i++) {
+    int32_t x = (int32_t)v[i];
+    int n = sprintf(want,"%ld",(long)x);
+    uint8_t len = rapiFmtDec(got,x);
+    if ((len != n) || (len >= RAPI_FMT_DEC_LEN) || strcmp(got,want)) {
+      if (!mismatches++) snprintf(first,sizeof(first),"%s/%s",got,want);
+    }
+  }
+  report("dec",v.size(),mismatches,first);
+
+  mismatches = 0;
+  for (size_t i=0;i < v.size();i++) {
+    int n = sprintf(want,"%lu",(unsigned long)v[i]);
+    uint8_t len = rapiFmtUDec(got,v[i]);
+    if ((len != n) || (len >= RAPI_FMT_DEC_LEN) || strcmp(got,want)) {
+      if (!mismatches++) snprintf(first,sizeof(first),"%s/%s",got,want);
+    }
+  }
+  report("udec",v.size(),mismatches,first);
+
+  mismatches = 0;
+  unsigned cnt = 0;
+  for (size_t i=0;i < v.size();i++) {
+    for (uint8_t width=1;width <= 8;width++) {
+      for (uint8_t upper=0;upper < 2;upper++) {
+        int n = sprintf(want,upper ? "%0*lX" : "%0*lx",width,(unsigned long)v[i]);
+        uint8_t len = rapiFmtHex(got,v[i],width,upper ? 'A' : 'a');
+        if ((len != n) || (len >= RAPI_FMT_HEX_LEN) || strcmp(got,want)) {
+          if (!mismatches++) snprintf(first,sizeof(first),"%s/%s",got,want);
+        }
+        cnt++;
+      }
+    }
+  }
+  report("hex",cnt,mismatches,first);
+
+  printf("rapifmt: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
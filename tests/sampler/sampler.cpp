@@ -0,0 +1,361 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// feeds synthetic waveforms through the background sampler's accumulators
+// (firmware/open_evse/AdcSampler.h), on the same tick and frame schedule as
+// the SAMD TC3 ISR (AMMETER_BACKGROUND + PILOT_ADC_TRIGGER):
+//
+//  ammeter  50/60Hz sines w/ 12-bit quantisation and noise, in zero-crossing
+//           and cycle-locked windows, w/ and w/o foreground pauses, and no
+//           signal at all. every reading must be within tolerance of the
+//           true RMS
+//  pilot    1kHz PWM at every duty cycle J1772Pilot::SetPWM() produces,
+//           w/ slewed edges, at many phases of the PWM relative to the
+//           ticks, and steady P12/N12. every window's min/max must be the
+//           low/high plateau
+//
+// prints one line per case, and exits non-zero if any case failed
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "AdcSampler.h"
+#include "AmmeterMath.h"
+
+// same as the SAMD target
+#define TICK_US 60
+#define SAMPLE_HZ (1000000UL / TICK_US)
+#define ADC_HALF 2048
+#define ADC_MAX 4095
+#define ZERO_DEBOUNCE_TICKS ((5 * 1000UL) / TICK_US) // CURRENT_ZERO_DEBOUNCE_INTERVAL
+#define TIMEOUT_TICKS ((35 * 1000UL) / TICK_US) // CURRENT_SAMPLE_INTERVAL
+#define MAX_SKIP_TICKS (1000UL / TICK_US)
+#define LOCK_CYCLES 3 // AMMETER_LOCK_CYCLES w/ AMMETER_BACKGROUND
+#define PILOT_WINDOW_SAMPLES 50
+#define S_H_US 1.5 // ISR entry + SWTRIG to the middle of the sampling time
+
+static uint32_t s_Rand = 1;
+static uint32_t rnd()
+{
+  s_Rand = s_Rand * 1103515245UL + 12345UL;
+  return s_Rand >> 8;
+}
+static double rndUnit() { return (rnd() & 0xffff) / 65536.0; }
+
+static uint16_t quantize(double v)
+{
+  long c = lround(v);
+  return (c < 0) ? 0 : (c > ADC_MAX) ? ADC_MAX : (uint16_t)c;
+}
+
+struct Signal {
+  virtual double At(double us) = 0; // ADC counts
+};
+
+struct Sine : Signal {
+  double amp,hz,phase,noise;
+  double At(double us) {
+    double n = noise ? (rndUnit() - 0.5) * 2 * noise : 0;
+    return ADC_HALF + amp * sin(2 * M_PI * hz * us / 1e6 + phase) + n;
+  }
+};
+
+// J1772 pilot at the sense pin: highcnt for the high plateau, lowcnt for
+// the low one, edges slewing linearly over slewus
+struct Pwm : Signal {
+  double highus; // 0 = steady low, 1000 = steady high
+  double offsetus,slewus;
+  double highcnt,lowcnt;
+  double At(double us) {
+    double t = fmod(us + offsetus,1000.0);
+    if (highus >= 1000) return highcnt;
+    if (highus <= 0) return lowcnt;
+    if (t < slewus) return lowcnt + (highcnt - lowcnt) * t / slewus;
+    if (t < highus) return highcnt;
+    if (t < highus + slewus) return highcnt - (highcnt - lowcnt) * (t - highus) / slewus;
+    return lowcnt;
+  }
+};
+
+//
+// the TC3 ISR's conversion schedule. each tick collects the conversion
+// started on the previous one, so a sample is taken S_H_US after the tick it
+// was started on
+//
+struct Sampler {
+  AmmeterAccum ammeter;
+  PilotAccum pilot;
+  uint8_t slot;
+  uint8_t mux;
+  uint8_t resync;
+  uint8_t pendKind;
+  double pendUs;
+  Signal *current;
+  Signal *pilotSig;
+  double us; // time of the next tick
+
+  void Init(Signal *cur,Signal *pil) {
+    ammeter.Init(ADC_HALF,ZERO_DEBOUNCE_TICKS,TIMEOUT_TICKS,MAX_SKIP_TICKS);
+    pilot.Init(PILOT_WINDOW_SAMPLES);
+    slot = SMP_FRAME_TICKS - 1;
+    mux = SMP_DISCARD;
+    resync = 1;
+    pendKind = 0xff;
+    current = cur;
+    pilotSig = pil;
+    us = 0;
+  }
+  void collect() {
+    if (pendKind == SMP_CURRENT) ammeter.Sample(quantize(current->At(pendUs)));
+    else if (pendKind == SMP_PILOT) pilot.Sample(quantize(pilotSig->At(pendUs)));
+    pendKind = 0xff;
+  }
+  void Tick() {
+    collect();
+    ammeter.Tick(1);
+    if (++slot >= SMP_FRAME_TICKS) slot = 0;
+    uint8_t m = smpSlotMux(slot);
+    uint8_t kind = smpSlotKind(slot);
+    if (resync || (m != mux)) {
+      mux = m;
+      kind = SMP_DISCARD;
+      resync = 0;
+    }
+    pendKind = kind;
+    pendUs = us + S_H_US;
+    us += TICK_US;
+  }
+  // ammeterSamplerPause() .. ammeterSamplerResume() around a foreground
+  // conversion: the in-flight conversion is aborted, and the ticks missed
+  // are skipped on resume
+  void Pause(uint16_t ticks) {
+    pendKind = 0xff;
+    resync = 1;
+    ammeter.Skip(ticks);
+    us += ticks * TICK_US;
+  }
+};
+
+static int s_Fails;
+
+static uint16_t lockTicks(double hz)
+{
+  // J1772EVSEController::ammeterLockSamples()
+  uint32_t fx100 = (uint32_t)lround(hz * 100);
+  return (uint16_t)(((uint32_t)LOCK_CYCLES*SAMPLE_HZ*100UL + fx100/2) / fx100);
+}
+
+//
+// foreground conversions: burst pauses of pauseticks, one tick apart, every
+// everyms. minpct = % of the windows which have to survive them, tolpct =
+// max error of a reading, on top of 2 counts. a window which loses less than
+// MAX_SKIP_TICKS is kept, and is off by up to ~1% more if what it lost was
+// near the peak
+//
+struct Pauses {
+  const char *name;
+  uint16_t pauseticks;
+  uint8_t burst;
+  double everyms;
+  unsigned minpct;
+  double tolpct;
+};
+static const Pauses s_NoPauses = { "none",0,0,0,90,1 };
+static const Pauses s_Pauses[] = {
+  { "pp",7,1,50,90,2.5 },           // one analogRead() w/ the core's ADC setup
+  { "pilot_loop",7,15,200,70,1 },   // ReadPilot()'s 15 after a pilot change
+  { "gmi",40,1,250,70,1 },          // a few ms of gmiAdcRead()
+};
+
+// run the sampler for ms, checking every ammeter reading against the true
+// rms
+static void ammeterCase(const char *mode,double hz,double amp,double noise,
+                        const Pauses &pause,double ms)
+{
+  Sine sine;
+  sine.amp = amp;
+  sine.hz = hz;
+  sine.phase = rndUnit() * 2 * M_PI;
+  sine.noise = noise;
+  Pwm p12;
+  p12.highus = 1000;
+  p12.highcnt = p12.lowcnt = 3500;
+  Sampler s;
+  s.Init(&sine,&p12);
+  uint8_t locked = (mode[0] == 'l');
+  if (locked) s.ammeter.SetWindow(lockTicks(hz));
+
+  // uniform noise of +-noise adds noise^2/3 to the mean square
+  double rms = sqrt(amp*amp/2 + noise*noise/3);
+  double tol = rms * pause.tolpct / 100 + 2;
+  double maxerr = 0;
+  unsigned readings = 0;
+  unsigned bad = 0;
+  double nextpause = pause.everyms ? rndUnit() * pause.everyms * 1000 : 1e30;
+  uint32_t meansq;
+  s.ammeter.Read(&meansq); // skip the initial 0
+  while (s.us < ms * 1000) {
+    if (s.us >= nextpause) {
+      for (uint8_t i=0;i < pause.burst;i++) {
+        if (i) s.Tick();
+        s.Pause(pause.pauseticks);
+      }
+      nextpause += pause.everyms * 1000;
+    }
+    s.Tick();
+    if (s.ammeter.Read(&meansq)) {
+      // the first zero-crossing window starts at the 1st crossing
+      if (s.us < 2 * 1e6 / hz) continue;
+      double err = fabs((double)ulong_sqrt(meansq) - rms);
+      if (err > maxerr) maxerr = err;
+      if (err > tol) bad++;
+      readings++;
+    }
+  }
+  // a reading per cycle (zc) or per LOCK_CYCLES (locked), give or take
+  // the first ones and the ones a pause ate the crossings of
+  unsigned expect = (unsigned)(ms / 1000 * hz / (locked ? LOCK_CYCLES : 1));
+  int ok = !bad && (readings >= expect * pause.minpct / 100);
+  if (!ok) s_Fails++;
+  printf("ammeter mode=%s hz=%g amp=%g noise=%g pauses=%s readings=%u expect=%u max_err_pct=%.3f bad=%u %s\n",
+         mode,hz,amp,noise,pause.name,readings,expect,
+         rms ? 100 * maxerr / rms : 0,bad,ok ? "OK" : "FAIL");
+}
+
+// no signal: zero-crossing windows must time out to a 0 reading
+static void ammeterZeroCase(const char *mode,double noise)
+{
+  Sine sine;
+  sine.amp = 0;
+  sine.hz = 60;
+  sine.phase = 0;
+  sine.noise = noise;
+  Pwm p12;
+  p12.highus = 1000;
+  p12.highcnt = p12.lowcnt = 3500;
+  Sampler s;
+  s.Init(&sine,&p12);
+  uint8_t locked = (mode[0] == 'l');
+  if (locked) s.ammeter.SetWindow(lockTicks(60));
+
+  unsigned readings = 0;
+  uint32_t maxrms = 0;
+  uint32_t meansq;
+  while (s.us < 1000 * 1000) {
+    s.Tick();
+    if (s.ammeter.Read(&meansq)) {
+      uint32_t r = ulong_sqrt(meansq);
+      if (r > maxrms) maxrms = r;
+      readings++;
+    }
+  }
+  int ok = readings && (maxrms <= (uint32_t)(noise + 1));
+  if (!ok) s_Fails++;
+  printf("ammeter mode=%s no_signal noise=%g readings=%u max_rms=%u %s\n",
+         mode,noise,readings,maxrms,ok ? "OK" : "FAIL");
+}
+
+// J1772Pilot::SetPWM() compare counts of 48000 per 1ms
+static double dutyUs(int amps)
+{
+  uint32_t compare = (amps <= 51) ? amps * 800u : 30720u + amps * 192u;
+  return compare / 48.0;
+}
+
+// sweep the PWM phase relative to the ticks, and check that every window
+// sees both plateaus
+static void pilotCase(const char *name,double highus,double slewus)
+{
+  const double high = 3000,low = 400;
+  const double tol = 4;
+  unsigned windows = 0,bad = 0;
+  double worstlow = 0,worsthigh = 0;
+  for (int ph=0;ph < 200;ph++) {
+    Pwm pwm;
+    pwm.highus = highus;
+    pwm.offsetus = ph * 5 + rndUnit() * 5;
+    pwm.slewus = slewus;
+    pwm.highcnt = high;
+    pwm.lowcnt = low;
+    Sine zero;
+    zero.amp = 0;
+    zero.hz = 60;
+    zero.phase = 0;
+    zero.noise = 0;
+    Sampler s;
+    s.Init(&zero,&pwm);
+    // start up mid frame, like after pilotSamplerRestart()
+    for (int i=rnd() % SMP_FRAME_TICKS;i;i--) s.Tick();
+    s.pilot.Restart();
+    uint16_t pl,ph16;
+    while (s.us < 200 * 1000) {
+      s.Tick();
+      if (s.pilot.Read(&pl,&ph16)) {
+        s.pilot.Restart(); // so the next Read() is the next window
+        windows++;
+        double hi = (highus > 0) ? high : low;
+        double lo = (highus < 1000) ? low : high;
+        double el = fabs(pl - lo),eh = fabs(ph16 - hi);
+        if (el > worstlow) worstlow = el;
+        if (eh > worsthigh) worsthigh = eh;
+        if ((el > tol) || (eh > tol)) bad++;
+      }
+    }
+  }
+  int ok = windows && !bad;
+  if (!ok) s_Fails++;
+  printf("pilot %s high_us=%g slew_us=%g windows=%u worst_low=%g worst_high=%g bad=%u %s\n",
+         name,highus,slewus,windows,worstlow,worsthigh,bad,ok ? "OK" : "FAIL");
+}
+
+int main(int argc,char **argv)
+{
+  // ammeter: 0.5A..80A-ish at a typical CT scaling, w/ and w/o noise
+  static const double amps[] = { 20,200,1000,1900 };
+  static const double hzs[] = { 50,60 };
+  static const char *modes[] = { "zc","locked" };
+  for (unsigned m=0;m < 2;m++) {
+    for (unsigned h=0;h < 2;h++) {
+      for (unsigned a=0;a < sizeof(amps)/sizeof(amps[0]);a++) {
+        ammeterCase(modes[m],hzs[h],amps[a],0,s_NoPauses,2000);
+        ammeterCase(modes[m],hzs[h],amps[a],8,s_NoPauses,2000);
+      }
+      for (unsigned p=0;p < sizeof(s_Pauses)/sizeof(s_Pauses[0]);p++) {
+        ammeterCase(modes[m],hzs[h],1000,4,s_Pauses[p],5000);
+      }
+      ammeterCase(modes[m],hzs[h]*1.02,1000,4,s_NoPauses,2000); // off nominal
+    }
+    ammeterZeroCase(modes[m],0);
+    ammeterZeroCase(modes[m],3);
+  }
+
+  // pilot: every SetPWM() duty cycle, and steady P12/N12
+  for (int a=6;a <= 80;a++) {
+    char name[16];
+    sprintf(name,"pwm%dA",a);
+    pilotCase(name,dutyUs(a),2);
+  }
+  pilotCase("pwm80A_slow",dutyUs(80),8);
+  pilotCase("P12",1000,0);
+  pilotCase("N12",0,0);
+
+  printf("sampler: %s\n",s_Fails ? "FAIL" : "OK");
+  return s_Fails ? 1 : 0;
+}
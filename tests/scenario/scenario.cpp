@@ -0,0 +1,279 @@
+/*
+ * This file is part of Open EVSE.
+ *
+ * Open EVSE is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+
+ * Open EVSE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with Open EVSE; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+//
+// runs a scenario script against the host build: sets the simulated
+// EV/mains/relay inputs, runs setup()/loop() in virtual time and checks
+// the EVSE state and outputs. one command per line, # starts a comment:
+//
+//  set <input> <value>  ev A|B|C|D, diode, ma, ac, hz, gnd, welded,
+//                       stuckopen, leak, gfict, pp, noise, temp (0.1C)
+//  rapi <cmd>           queue "$<cmd>\r" on the serial port
+//  flags <n>            EEPROM ECF_xxx flags to boot with, e.g. 0x2000 =
+//                       ECF_BOOT_LOCK_DISABLED
+//  boot                 setup(). BOOTLOCK holds it until a $SB is queued
+//  run <ms>             loop() for ms of virtual time
+//  until <state> <ms>   loop() until the EVSE state is <state>, fails after ms
+//  expect state <state> A, B, C, D, GFCI, NOGND, STUCKRELAY, GFITEST,
+//                       OVERTEMP, OVERCURRENT, CLOSURE, DIODE, SLEEPING,
+//                       DISABLED, or a number
+//  expect relay 0|1     relay driven closed
+//  expect pilot P12|N12|PWM
+//  expect duty <us>     pilot high time per 1ms
+//  expect tx <text>     text was written to the serial port since the
+//                       last expect tx
+//
+// usage: scenario <file>... exits non-zero on the first failure
+// set SCENARIO_ECHO=1 to see the serial output
+//
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "open_evse.h"
+
+void setup();
+void loop();
+
+static const struct {
+  const char *name;
+  uint8_t state;
+} s_States[] = {
+  { "A",EVSE_STATE_A },
+  { "B",EVSE_STATE_B },
+  { "C",EVSE_STATE_C },
+  { "D",EVSE_STATE_D },
+  { "DIODE",EVSE_STATE_DIODE_CHK_FAILED },
+  { "GFCI",EVSE_STATE_GFCI_FAULT },
+  { "NOGND",EVSE_STATE_NO_GROUND },
+  { "STUCKRELAY",EVSE_STATE_STUCK_RELAY },
+  { "GFITEST",EVSE_STATE_GFI_TEST_FAILED },
+  { "OVERTEMP",EVSE_STATE_OVER_TEMPERATURE },
+  { "OVERCURRENT",EVSE_STATE_OVER_CURRENT },
+  { "CLOSURE",EVSE_STATE_RELAY_CLOSURE_FAULT },
+  { "SLEEPING",EVSE_STATE_SLEEPING },
+  { "DISABLED",EVSE_STATE_DISABLED },
+};
+
+static int parseState(const char *s)
+{
+  for (unsigned i=0;i < sizeof(s_States)/sizeof(s_States[0]);i++) {
+    if (!strcmp(s,s_States[i].name)) return s_States[i].state;
+  }
+  char *end;
+  long v = strtol(s,&end,0);
+  return (*s && !*end) ? (int)v : -1;
+}
+
+static const char *stateName(uint8_t state)
+{
+  for (unsigned i=0;i < sizeof(s_States)/sizeof(s_States[0]);i++) {
+    if (s_States[i].state == state) return s_States[i].name;
+  }
+  static char s[8];
+  snprintf(s,sizeof(s),"0x%02x",state);
+  return s;
+}
+
+static const char *pilotName()
+{
+  if (g_Sim.pilotPwm) return "PWM";
+  return g_Sim.pinOut[HOST_PIN_PILOT] ? "P12" : "N12";
+}
+
+static void runFor(uint32_t ms)
+{
+  uint64_t end = g_Sim.nowUs + ms * 1000ULL;
+  while (g_Sim.nowUs < end) loop();
+}
+
+static int setInput(const char *name,const char *val)
+{
+  long v = strtol(val,NULL,0);
+  if (!strcmp(name,"ev")) g_Sim.evState = val[0];
+  else if (!strcmp(name,"diode")) g_Sim.evDiode = v;
+  else if (!strcmp(name,"ma")) g_Sim.evMa = v;
+  else if (!strcmp(name,"ac")) g_Sim.acLive = v;
+  else if (!strcmp(name,"hz")) g_Sim.acHz = v;
+  else if (!strcmp(name,"gnd")) g_Sim.gndOk = v;
+  else if (!strcmp(name,"welded")) g_Sim.relayWelded = v;
+  else if (!strcmp(name,"stuckopen")) g_Sim.relayStuckOpen = v;
+  else if (!strcmp(name,"leak")) g_Sim.gfiLeak = v;
+  else if (!strcmp(name,"gfict")) g_Sim.gfiTestCt = v;
+  else if (!strcmp(name,"pp")) g_Sim.ppAdc = v;
+  else if (!strcmp(name,"noise")) g_Sim.adcNoise = v;
+  else if (!strcmp(name,"temp")) g_Sim.tempC10 = v;
+  else return -1;
+  g_Sim.InputsChanged();
+  return 0;
+}
+
+static size_t s_TxPos;
+static const char *s_Fn;
+static int s_Lineno;
+
+// firmware that keeps virtual time going w/o ever getting back to us
+#define STUCK_MS 60000UL
+
+static void stuck()
+{
+  printf("%s:%d: stuck for %lums (state %s)\n",s_Fn,s_Lineno,STUCK_MS,
+         stateName(g_EvseController.GetState()));
+  exit(1);
+}
+
+static int expect(const char *what,const char *val,std::string &err)
+{
+  char s[80];
+  if (!strcmp(what,"state")) {
+    int want = parseState(val);
+    uint8_t got = g_EvseController.GetState();
+    if (want < 0) { err = "bad state"; return -1; }
+    if (got == want) return 0;
+    snprintf(s,sizeof(s),"state %s, want %s",stateName(got),val);
+  }
+  else if (!strcmp(what,"relay")) {
+    uint8_t got = g_Sim.RelayDriven();
+    if (got == atoi(val)) return 0;
+    snprintf(s,sizeof(s),"relay %d, want %s",got,val);
+  }
+  else if (!strcmp(what,"pilot")) {
+    if (!strcmp(pilotName(),val)) return 0;
+    snprintf(s,sizeof(s),"pilot %s, want %s",pilotName(),val);
+  }
+  else if (!strcmp(what,"duty")) {
+    if (g_Sim.pilotPwm && (g_Sim.pilotDutyUs == atoi(val))) return 0;
+    snprintf(s,sizeof(s),"duty %d, want %s",g_Sim.pilotPwm ? g_Sim.pilotDutyUs : -1,val);
+  }
+  else if (!strcmp(what,"tx")) {
+    size_t pos = g_Sim.tx.find(val,s_TxPos);
+    if (pos != std::string::npos) {
+      s_TxPos = pos + strlen(val);
+      return 0;
+    }
+    err = "no \"" + std::string(val) + "\" in tx: " + g_Sim.tx.substr(s_TxPos);
+    return -1;
+  }
+  else {
+    snprintf(s,sizeof(s),"unknown expect %s",what);
+  }
+  err = s;
+  return -1;
+}
+
+static int runScript(const char *fn)
+{
+  FILE *fp = fopen(fn,"r");
+  if (!fp) {
+    perror(fn);
+    return 1;
+  }
+
+  char line[256];
+  int lineno = 0;
+  int rc = 0;
+  s_Fn = fn;
+  g_Sim.onDeadline = stuck;
+  while (!rc && fgets(line,sizeof(line),fp)) {
+    lineno++;
+    s_Lineno = lineno;
+    char *c = strchr(line,'#');
+    if (c) *c = 0;
+    char *cmd = strtok(line," \t\r\n");
+    if (!cmd) continue;
+    char *a1 = strtok(NULL," \t\r\n");
+    char *a2 = strtok(NULL,"\r\n");
+    if (a2) {
+      while ((*a2 == ' ') || (*a2 == '\t')) a2++;
+      char *e = a2 + strlen(a2);
+      while ((e > a2) && ((e[-1] == ' ') || (e[-1] == '\t'))) *(--e) = 0;
+      if (!*a2) a2 = NULL;
+    }
+    std::string err;
+
+    if (!strcmp(cmd,"flags") && a1) {
+      eeprom_write_word((uint16_t *)EOFS_FLAGS,strtol(a1,NULL,0));
+    }
+    else if (!strcmp(cmd,"boot")) {
+      g_Sim.deadlineUs = g_Sim.nowUs + STUCK_MS * 1000ULL;
+      setup();
+    }
+    else if (!strcmp(cmd,"run") && a1) {
+      g_Sim.deadlineUs = g_Sim.nowUs + (atol(a1) + STUCK_MS) * 1000ULL;
+      runFor(atol(a1));
+    }
+    else if (!strcmp(cmd,"until") && a1 && a2) {
+      int want = parseState(a1);
+      uint64_t end = g_Sim.nowUs + atol(a2) * 1000ULL;
+      g_Sim.deadlineUs = end + STUCK_MS * 1000ULL;
+      while ((g_EvseController.GetState() != want) && (g_Sim.nowUs < end)) loop();
+      if (g_EvseController.GetState() != want) {
+        err = std::string("state ") + stateName(g_EvseController.GetState()) + ", want " + a1;
+      }
+    }
+    else if (!strcmp(cmd,"set") && a1 && a2) {
+      if (setInput(a1,a2)) err = "bad input";
+    }
+    else if (!strcmp(cmd,"rapi") && a1) {
+      g_Sim.rx += '$';
+      g_Sim.rx += a1;
+      if (a2) {
+        g_Sim.rx += ' ';
+        g_Sim.rx += a2;
+      }
+      g_Sim.rx += '\r';
+    }
+    else if (!strcmp(cmd,"expect") && a1 && a2) {
+      expect(a1,a2,err);
+    }
+    else {
+      err = "syntax";
+    }
+
+    if (!err.empty()) {
+      printf("%s:%d: %s (t=%llums)\n",fn,lineno,err.c_str(),
+             (unsigned long long)(g_Sim.nowUs / 1000));
+      rc = 1;
+    }
+  }
+  fclose(fp);
+
+  if (!rc && g_Sim.wdtBites) {
+    printf("%s: watchdog timed out %u times\n",fn,(unsigned)g_Sim.wdtBites);
+    rc = 1;
+  }
+  if (!rc) printf("%s: OK (%llums)\n",fn,(unsigned long long)(g_Sim.nowUs / 1000));
+  return rc;
+}
+
+int main(int argc,char *argv[])
+{
+  if (argc < 2) {
+    fprintf(stderr,"usage: %s <scenario>...\n",argv[0]);
+    return 2;
+  }
+  // the firmware's globals can't be put back to power on state, so a
+  // process only runs one script from boot. more than one argument runs
+  // them back to back, continuing from the previous one
+  if (getenv("SCENARIO_ECHO")) g_Sim.echo = 1; // show serial output
+  int rc = 0;
+  for (int i=1;!rc && (i < argc);i++) {
+    rc = runScript(argv[i]);
+  }
+  return rc;
+}